@@ -0,0 +1,334 @@
+#include "batchformatter.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+#include "documentsystem.h"
+
+namespace mote
+{
+    namespace
+    {
+        // Hashes of (options, content) pairs known to be formatted already.
+        const int HashSize = 20;
+        const int MaxCacheSize = 1000000;
+
+        QByteArray contentKey( const QByteArray& options, const QByteArray& content )
+        {
+            QCryptographicHash hash( QCryptographicHash::Sha1 );
+            hash.addData( options );
+            hash.addData( "\0", 1 );
+            hash.addData( content );
+            return hash.result();
+        }
+
+        struct FileResult
+        {
+            enum Status
+            {
+                Formatted,
+                Unchanged,
+                Skipped,
+                Failed
+            };
+
+            FileResult( void )
+                : status( Failed ),
+                  bytes( 0 )
+            {
+            }
+
+            Status status;
+            qint64 bytes;
+            QByteArray formattedKey;
+            QString error;
+        };
+
+        struct FormatJob
+        {
+            QString path;
+            SourceFormatter formatter;
+        };
+
+        class FileFormatter
+        {
+        public:
+            typedef FileResult result_type;
+
+        public:
+            FileFormatter( const QSet<QByteArray>* cache )
+                : m_cache( cache )
+            {
+            }
+
+            FileResult operator()( const FormatJob& job )const
+            {
+                FileResult result;
+                const QString& path = job.path;
+                const QByteArray options = job.formatter.options();
+
+                QFile file( path );
+                if( !file.open( QIODevice::ReadOnly ) )
+                {
+                    result.error = QString( "%1: %2" ).arg( path ).arg( file.errorString() );
+                    return result;
+                }
+                const QByteArray content = file.readAll();
+                file.close();
+                result.bytes = content.size();
+
+                if( m_cache->contains( contentKey( options, content ) ) )
+                {
+                    result.status = FileResult::Skipped;
+                    return result;
+                }
+
+                // Files with a NUL character are refused by the formatter
+                // and reported as failed; they are never written.
+                QByteArray formattedContent;
+                QString errorMessage;
+                if( !job.formatter.format( content, formattedContent, &errorMessage ) )
+                {
+                    result.error = QString( "%1: %2" ).arg( path ).arg( errorMessage );
+                    return result;
+                }
+                result.formattedKey = contentKey( options, formattedContent );
+
+                if( formattedContent == content )
+                {
+                    result.status = FileResult::Unchanged;
+                    return result;
+                }
+
+                // Replace the file in one step; a failure leaves it untouched.
+                QSaveFile saveFile( path );
+                if( !saveFile.open( QIODevice::WriteOnly ) ||
+                    ( saveFile.write( formattedContent ) != formattedContent.size() ) ||
+                    !saveFile.commit() )
+                {
+                    result.error = QString( "%1: %2" ).arg( path ).arg( saveFile.errorString() );
+                    return result;
+                }
+
+                result.status = FileResult::Formatted;
+                return result;
+            }
+
+        private:
+            const QSet<QByteArray>* m_cache;
+        };
+    }
+
+    double BatchFormatter::Statistics::filesPerSecond( void )const
+    {
+        return ( elapsed > 0 ) ? ( fileCount * 1000.0 / elapsed ) : 0.0;
+    }
+
+    double BatchFormatter::Statistics::megabytesPerSecond( void )const
+    {
+        return ( elapsed > 0 ) ? ( bytes * 1000.0 / elapsed / ( 1024.0 * 1024.0 ) ) : 0.0;
+    }
+
+    QString BatchFormatter::Statistics::summary( void )const
+    {
+        QString text =
+            QCoreApplication::translate(
+                "BatchFormatter",
+                "%1 files: %2 formatted, %3 unchanged, %4 skipped, %5 failed." )
+            .arg( fileCount )
+            .arg( formattedCount )
+            .arg( unchangedCount )
+            .arg( skippedCount )
+            .arg( failedCount );
+        text += '\n';
+        text +=
+            QCoreApplication::translate(
+                "BatchFormatter",
+                "%1 s, %2 files/s, %3 MB/s" )
+            .arg( elapsed / 1000.0, 0, 'f', 2 )
+            .arg( filesPerSecond(), 0, 'f', 1 )
+            .arg( megabytesPerSecond(), 0, 'f', 2 );
+        return text;
+    }
+
+    BatchFormatter::BatchFormatter( const FormatterProfiles& profiles, const int indentWidth )
+        : m_profiles( profiles ),
+          m_indentWidth( indentWidth )
+    {
+    }
+
+    // Files open in the editor, by canonical path. They are left alone:
+    // rewriting them under an open document would lose its edits or be
+    // lost at its next save.
+    void BatchFormatter::setOpenFiles( const QSet<QString>& canonicalPaths )
+    {
+        m_openFiles = canonicalPaths;
+    }
+
+    BatchFormatter::Statistics BatchFormatter::exec( const QStringList& paths )const
+    {
+        Statistics statistics;
+
+        QElapsedTimer timer;
+        timer.start();
+
+        QStringList files = sourceFiles( paths );
+        if( !m_openFiles.isEmpty() )
+        {
+            QStringList closedFiles;
+            for( int i = 0; i < files.size(); ++i )
+            {
+                if( m_openFiles.contains( DocumentSystem::canonicalPath( files.at( i ) ) ) )
+                {
+                    statistics.openFiles += files.at( i );
+                }
+                else
+                {
+                    closedFiles += files.at( i );
+                }
+            }
+            statistics.openCount = statistics.openFiles.size();
+            files = closedFiles;
+        }
+        QSet<QByteArray> cache = loadCache();
+
+        // Options are resolved here, on one thread; the profile cache
+        // makes this cheap for files sharing a directory.
+        QList<FormatJob> jobs;
+        jobs.reserve( files.size() );
+        for( int i = 0; i < files.size(); ++i )
+        {
+            FormatJob job;
+            job.path = files.at( i );
+            job.formatter = m_profiles.formatter( job.path, m_indentWidth );
+            jobs += job;
+        }
+
+        const QList<FileResult> results =
+            QtConcurrent::blockingMapped< QList<FileResult> >( jobs, FileFormatter( &cache ) );
+
+        statistics.fileCount = files.size();
+        for( int i = 0; i < results.size(); ++i )
+        {
+            const FileResult& result = results.at( i );
+            statistics.bytes += result.bytes;
+            switch( result.status )
+            {
+            case FileResult::Formatted:
+                ++statistics.formattedCount;
+                break;
+            case FileResult::Unchanged:
+                ++statistics.unchangedCount;
+                break;
+            case FileResult::Skipped:
+                ++statistics.skippedCount;
+                break;
+            case FileResult::Failed:
+                ++statistics.failedCount;
+                statistics.errors += result.error;
+                break;
+            }
+            if( !result.formattedKey.isEmpty() )
+            {
+                cache.insert( result.formattedKey );
+            }
+        }
+
+        saveCache( cache );
+
+        statistics.elapsed = timer.elapsed();
+        return statistics;
+    }
+
+    QStringList BatchFormatter::sourceFiles( const QStringList& paths )
+    {
+        QStringList nameFilters;
+        nameFilters += "*.c";
+        nameFilters += "*.cc";
+        nameFilters += "*.cpp";
+        nameFilters += "*.cxx";
+        nameFilters += "*.h";
+        nameFilters += "*.hh";
+        nameFilters += "*.hpp";
+        nameFilters += "*.hxx";
+        nameFilters += "*.inl";
+
+        QStringList files;
+        for( int i = 0; i < paths.size(); ++i )
+        {
+            const QFileInfo info( paths.at( i ) );
+            if( info.isDir() )
+            {
+                QDirIterator itr( info.filePath(), nameFilters, QDir::Files, QDirIterator::Subdirectories );
+                while( itr.hasNext() )
+                {
+                    files += itr.next();
+                }
+            }
+            else if( info.isFile() )
+            {
+                files += info.filePath();
+            }
+        }
+        return files;
+    }
+
+    QString BatchFormatter::cacheFilePath( void )
+    {
+        return QDir( QStandardPaths::writableLocation( QStandardPaths::CacheLocation ) ).filePath( "formatted.dat" );
+    }
+
+    QSet<QByteArray> BatchFormatter::loadCache( void )
+    {
+        QSet<QByteArray> cache;
+
+        QFile file( cacheFilePath() );
+        if( !file.open( QIODevice::ReadOnly ) )
+        {
+            return cache;
+        }
+
+        const QByteArray data = file.readAll();
+        cache.reserve( data.size() / HashSize );
+        for( int i = 0; i + HashSize <= data.size(); i += HashSize )
+        {
+            cache.insert( data.mid( i, HashSize ) );
+        }
+        return cache;
+    }
+
+    void BatchFormatter::saveCache( const QSet<QByteArray>& cache )
+    {
+        if( cache.size() > MaxCacheSize )
+        {
+            // Start over rather than grow without bound.
+            QFile::remove( cacheFilePath() );
+            return;
+        }
+
+        QDir().mkpath( QFileInfo( cacheFilePath() ).absolutePath() );
+        QSaveFile file( cacheFilePath() );
+        if( !file.open( QIODevice::WriteOnly ) )
+        {
+            return;
+        }
+
+        QByteArray data;
+        data.reserve( cache.size() * HashSize );
+        for( QSet<QByteArray>::const_iterator itr = cache.begin(); itr != cache.end(); ++itr )
+        {
+            data += *itr;
+        }
+        file.write( data );
+        file.commit();
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QByteArray>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+#include "formatterprofiles.h"
+
+namespace mote
+{
+    class BatchFormatter
+    {
+    public:
+        struct Statistics
+        {
+            Statistics( void )
+                : fileCount( 0 ),
+                  formattedCount( 0 ),
+                  unchangedCount( 0 ),
+                  skippedCount( 0 ),
+                  failedCount( 0 ),
+                  openCount( 0 ),
+                  bytes( 0 ),
+                  elapsed( 0 )
+            {
+            }
+
+            double filesPerSecond( void )const;
+            double megabytesPerSecond( void )const;
+            QString summary( void )const;
+
+            int fileCount;
+            int formattedCount;
+            int unchangedCount;
+            int skippedCount;
+            int failedCount;
+            int openCount;
+            qint64 bytes;
+            qint64 elapsed;
+            QStringList errors;
+            QStringList openFiles;
+        };
+
+    public:
+        BatchFormatter(
+            const FormatterProfiles& profiles = FormatterProfiles(),
+            const int indentWidth = 4 );
+
+    public:
+        void setOpenFiles( const QSet<QString>& canonicalPaths );
+        Statistics exec( const QStringList& paths )const;
+
+        static QStringList sourceFiles( const QStringList& paths );
+
+    private:
+        static QString cacheFilePath( void );
+        static QSet<QByteArray> loadCache( void );
+        static void saveCache( const QSet<QByteArray>& cache );
+
+    private:
+        FormatterProfiles m_profiles;
+        int m_indentWidth;
+        QSet<QString> m_openFiles;
+    };
+}
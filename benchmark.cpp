@@ -0,0 +1,374 @@
+#include "benchmark.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QKeyEvent>
+#include <QScrollBar>
+#include <QTemporaryDir>
+#include <QTextBlock>
+#include <QVector>
+
+#include "linededuplicator.h"
+#include "textdocument.h"
+#include "textedit.h"
+#include "textlines.h"
+
+namespace mote
+{
+    namespace
+    {
+        // Three lines scrolled per wheel step, as most platforms do.
+        const int ScrollLineCount = 3;
+
+        // The indent scenario shifts this many lines back and forth; each
+        // frame rewrites all of them, so it runs fewer frames.
+        const int IndentLineCount = 500000;
+        const int IndentFrameCount = 10;
+
+        // The complete scenario appends this many distinct words, all
+        // matching the pattern completed in every frame.
+        const int CandidateCount = 200000;
+
+        // The cursors scenario types at this many cursors spread evenly
+        // over the document.
+        const int CursorCount = 10000;
+
+        // Each mode of the deduplicate scenario runs this many times.
+        const int DeduplicateRunCount = 3;
+
+        struct DeduplicateMode
+        {
+            const char* name;
+            LineDeduplicator::Mode mode;
+            bool countOccurrences;
+        };
+
+        const DeduplicateMode DeduplicateModes[] =
+        {
+            { "adjacent", LineDeduplicator::Adjacent, false },
+            { "first", LineDeduplicator::KeepFirst, false },
+            { "last", LineDeduplicator::KeepLast, false },
+            { "count", LineDeduplicator::KeepFirst, true }
+        };
+    }
+
+    QString Benchmark::Result::summary( void )const
+    {
+        return QString( "%1 lines %2 p50 %3 ms p99 %4 ms max %5 ms" )
+               .arg( lineCount, 8 )
+               .arg( scenarioName( scenario ), -8 )
+               .arg( frames.p50, 7, 'f', 2 )
+               .arg( frames.p99, 7, 'f', 2 )
+               .arg( frames.max, 7, 'f', 2 );
+    }
+
+    QJsonObject Benchmark::Result::toJson( void )const
+    {
+        QJsonObject object;
+        object.insert( "lines", lineCount );
+        object.insert( "scenario", scenarioName( scenario ) );
+        object.insert( "frames", frames.toJson() );
+        object.insert( "phases", phases );
+        return object;
+    }
+
+    Benchmark::Benchmark( const int frameCount )
+        : m_frameCount( frameCount )
+    {
+    }
+
+    QList<Benchmark::Result> Benchmark::exec(
+        const QList<int>& lineCounts,
+        const QList<int>& deduplicateLineCounts )const
+    {
+        QList<Result> results;
+
+        QTemporaryDir dir;
+        if( !dir.isValid() )
+        {
+            return results;
+        }
+
+        FrameProfiler* profiler = FrameProfiler::instance();
+        const bool enabled = profiler->isEnabled();
+        profiler->setEnabled( true );
+
+        for( int i = 0; i < lineCounts.size(); ++i )
+        {
+            const int lineCount = lineCounts.at( i );
+
+            // A real file, so that the document is highlighted as C++.
+            const QString path = dir.filePath( QString( "reference%1.cpp" ).arg( lineCount ) );
+            QFile file( path );
+            if( !file.open( QIODevice::WriteOnly ) )
+            {
+                continue;
+            }
+            file.write( referenceText( lineCount ).toUtf8() );
+            file.close();
+
+            // The scenarios before deduplicating need an editor.
+            for( int j = 0; j < DeduplicateScenario; ++j )
+            {
+                TextDocument textDocument;
+                if( !textDocument.openFile( path ) )
+                {
+                    break;
+                }
+
+                TextEdit textEdit( &textDocument );
+                textEdit.setLineNumberVisible( true );
+                textEdit.resize( 1024, 768 );
+                textEdit.show();
+                QApplication::processEvents();
+
+                results += run( &textEdit, lineCount, static_cast<Scenario>( j ) );
+            }
+        }
+
+        profiler->setEnabled( enabled );
+
+        for( int i = 0; i < deduplicateLineCounts.size(); ++i )
+        {
+            results += deduplicate( deduplicateLineCounts.at( i ) );
+        }
+
+        return results;
+    }
+
+    QString Benchmark::scenarioName( const Scenario scenario )
+    {
+        switch( scenario )
+        {
+        case ScrollScenario:
+            return "scroll";
+        case PageScenario:
+            return "page";
+        case TypeScenario:
+            return "type";
+        case IndentScenario:
+            return "indent";
+        case CompleteScenario:
+            return "complete";
+        case CursorsScenario:
+            return "cursors";
+        case DeduplicateScenario:
+            return "dedup";
+        default:
+            return QString();
+        }
+    }
+
+    // C++ looking text with tabs, trailing spaces and long comment lines,
+    // so that every part of the painting has something to do.
+    QString Benchmark::referenceText( const int lineCount )
+    {
+        static const char* const lines[] =
+        {
+            "namespace reference",
+            "{",
+            "    // A comment line that is long enough to run past the guide line at eighty columns.",
+            "    int function( const int value, const char* text )",
+            "    {",
+            "\tint result = value;    ",
+            "        for( int i = 0; i < value; ++i )",
+            "        {",
+            "            result += text[i] == '{' ? 1 : 0; /* block comment */",
+            "        }",
+            "        return result;",
+            "    }",
+            "}",
+            ""
+        };
+        const int count = sizeof( lines ) / sizeof( lines[0] );
+
+        QString text;
+        text.reserve( lineCount * 48 );
+        for( int i = 0; i < lineCount; ++i )
+        {
+            text += QLatin1String( lines[i % count] );
+            text += '\n';
+        }
+        return text;
+    }
+
+    QJsonArray Benchmark::toJson( const QList<Result>& results )
+    {
+        QJsonArray array;
+        for( int i = 0; i < results.size(); ++i )
+        {
+            array.append( results.at( i ).toJson() );
+        }
+        return array;
+    }
+
+    Benchmark::Result Benchmark::run( TextEdit* textEdit, const int lineCount, const Scenario scenario )const
+    {
+        FrameProfiler* profiler = FrameProfiler::instance();
+        profiler->clear();
+
+        if( scenario == TypeScenario )
+        {
+            QTextCursor textCursor( textEdit->document()->findBlockByNumber( lineCount / 2 ) );
+            textEdit->setTextCursor( textCursor );
+            textEdit->centerCursor();
+            QApplication::processEvents();
+        }
+
+        int frameCount = m_frameCount;
+        if( scenario == IndentScenario )
+        {
+            QTextCursor textCursor( textEdit->document() );
+            textCursor.setPosition(
+                textEdit->document()->findBlockByNumber( qMin( lineCount, IndentLineCount ) - 1 ).position(),
+                QTextCursor::KeepAnchor );
+            textCursor.movePosition( QTextCursor::EndOfBlock, QTextCursor::KeepAnchor );
+            textEdit->setTextCursor( textCursor );
+            QApplication::processEvents();
+            frameCount = qMin( frameCount, IndentFrameCount );
+        }
+
+        if( scenario == CompleteScenario )
+        {
+            QString words;
+            for( int i = 0; i < CandidateCount; ++i )
+            {
+                words += QString( "\ncandidate%1" ).arg( i );
+            }
+            words += "\nc";
+
+            QTextCursor textCursor( textEdit->document() );
+            textCursor.movePosition( QTextCursor::End );
+            textCursor.insertText( words );
+            textEdit->setTextCursor( textCursor );
+            textEdit->ensureCursorVisible();
+            QApplication::processEvents();
+        }
+
+        if( scenario == CursorsScenario )
+        {
+            // Marks the lines to put the cursors on and selects them all.
+            const int step = qMax( 1, lineCount / CursorCount );
+            QTextCursor textCursor( textEdit->document() );
+            textCursor.beginEditBlock();
+            for( int i = 0; ( i < CursorCount ) && ( i * step < lineCount ); ++i )
+            {
+                textCursor.setPosition( textEdit->document()->findBlockByNumber( i * step ).position() );
+                textCursor.insertText( "@@" );
+            }
+            textCursor.endEditBlock();
+
+            textCursor.setPosition( 0 );
+            textCursor.setPosition( 2, QTextCursor::KeepAnchor );
+            textEdit->setTextCursor( textCursor );
+            textEdit->selectAllOccurrences();
+            QApplication::processEvents();
+        }
+
+        // A frame is the input plus the repaint it causes.
+        QVector<qint64> frames;
+        frames.reserve( frameCount );
+        QElapsedTimer timer;
+        for( int i = 0; i < frameCount; ++i )
+        {
+            timer.start();
+            step( textEdit, scenario, i );
+            QApplication::processEvents();
+            frames += timer.nsecsElapsed();
+        }
+
+        Result result;
+        result.lineCount = lineCount;
+        result.scenario = scenario;
+        result.frames = FrameProfiler::calculate( frames );
+        result.phases = profiler->toJson();
+        return result;
+    }
+
+    // Runs every mode of LineDeduplicator over lines that each occur twice,
+    // half a document apart. The phases are the modes.
+    Benchmark::Result Benchmark::deduplicate( const int lineCount )const
+    {
+        const int half = qMax( 1, lineCount / 2 );
+        QString text;
+        text.reserve( lineCount * 8 );
+        for( int i = 0; i < lineCount; ++i )
+        {
+            text += QString::number( i % half );
+            text += '\n';
+        }
+        const TextLines lines( text, '\n' );
+
+        const int modeCount = sizeof( DeduplicateModes ) / sizeof( DeduplicateModes[0] );
+
+        QVector<qint64> frames;
+        QJsonObject phases;
+        QElapsedTimer timer;
+        for( int i = 0; i < modeCount; ++i )
+        {
+            const DeduplicateMode& mode = DeduplicateModes[i];
+            const LineDeduplicator deduplicator( mode.mode, mode.countOccurrences );
+            QVector<qint64> runs;
+            for( int j = 0; j < DeduplicateRunCount; ++j )
+            {
+                timer.start();
+                deduplicator.exec( lines );
+                runs += timer.nsecsElapsed();
+            }
+            frames += runs;
+            phases.insert( mode.name, FrameProfiler::calculate( runs ).toJson() );
+        }
+
+        Result result;
+        result.lineCount = lineCount;
+        result.scenario = DeduplicateScenario;
+        result.frames = FrameProfiler::calculate( frames );
+        result.phases = phases;
+        return result;
+    }
+
+    void Benchmark::step( TextEdit* textEdit, const Scenario scenario, const int frame )
+    {
+        switch( scenario )
+        {
+        case ScrollScenario:
+            {
+                QScrollBar* scrollBar = textEdit->verticalScrollBar();
+                scrollBar->setValue( scrollBar->value() + ScrollLineCount );
+            }
+            break;
+        case PageScenario:
+            {
+                QKeyEvent event( QEvent::KeyPress, Qt::Key_PageDown, Qt::NoModifier );
+                QApplication::sendEvent( textEdit, &event );
+            }
+            break;
+        case TypeScenario:
+        case CursorsScenario:
+            {
+                QKeyEvent event( QEvent::KeyPress, Qt::Key_X, Qt::NoModifier, "x" );
+                QApplication::sendEvent( textEdit, &event );
+            }
+            break;
+        case IndentScenario:
+            {
+                // Tab and Ctrl+Backspace in turn, keeping the selection.
+                QKeyEvent tabEvent( QEvent::KeyPress, Qt::Key_Tab, Qt::NoModifier );
+                QKeyEvent backspaceEvent( QEvent::KeyPress, Qt::Key_Backspace, Qt::ControlModifier );
+                QApplication::sendEvent( textEdit, ( frame % 2 == 0 ) ? &tabEvent : &backspaceEvent );
+            }
+            break;
+        case CompleteScenario:
+            {
+                // Escape opens the popup over every candidate, then closes it.
+                QKeyEvent event( QEvent::KeyPress, Qt::Key_Escape, Qt::NoModifier );
+                QApplication::sendEvent( textEdit, &event );
+                QApplication::sendEvent( textEdit, &event );
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+
+#include "frameprofiler.h"
+
+namespace mote
+{
+    class TextEdit;
+
+    // Scrolls, pages, types, indents, completes and types at many cursors
+    // through generated reference files in an editor and measures the time
+    // of every frame. Deduplicating lines is measured on the text alone,
+    // one frame per run. Needs a QApplication; the offscreen platform is
+    // enough.
+    class Benchmark
+    {
+    public:
+        enum Scenario
+        {
+            ScrollScenario,
+            PageScenario,
+            TypeScenario,
+            IndentScenario,
+            CompleteScenario,
+            CursorsScenario,
+            DeduplicateScenario,
+            ScenarioCount
+        };
+
+        struct Result
+        {
+            int lineCount;
+            Scenario scenario;
+            FrameProfiler::Statistics frames;
+            QJsonObject phases;
+
+            QString summary( void )const;
+            QJsonObject toJson( void )const;
+        };
+
+    public:
+        Benchmark( const int frameCount = 300 );
+
+    public:
+        QList<Result> exec(
+            const QList<int>& lineCounts,
+            const QList<int>& deduplicateLineCounts = QList<int>() )const;
+
+        static QString scenarioName( const Scenario scenario );
+        static QString referenceText( const int lineCount );
+        static QJsonArray toJson( const QList<Result>& results );
+
+    private:
+        Result run( TextEdit* textEdit, const int lineCount, const Scenario scenario )const;
+        Result deduplicate( const int lineCount )const;
+        static void step( TextEdit* textEdit, const Scenario scenario, const int frame );
+
+    private:
+        int m_frameCount;
+    };
+}
@@ -0,0 +1,110 @@
+#include "blockdata.h"
+
+namespace mote
+{
+    BlockData::Syntax::Syntax( void )
+        : valid( false ),
+          endsInComment( false ),
+          leadingCloseCount( 0 ),
+          braceDelta( 0 ),
+          parenCloseCount( 0 )
+    {
+    }
+
+    BlockData::BlockData( void )
+        : m_markerGeneration( -1 ),
+          m_wordIndex( NULL ),
+          m_lastNonBlank( -1 )
+    {
+    }
+
+    // A block going away with an edit takes its words out of the index.
+    BlockData::~BlockData()
+    {
+        if( m_wordIndex )
+        {
+            m_wordIndex->removeWords( m_words );
+        }
+    }
+
+    BlockData* BlockData::find( const QTextBlock& block )
+    {
+        return static_cast<BlockData*>( block.userData() );
+    }
+
+    BlockData* BlockData::get( QTextBlock block )
+    {
+        BlockData* data = find( block );
+        if( !data )
+        {
+            data = new BlockData;
+            block.setUserData( data );
+        }
+        return data;
+    }
+
+    void BlockData::invalidate( void )
+    {
+        m_markers.clear();
+        m_markerGeneration = -1;
+    }
+
+    bool BlockData::hasMarkers( const int layoutGeneration )const
+    {
+        return m_markerGeneration == layoutGeneration;
+    }
+
+    const QVector<BlockData::Marker>& BlockData::markers( void )const
+    {
+        return m_markers;
+    }
+
+    void BlockData::setMarkers( const QVector<Marker>& markers, const int layoutGeneration )
+    {
+        m_markers = markers;
+        m_markerGeneration = layoutGeneration;
+    }
+
+    const QVector<WordIndex::Word>& BlockData::words( void )const
+    {
+        return m_words;
+    }
+
+    void BlockData::setWords( const QVector<WordIndex::Word>& words, WordIndex* wordIndex )
+    {
+        m_words = words;
+        m_wordIndex = wordIndex;
+    }
+
+    const BlockData::Syntax& BlockData::syntax( void )const
+    {
+        return m_syntax;
+    }
+
+    void BlockData::setSyntax( const Syntax& syntax )
+    {
+        m_syntax = syntax;
+    }
+
+    const QVector<BlockData::Paren>& BlockData::openParens( void )const
+    {
+        return m_openParens;
+    }
+
+    void BlockData::setOpenParens( const QVector<Paren>& parens )
+    {
+        m_openParens = parens;
+    }
+
+    // The number of the last block up to this one with more than spaces
+    // and tabs, or -1 if there is none.
+    int BlockData::lastNonBlank( void )const
+    {
+        return m_lastNonBlank;
+    }
+
+    void BlockData::setLastNonBlank( const int blockNumber )
+    {
+        m_lastNonBlank = blockNumber;
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QPointF>
+#include <QTextBlock>
+#include <QTextBlockUserData>
+#include <QVector>
+
+#include "wordindex.h"
+
+namespace mote
+{
+    // State kept with one block. The caches derived from its text are
+    // dropped by the document whenever the block is edited.
+    class BlockData : public QTextBlockUserData
+    {
+    public:
+        enum MarkerKind
+        {
+            TabMarker,
+            NewlineMarker,
+            EOFMarker,
+            TrailingSpaceMarker,
+            FullWidthSpaceMarker,
+            MarkerKindCount
+        };
+
+        // Position relative to the top left of the block.
+        struct Marker
+        {
+            MarkerKind kind;
+            QPointF position;
+        };
+
+        // What indenting needs to know of a block, recorded by the syntax
+        // highlighter. Only brackets outside strings and comments count.
+        struct Syntax
+        {
+            Syntax( void );
+
+            bool valid;
+            bool endsInComment;
+            int leadingCloseCount;
+            int braceDelta;
+            int parenCloseCount;
+            QVector<int> parenColumns;
+        };
+
+        // A parenthesis still open at the end of a block: where it was
+        // opened and the column the text inside it starts at, or -1 if the
+        // line ends after it.
+        struct Paren
+        {
+            int blockNumber;
+            int column;
+        };
+
+    public:
+        BlockData( void );
+        virtual ~BlockData();
+
+    public:
+        static BlockData* find( const QTextBlock& block );
+        static BlockData* get( QTextBlock block );
+
+        void invalidate( void );
+
+        bool hasMarkers( const int layoutGeneration )const;
+        const QVector<Marker>& markers( void )const;
+        void setMarkers( const QVector<Marker>& markers, const int layoutGeneration );
+
+        const QVector<WordIndex::Word>& words( void )const;
+        void setWords( const QVector<WordIndex::Word>& words, WordIndex* wordIndex );
+
+        const Syntax& syntax( void )const;
+        void setSyntax( const Syntax& syntax );
+
+        const QVector<Paren>& openParens( void )const;
+        void setOpenParens( const QVector<Paren>& parens );
+
+        int lastNonBlank( void )const;
+        void setLastNonBlank( const int blockNumber );
+
+    private:
+        QVector<Marker> m_markers;
+        int m_markerGeneration;
+        QVector<WordIndex::Word> m_words;
+        WordIndex* m_wordIndex;
+        Syntax m_syntax;
+        QVector<Paren> m_openParens;
+        int m_lastNonBlank;
+    };
+}
@@ -0,0 +1,371 @@
+#include "completionindex.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#include "textdocument.h"
+
+namespace mote
+{
+    namespace
+    {
+        // Documents are read again once typing has paused this long.
+        const int UpdateDelay = 2000;
+
+        // Only the best of a short pattern's many matches are listed.
+        const int MaxCandidateCount = 256;
+
+        // How much matching the typed text well, being near the cursor,
+        // being frequent and having been picked recently count towards the
+        // rank of a word.
+        const double MatchWeight = 1.0;
+        const double ProximityWeight = 1.0;
+        const double FrequencyWeight = 0.5;
+        const double RecencyWeight = 1.0;
+
+        // Words picked longer ago than this many picks add next to nothing
+        // to the rank and are forgotten.
+        const int MaxRecentCount = 256;
+
+        bool higherScore( const CompletionIndex::Candidate& candidate1, const CompletionIndex::Candidate& candidate2 )
+        {
+            if( candidate1.score != candidate2.score )
+            {
+                return candidate1.score > candidate2.score;
+            }
+            return WordIndex::lessWord( candidate1.word, candidate2.word );
+        }
+
+        bool isWord( const QString& name )
+        {
+            for( int i = 0; i < name.length(); ++i )
+            {
+                if( !WordIndex::isWordCharacter( name.at( i ) ) )
+                {
+                    return false;
+                }
+            }
+            return !name.isEmpty();
+        }
+    }
+
+    CompletionIndex::CompletionIndex( QObject* parent )
+        : QObject( parent ),
+          m_acceptCount( 0 ),
+          m_active( false ),
+          m_updatePending( false )
+    {
+        m_updateTimer.setSingleShot( true );
+        m_updateTimer.setInterval( UpdateDelay );
+
+        connect(
+            &m_updateTimer, SIGNAL( timeout() ),
+            SLOT( update( void ) ) );
+        connect(
+            &m_watcher, SIGNAL( finished() ),
+            SLOT( onBuildFinished( void ) ) );
+    }
+
+    void CompletionIndex::addDocument( TextDocument* textDocument )
+    {
+        m_documents += textDocument;
+        m_documentWords.remove( textDocument );
+        connect(
+            textDocument, SIGNAL( contentsChanged() ),
+            SLOT( scheduleUpdate( void ) ) );
+        connect(
+            textDocument, SIGNAL( destroyed( QObject* ) ),
+            SLOT( onDocumentDestroyed( QObject* ) ) );
+    }
+
+    void CompletionIndex::setProjectSymbols( const QStringList& names )
+    {
+        m_projectSymbols = names;
+        scheduleUpdate();
+    }
+
+    int CompletionIndex::wordCount( void )const
+    {
+        return m_snapshot.entries.size();
+    }
+
+    // Merges the words near the cursor with those of the shared table and
+    // ranks them all by a blend of match quality, proximity, frequency and
+    // recency. The whole table is scanned; the character masks drop most
+    // entries before any character is compared. truncated tells whether
+    // matches were left out of the result.
+    QVector<CompletionIndex::Candidate> CompletionIndex::complete(
+        const FuzzyMatcher& matcher,
+        const QVector<WordIndex::Candidate>& nearby,
+        bool* truncated )
+    {
+        // Nothing is collected until completion is first used.
+        if( !m_active )
+        {
+            m_active = true;
+            update();
+        }
+
+        QHash<QString, Candidate> candidates;
+
+        const QString& pattern = matcher.pattern();
+        const QVector<Entry>& entries = m_snapshot.entries;
+        for( int i = 0; i < entries.size(); ++i )
+        {
+            const Entry& entry = entries.at( i );
+            Candidate candidate;
+            if( matcher.mayMatch( entry.mask ) &&
+                ( entry.word != pattern ) &&
+                matcher.match( entry.word, &candidate.matchScore ) )
+            {
+                candidate.word = entry.word;
+                candidate.distance = INT_MAX;
+                candidate.count = entry.count;
+                candidates.insert( candidate.word, candidate );
+            }
+        }
+
+        for( int i = 0; i < nearby.size(); ++i )
+        {
+            const WordIndex::Candidate& word = nearby.at( i );
+            QHash<QString, Candidate>::iterator candidateIt = candidates.find( word.word );
+            if( candidateIt != candidates.end() )
+            {
+                candidateIt.value().distance = word.distance;
+            }
+            else
+            {
+                Candidate candidate;
+                candidate.word = word.word;
+                candidate.distance = word.distance;
+                candidate.count = word.count;
+                candidate.matchScore = 0;
+                matcher.match( candidate.word, &candidate.matchScore );
+                candidates.insert( candidate.word, candidate );
+            }
+        }
+
+        const double maxMatchScore = qMax( matcher.maxScore(), 1 );
+        const double maxFrequency = std::log( 1.0 + qMax( m_snapshot.maxCount, 1 ) );
+
+        QVector<Candidate> result;
+        result.reserve( candidates.size() );
+        for( QHash<QString, Candidate>::iterator candidateIt = candidates.begin();
+             candidateIt != candidates.end();
+             ++candidateIt )
+        {
+            Candidate& candidate = candidateIt.value();
+
+            const double match = qBound( 0.0, candidate.matchScore / maxMatchScore, 1.0 );
+            const double proximity =
+                ( candidate.distance == INT_MAX ) ? 0.0 : 1.0 / ( 1.0 + candidate.distance / 256.0 );
+            const double frequency = qMin( std::log( 1.0 + candidate.count ) / maxFrequency, 1.0 );
+            const int acceptedAt = m_acceptedAt.value( candidate.word, -1 );
+            const double recency =
+                ( acceptedAt < 0 ) ? 0.0 : 1.0 / ( 1.0 + ( m_acceptCount - acceptedAt ) / 8.0 );
+
+            candidate.score =
+                MatchWeight * match +
+                ProximityWeight * proximity +
+                FrequencyWeight * frequency +
+                RecencyWeight * recency;
+            result += candidate;
+        }
+        if( truncated )
+        {
+            *truncated = result.size() > MaxCandidateCount;
+        }
+        if( result.size() > MaxCandidateCount )
+        {
+            std::partial_sort( result.begin(), result.begin() + MaxCandidateCount, result.end(), higherScore );
+            result.resize( MaxCandidateCount );
+        }
+        else
+        {
+            std::sort( result.begin(), result.end(), higherScore );
+        }
+        return result;
+    }
+
+    void CompletionIndex::accept( const QString& word )
+    {
+        m_acceptedAt.insert( word, ++m_acceptCount );
+
+        // Pruned in bulk, so that each pick costs constant time on average.
+        if( m_acceptedAt.size() > MaxRecentCount * 2 )
+        {
+            QHash<QString, int>::iterator it = m_acceptedAt.begin();
+            while( it != m_acceptedAt.end() )
+            {
+                if( m_acceptCount - it.value() >= MaxRecentCount )
+                {
+                    it = m_acceptedAt.erase( it );
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    // Word tables are copied by reference count only; the worker reads
+    // them while the documents go on editing their own copies. Documents
+    // without one hand over their text instead of building it here. The
+    // words of each document are kept until its edit revision changes, so
+    // documents left alone are neither read again nor counted again.
+    void CompletionIndex::update( void )
+    {
+        if( !m_active )
+        {
+            return;
+        }
+
+        if( m_watcher.isRunning() )
+        {
+            m_updatePending = true;
+            return;
+        }
+        m_updatePending = false;
+
+        QList<DocumentWords> documents;
+        for( int i = 0; i < m_documents.size(); ++i )
+        {
+            TextDocument* textDocument = m_documents.at( i );
+            QHash<TextDocument*, DocumentWords>::iterator wordsIt = m_documentWords.find( textDocument );
+            if( ( wordsIt == m_documentWords.end() ) ||
+                ( wordsIt.value().revision != textDocument->editRevision() ) )
+            {
+                DocumentWords words;
+                words.revision = textDocument->editRevision();
+                if( textDocument->hasWordIndex() )
+                {
+                    words.counts = textDocument->wordIndex()->counts();
+                }
+                else
+                {
+                    words.text = textDocument->plainText();
+                }
+                wordsIt = m_documentWords.insert( textDocument, words );
+            }
+            documents += wordsIt.value();
+        }
+        m_buildDocuments = m_documents;
+
+        m_watcher.setFuture(
+            QtConcurrent::run( &CompletionIndex::build, documents, m_projectSymbols ) );
+    }
+
+    // Counts the words of the documents handed over as text, and hands
+    // them back with the snapshot to be kept.
+    CompletionIndex::Snapshot CompletionIndex::build(
+        QList<DocumentWords> documents,
+        const QStringList& projectSymbols )
+    {
+        QHash<QString, int> totals;
+        for( int i = 0; i < documents.size(); ++i )
+        {
+            DocumentWords& words = documents[i];
+            const QString& text = words.text;
+            for( int j = 0; j < text.length(); )
+            {
+                if( !WordIndex::isWordCharacter( text.at( j ) ) )
+                {
+                    ++j;
+                    continue;
+                }
+
+                const int start = j;
+                while( ( j < text.length() ) && WordIndex::isWordCharacter( text.at( j ) ) )
+                {
+                    ++j;
+                }
+                words.counts[text.mid( start, j - start )] += 1;
+            }
+            words.text.clear();
+
+            const QHash<QString, int>& documentCounts = words.counts;
+            for( QHash<QString, int>::const_iterator it = documentCounts.begin();
+                 it != documentCounts.end();
+                 ++it )
+            {
+                totals[it.key()] += it.value();
+            }
+        }
+        for( int i = 0; i < projectSymbols.size(); ++i )
+        {
+            if( isWord( projectSymbols.at( i ) ) )
+            {
+                totals[projectSymbols.at( i )] += 1;
+            }
+        }
+
+        Snapshot snapshot;
+        snapshot.entries.reserve( totals.size() );
+        for( QHash<QString, int>::const_iterator it = totals.begin(); it != totals.end(); ++it )
+        {
+            Entry entry;
+            entry.word = it.key();
+            entry.mask = FuzzyMatcher::charMask( entry.word );
+            entry.count = it.value();
+            snapshot.entries += entry;
+            snapshot.maxCount = qMax( snapshot.maxCount, entry.count );
+        }
+        snapshot.documents = documents;
+        return snapshot;
+    }
+
+    void CompletionIndex::scheduleUpdate( void )
+    {
+        if( m_active )
+        {
+            m_updateTimer.start();
+        }
+    }
+
+    void CompletionIndex::onDocumentDestroyed( QObject* object )
+    {
+        TextDocument* textDocument = static_cast<TextDocument*>( object );
+        m_documents.removeAll( textDocument );
+        m_documentWords.remove( textDocument );
+
+        // A document made later at the same address must not take the
+        // words counted for this one.
+        const int buildIndex = m_buildDocuments.indexOf( textDocument );
+        if( buildIndex >= 0 )
+        {
+            m_buildDocuments[buildIndex] = NULL;
+        }
+        scheduleUpdate();
+    }
+
+    void CompletionIndex::onBuildFinished( void )
+    {
+        m_snapshot = m_watcher.result();
+
+        // Words counted from text replace the text, unless the document
+        // has changed since.
+        const QList<DocumentWords>& documents = m_snapshot.documents;
+        for( int i = 0; i < documents.size(); ++i )
+        {
+            QHash<TextDocument*, DocumentWords>::iterator wordsIt =
+                m_documentWords.find( m_buildDocuments.at( i ) );
+            if( ( wordsIt != m_documentWords.end() ) &&
+                ( wordsIt.value().revision == documents.at( i ).revision ) )
+            {
+                wordsIt.value() = documents.at( i );
+            }
+        }
+        m_snapshot.documents.clear();
+        m_buildDocuments.clear();
+        emit updated();
+
+        if( m_updatePending )
+        {
+            update();
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+#include "wordindex.h"
+
+namespace mote
+{
+    class TextDocument;
+
+    // Completion words of all open documents and, if given, the project's
+    // symbols. The table is rebuilt on a worker thread and swapped in on
+    // the GUI thread, so queries never wait on an update.
+    class CompletionIndex : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        struct Candidate
+        {
+            QString word;
+            int matchScore;
+            int distance;
+            int count;
+            double score;
+        };
+
+    public:
+        CompletionIndex( QObject* parent = 0 );
+
+    public:
+        void addDocument( TextDocument* textDocument );
+        void setProjectSymbols( const QStringList& names );
+        int wordCount( void )const;
+
+        QVector<Candidate> complete(
+            const FuzzyMatcher& matcher,
+            const QVector<WordIndex::Candidate>& nearby,
+            bool* truncated = NULL );
+        void accept( const QString& word );
+
+    public slots:
+        void update( void );
+
+    signals:
+        void updated( void );
+
+    private:
+        struct Entry
+        {
+            QString word;
+            quint64 mask;
+            int count;
+        };
+
+        // The words of a document at an edit revision. Those of a document
+        // whose own index has not been built are counted from its text by
+        // the worker.
+        struct DocumentWords
+        {
+            int revision;
+            QHash<QString, int> counts;
+            QString text;
+        };
+
+        struct Snapshot
+        {
+            Snapshot( void )
+                : maxCount( 0 )
+            {
+            }
+
+            QVector<Entry> entries;
+            int maxCount;
+            QList<DocumentWords> documents;
+        };
+
+        static Snapshot build(
+            QList<DocumentWords> documents,
+            const QStringList& projectSymbols );
+
+    private slots:
+        void scheduleUpdate( void );
+        void onDocumentDestroyed( QObject* object );
+        void onBuildFinished( void );
+
+    private:
+        QList<TextDocument*> m_documents;
+        QHash<TextDocument*, DocumentWords> m_documentWords;
+        QList<TextDocument*> m_buildDocuments;
+        QStringList m_projectSymbols;
+        Snapshot m_snapshot;
+        QHash<QString, int> m_acceptedAt;
+        int m_acceptCount;
+        bool m_active;
+        bool m_updatePending;
+        QTimer m_updateTimer;
+        QFutureWatcher<Snapshot> m_watcher;
+    };
+}
@@ -0,0 +1,101 @@
+#include "completionmodel.h"
+
+#include "fuzzymatcher.h"
+
+namespace mote
+{
+    CompletionModel::CompletionModel( QObject* parent )
+        : QAbstractListModel( parent ),
+          m_truncated( false )
+    {
+    }
+
+    int CompletionModel::rowCount( const QModelIndex& parent )const
+    {
+        return parent.isValid() ? 0 : m_rows.size();
+    }
+
+    QVariant CompletionModel::data( const QModelIndex& index, int role )const
+    {
+        if( !index.isValid() || ( role != Qt::DisplayRole ) )
+        {
+            return QVariant();
+        }
+
+        return m_words.at( m_rows.at( index.row() ) );
+    }
+
+    void CompletionModel::setCandidates( const QStringList& words, const QString& pattern, const bool truncated )
+    {
+        beginResetModel();
+        m_words = words;
+        m_masks.resize( words.size() );
+        m_rows.resize( words.size() );
+        for( int i = 0; i < words.size(); ++i )
+        {
+            m_masks[i] = FuzzyMatcher::charMask( words.at( i ) );
+            m_rows[i] = i;
+        }
+        m_basePattern = pattern;
+        m_pattern = pattern;
+        m_truncated = truncated;
+        endResetModel();
+    }
+
+    // Keeps the candidates matching pattern, in their original order.
+    // Returns false if pattern does not extend the one the candidates were
+    // collected for, or if they were cut short; they may then be missing
+    // words.
+    bool CompletionModel::filter( const QString& pattern )
+    {
+        if( pattern == m_pattern )
+        {
+            return true;
+        }
+        if( !pattern.startsWith( m_basePattern ) || m_truncated )
+        {
+            return false;
+        }
+
+        const FuzzyMatcher matcher( pattern );
+        QVector<int> rows;
+        rows.reserve( m_words.size() );
+        for( int i = 0; i < m_words.size(); ++i )
+        {
+            const QString& word = m_words.at( i );
+            if( matcher.mayMatch( m_masks.at( i ) ) && ( word != pattern ) && matcher.match( word ) )
+            {
+                rows += i;
+            }
+        }
+
+        beginResetModel();
+        m_pattern = pattern;
+        m_rows = rows;
+        endResetModel();
+        return true;
+    }
+
+    QString CompletionModel::pattern( void )const
+    {
+        return m_pattern;
+    }
+
+    QString CompletionModel::word( int row )const
+    {
+        return m_words.at( m_rows.at( row ) );
+    }
+
+    // Returns -1 if word is not shown.
+    int CompletionModel::row( const QString& word )const
+    {
+        for( int i = 0; i < m_rows.size(); ++i )
+        {
+            if( m_words.at( m_rows.at( i ) ) == word )
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+}
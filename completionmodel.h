@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace mote
+{
+    // The candidates of one completion request. Typing on narrows the
+    // rows in place; the candidates themselves are not rebuilt unless the
+    // request had more matches than it returned.
+    class CompletionModel : public QAbstractListModel
+    {
+        Q_OBJECT
+
+    public:
+        CompletionModel( QObject* parent = 0 );
+
+    public:
+        virtual int rowCount( const QModelIndex& parent = QModelIndex() )const;
+        virtual QVariant data( const QModelIndex& index, int role = Qt::DisplayRole )const;
+
+    public:
+        void setCandidates( const QStringList& words, const QString& pattern, const bool truncated );
+        bool filter( const QString& pattern );
+        QString pattern( void )const;
+        QString word( int row )const;
+        int row( const QString& word )const;
+
+    private:
+        QStringList m_words;
+        QVector<quint64> m_masks;
+        QString m_basePattern;
+        QString m_pattern;
+        QVector<int> m_rows;
+        bool m_truncated;
+    };
+}
@@ -1,5 +1,8 @@
 #include "cppsyntaxhighlighter.h"
 
+#include "blockdata.h"
+#include "frameprofiler.h"
+
 #define STATE_VALUE_MASK          0x00000FFF
 #define STATE_FLAGS_MASK          0x7FFFF000
 
@@ -23,6 +26,8 @@ namespace mote
 
     void CppSyntaxHighlighter::highlightBlock( const QString& text )
     {
+        FrameProfiler::Scope scope( FrameProfiler::HighlightPhase );
+
         int state = previousBlockState();
         if( state == -1 )
         {
@@ -32,6 +37,11 @@ namespace mote
         int stateValue = ( state & STATE_VALUE_MASK );
         int stateFlags = ( state & STATE_FLAGS_MASK );
 
+        // Brackets are counted along the way for the indenter.
+        BlockData::Syntax syntax;
+        QVector<int> openParens;
+        bool leading = true;
+
         bool escapeString = false;
         int startPos = 0;
         for( int i = 0; i < text.length(); ++i )
@@ -43,6 +53,10 @@ namespace mote
             }
 
             const QChar ch = text[i];
+            if( !ch.isSpace() && ( ch != '}' ) )
+            {
+                leading = false;
+            }
 
             if( ch == '\\' )
             {
@@ -112,6 +126,47 @@ namespace mote
                     }
                 }
             }
+            else if( stateValue == 0 )
+            {
+                switch( ch.unicode() )
+                {
+                case '{':
+                    ++syntax.braceDelta;
+                    break;
+                case '}':
+                    --syntax.braceDelta;
+                    if( leading )
+                    {
+                        ++syntax.leadingCloseCount;
+                    }
+                    break;
+                case '(':
+                    openParens += i;
+                    break;
+                case ')':
+                    if( !openParens.isEmpty() )
+                    {
+                        openParens.pop_back();
+                    }
+                    else
+                    {
+                        ++syntax.parenCloseCount;
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+
+        for( int i = 0; i < openParens.size(); ++i )
+        {
+            int column = openParens.at( i ) + 1;
+            while( ( column < text.length() ) && text.at( column ).isSpace() )
+            {
+                ++column;
+            }
+            syntax.parenColumns += ( column < text.length() ) ? column : -1;
         }
 
         switch( stateValue )
@@ -146,6 +201,10 @@ namespace mote
             break;
         }
 
+        syntax.valid = true;
+        syntax.endsInComment = ( stateValue == STATE_BLOCK_COMMENT );
+        BlockData::get( currentBlock() )->setSyntax( syntax );
+
         if( stateValue | stateFlags )
         {
             setCurrentBlockState( stateValue | stateFlags );
@@ -4,19 +4,101 @@
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
 #include <QProcess>
-#include <QRegExp>
 #include <QStringList>
 #include <QTemporaryFile>
-#include <QTextStream>
 #include <QUrl>
+#include <QVector>
+
+#include <cstring>
 
 namespace mote
 {
+    // Entries are kept column by column. Tag names stay in the tags file
+    // (mapped, or copied into 'buffer') and are only decoded on request;
+    // file names, kinds and scopes repeat a lot, so they are interned and
+    // stored as ids into 'strings', where id 0 is the empty string.
+    struct CTags::Data : public QSharedData
+    {
+        Data( void )
+            : text( NULL ),
+              textSize( 0 )
+        {
+            strings += QString();
+        }
+
+        const char* data( void )const
+        {
+            return text ? text : buffer.constData();
+        }
+
+        int intern( const char* string, const int length )
+        {
+            if( length <= 0 )
+            {
+                return 0;
+            }
+
+            const QByteArray key = QByteArray::fromRawData( string, length );
+            QHash<QByteArray, int>::const_iterator itr = stringIds.find( key );
+            if( itr != stringIds.end() )
+            {
+                return itr.value();
+            }
+
+            const int id = strings.size();
+            strings += QString::fromUtf8( string, length );
+            stringIds.insert( QByteArray( string, length ), id );
+            return id;
+        }
+
+        void detachFile( void )
+        {
+            if( file )
+            {
+                buffer = QByteArray( text, textSize );
+                file.clear();
+                text = NULL;
+            }
+        }
+
+        QSharedPointer<QFile> file;
+        const char* text;
+        int textSize;
+        QByteArray buffer;
+
+        QVector<int> nameOffsets;
+        QVector<int> nameLengths;
+        QVector<int> fileIds;
+        QVector<int> lineNumbers;
+        QVector<int> kindIds;
+        QVector<int> scopeIds;
+
+        QVector<QString> strings;
+        QHash<QByteArray, int> stringIds;
+    };
+
     CTags::CTags( void )
+        : m_data( new Data )
     {
     }
 
+    CTags::CTags( const CTags& other )
+        : m_data( other.m_data )
+    {
+    }
+
+    CTags::~CTags()
+    {
+    }
+
+    CTags& CTags::operator=( const CTags& other )
+    {
+        m_data = other.m_data;
+        return *this;
+    }
+
     bool CTags::exec( const QTextDocument* document )
     {
         if( !document )
@@ -24,41 +106,44 @@ namespace mote
             return false;
         }
 
+        const QString fileName =
+            QFileInfo( QUrl( document->metaInformation( QTextDocument::DocumentUrl ) ).toLocalFile() ).fileName();
+
+        return exec( fileName, document->toPlainText().toUtf8() );
+    }
+
+    bool CTags::exec( const QString& fileName, const QByteArray& content )
+    {
         const QString program = findCTags();
         if( program.isEmpty() )
         {
             return false;
         }
 
-        QString fileName =
-            QFileInfo( QUrl( document->metaInformation( QTextDocument::DocumentUrl ) ).toLocalFile() ).fileName();
-        if( fileName.isEmpty() )
-        {
-            fileName = "temp.cpp";
-        }
-
         QTemporaryFile tempFile(
-            QDir( QDir::tempPath() ).filePath( QString( "XXXXXX_%1" ).arg( fileName ) ) );
+            QDir( QDir::tempPath() ).filePath(
+                QString( "XXXXXX_%1" ).arg( fileName.isEmpty() ? QString( "temp.cpp" ) : fileName ) ) );
         if( !tempFile.open() )
         {
             return false;
         }
-        tempFile.write( document->toPlainText().toUtf8() );
+        tempFile.write( content );
         tempFile.close();
 
-        QTemporaryFile tagsFile;
-        if( !tagsFile.open() )
+        // Kept alive by readTags() as long as the entries refer to it.
+        QSharedPointer<QTemporaryFile> tagsFile( new QTemporaryFile );
+        if( !tagsFile->open() )
         {
             return false;
         }
-        tagsFile.close();
+        tagsFile->close();
 
         QStringList args;
         args += "--fields=Ksz";
         args += "-n";
         args += "-u";
         args += "-f";
-        args += tagsFile.fileName();
+        args += tagsFile->fileName();
         args += tempFile.fileName();
 
         const int ret = QProcess::execute( program, args );
@@ -68,69 +153,118 @@ namespace mote
             return false;
         }
 
-        return readTags( tagsFile.fileName() );
+        return readTags( tagsFile );
     }
 
-    QString CTags::Entry::scope( void )const
+    bool CTags::exec( const QStringList& paths, const QString& workingDirectory )
     {
-        for( int i = 0; i < extensionFields.size(); ++i )
+        const QString program = findCTags();
+        if( program.isEmpty() )
         {
-            const QString& field = extensionFields.at( i );
-            if( field.startsWith( "file:" ) )
-            {
-                // Global
-                break;
-            }
-            else if( field.startsWith( "class:" ) )
-            {
-                return field.mid( 6 );
-            }
-            else if( field.startsWith( "enum:" ) )
-            {
-                return field.mid( 5 );
-            }
-            else if( field.startsWith( "function:" ) )
-            {
-                return field.mid( 9 );
-            }
-            else if( field.startsWith( "struct:" ) )
-            {
-                return field.mid( 7 );
-            }
-            else if( field.startsWith( "union:" ) )
-            {
-                return field.mid( 6 );
-            }
+            return false;
         }
 
-        return QString();
-    }
+        // Pass the file names through -L to stay clear of command line limits.
+        QTemporaryFile listFile;
+        if( !listFile.open() )
+        {
+            return false;
+        }
+        for( int i = 0; i < paths.size(); ++i )
+        {
+            listFile.write( QFile::encodeName( paths.at( i ) ) );
+            listFile.write( "\n" );
+        }
+        listFile.close();
 
-    QString CTags::Entry::kind( void )const
-    {
-        for( int i = 0; i < extensionFields.size(); ++i )
+        // Kept alive by readTags() as long as the entries refer to it.
+        QSharedPointer<QTemporaryFile> tagsFile( new QTemporaryFile );
+        if( !tagsFile->open() )
         {
-            const QString& field = extensionFields.at( i );
-            if( field.startsWith( "kind:" ) )
-            {
-                return field.mid( 5 );
-            }
+            return false;
         }
+        tagsFile->close();
 
-        return QString();
+        QStringList args;
+        args += "--fields=Ksz";
+        args += "-n";
+        args += "-u";
+        args += "-f";
+        args += tagsFile->fileName();
+        args += "-L";
+        args += listFile.fileName();
+
+        QProcess process;
+        process.setWorkingDirectory( workingDirectory );
+        process.setStandardOutputFile( QProcess::nullDevice() );
+        process.setStandardErrorFile( QProcess::nullDevice() );
+        process.start( program, args );
+        if( !process.waitForStarted() )
+        {
+            // ctags not exist
+            return false;
+        }
+        process.waitForFinished( -1 );
+
+        return readTags( tagsFile );
     }
 
     int CTags::count( void )const
     {
-        return m_entries.size();
+        return m_data->nameOffsets.size();
     }
 
-    const CTags::Entry& CTags::entry( int index )const
+    QString CTags::tagName( int index )const
     {
-        return m_entries.at( index );
+        return QString::fromUtf8(
+                   m_data->data() + m_data->nameOffsets.at( index ),
+                   m_data->nameLengths.at( index ) );
     }
 
-    QString CTags::findCTags( void )const
+    QString CTags::fileName( int index )const
+    {
+        return m_data->strings.at( m_data->fileIds.at( index ) );
+    }
+
+    int CTags::lineNumber( int index )const
+    {
+        return m_data->lineNumbers.at( index );
+    }
+
+    QString CTags::kind( int index )const
+    {
+        return m_data->strings.at( m_data->kindIds.at( index ) );
+    }
+
+    QString CTags::scope( int index )const
+    {
+        return m_data->strings.at( m_data->scopeIds.at( index ) );
+    }
+
+    void CTags::append(
+        const QString& tagName,
+        const QString& fileName,
+        int lineNumber,
+        const QString& kind,
+        const QString& scope )
+    {
+        m_data->detachFile();
+
+        const QByteArray name = tagName.toUtf8();
+        const QByteArray file = fileName.toUtf8();
+        const QByteArray kindName = kind.toUtf8();
+        const QByteArray scopeName = scope.toUtf8();
+
+        m_data->nameOffsets += m_data->buffer.size();
+        m_data->nameLengths += name.size();
+        m_data->buffer += name;
+        m_data->fileIds += m_data->intern( file.constData(), file.size() );
+        m_data->lineNumbers += lineNumber;
+        m_data->kindIds += m_data->intern( kindName.constData(), kindName.size() );
+        m_data->scopeIds += m_data->intern( scopeName.constData(), scopeName.size() );
+    }
+
+    QString CTags::findCTags( void )
     {
 #ifdef Q_OS_MAC
         // mote.app/Contents/MacOS/mote
@@ -156,41 +290,176 @@ namespace mote
 #endif
     }
 
-    bool CTags::readTags( const QString& path )
+    bool CTags::isScopeKind( const QByteArray& kind )
     {
-        QFile file( path );
-        if( !file.open( QIODevice::ReadOnly | QIODevice::Text ) )
+        return ( kind == "class" ) ||
+               ( kind == "enum" ) ||
+               ( kind == "function" ) ||
+               ( kind == "struct" ) ||
+               ( kind == "union" );
+    }
+
+    bool CTags::readTags( const QSharedPointer<QFile>& file )
+    {
+        if( !file->open( QIODevice::ReadOnly ) )
         {
             return false;
         }
 
-        m_entries.clear();
+        QSharedDataPointer<Data> data( new Data );
 
-        QTextStream stream( &file );
-        QRegExp regExp( "([^\\t]+)\\t+([^\\t]+)\\t+([^\\t]+);\"\\t+(.*)" );
-        while( !stream.atEnd() )
+        // Map the file and keep it mapped; tag names point into it.
+        const qint64 size = file->size();
+        if( size > 0x7FFFFFFF )
+        {
+            return false;
+        }
+        const char* text = NULL;
+        if( size > 0 )
         {
-            const QString line = stream.readLine();
+            text = reinterpret_cast<const char*>( file->map( 0, size ) );
+            if( text )
+            {
+                data->file = file;
+                data->text = text;
+                data->textSize = size;
+            }
+            else
+            {
+                data->buffer = file->readAll();
+                text = data->buffer.constData();
+            }
+        }
 
-            if( line.startsWith( "!" ) )
+        const char* const end = text + size;
+
+        int lineCount = 0;
+        for( const char* p = text; p < end; ++p )
+        {
+            p = static_cast<const char*>( memchr( p, '\n', end - p ) );
+            if( !p )
             {
+                break;
+            }
+            ++lineCount;
+        }
+        data->nameOffsets.reserve( lineCount );
+        data->nameLengths.reserve( lineCount );
+        data->fileIds.reserve( lineCount );
+        data->lineNumbers.reserve( lineCount );
+        data->kindIds.reserve( lineCount );
+        data->scopeIds.reserve( lineCount );
+
+        // {tagname}<Tab>{tagfile}<Tab>{tagaddress};"<Tab>{field}..
+        const char* line = text;
+        while( line < end )
+        {
+            const char* lineEnd = static_cast<const char*>( memchr( line, '\n', end - line ) );
+            if( !lineEnd )
+            {
+                lineEnd = end;
+            }
+            const char* next = lineEnd + 1;
+            if( ( lineEnd > line ) && ( lineEnd[-1] == '\r' ) )
+            {
+                --lineEnd;
+            }
+
+            if( ( line == lineEnd ) || ( *line == '!' ) )
+            {
+                line = next;
                 continue;
             }
 
-            if( !regExp.exactMatch( line ) )
+            const char* nameEnd = static_cast<const char*>( memchr( line, '\t', lineEnd - line ) );
+            const char* fileBegin = nameEnd;
+            while( fileBegin && ( fileBegin < lineEnd ) && ( *fileBegin == '\t' ) )
+            {
+                ++fileBegin;
+            }
+            const char* fileEnd =
+                ( fileBegin && ( fileBegin < lineEnd ) ) ?
+                static_cast<const char*>( memchr( fileBegin, '\t', lineEnd - fileBegin ) ) : NULL;
+            if( ( nameEnd == line ) || !fileEnd || ( fileBegin == fileEnd ) )
             {
-                qWarning( qPrintable( QString( "ctags: unexpected data: %1" ).arg( line ) ) );
+                qWarning( "ctags: unexpected data: %s", QByteArray( line, lineEnd - line ).constData() );
+                line = next;
                 continue;
             }
 
-            Entry entry;
-            entry.tagName = regExp.cap( 1 );
-            entry.fileName = regExp.cap( 2 );
-            entry.exCmd = regExp.cap( 3 );
-            entry.extensionFields = regExp.cap( 4 ).split( '\t' );
-            m_entries.push_back( entry );
+            const char* address = fileEnd;
+            while( ( address < lineEnd ) && ( *address == '\t' ) )
+            {
+                ++address;
+            }
+
+            int lineNumber = 0;
+            const char* p = address;
+            for( ; ( p < lineEnd ) && ( *p >= '0' ) && ( *p <= '9' ); ++p )
+            {
+                lineNumber = lineNumber * 10 + ( *p - '0' );
+            }
+
+            // A pattern address may contain tabs; the fields start after ;"<Tab>.
+            while( ( p + 1 < lineEnd ) &&
+                   !( ( p[0] == ';' ) && ( p[1] == '"' ) && ( ( p + 2 == lineEnd ) || ( p[2] == '\t' ) ) ) )
+            {
+                ++p;
+            }
+            p += 2;
+
+            int kindId = 0;
+            int scopeId = 0;
+            bool global = false;
+            while( p < lineEnd )
+            {
+                if( *p == '\t' )
+                {
+                    ++p;
+                    continue;
+                }
+
+                const char* fieldEnd = static_cast<const char*>( memchr( p, '\t', lineEnd - p ) );
+                if( !fieldEnd )
+                {
+                    fieldEnd = lineEnd;
+                }
+
+                const char* colon = static_cast<const char*>( memchr( p, ':', fieldEnd - p ) );
+                if( colon )
+                {
+                    const QByteArray key = QByteArray::fromRawData( p, colon - p );
+                    if( key == "kind" )
+                    {
+                        if( kindId == 0 )
+                        {
+                            kindId = data->intern( colon + 1, fieldEnd - colon - 1 );
+                        }
+                    }
+                    else if( key == "file" )
+                    {
+                        global = true;
+                    }
+                    else if( !global && ( scopeId == 0 ) && isScopeKind( key ) )
+                    {
+                        scopeId = data->intern( colon + 1, fieldEnd - colon - 1 );
+                    }
+                }
+
+                p = fieldEnd;
+            }
+
+            data->nameOffsets += line - text;
+            data->nameLengths += nameEnd - line;
+            data->fileIds += data->intern( fileBegin, fileEnd - fileBegin );
+            data->lineNumbers += lineNumber;
+            data->kindIds += kindId;
+            data->scopeIds += scopeId;
+
+            line = next;
         }
 
+        m_data = data;
         return true;
     }
 }
@@ -1,39 +1,54 @@
 #pragma once
 
-#include <QList>
+#include <QByteArray>
+#include <QMetaType>
+#include <QSharedDataPointer>
+#include <QSharedPointer>
 #include <QString>
 #include <QStringList>
 #include <QTextDocument>
 
+class QFile;
+
 namespace mote
 {
     class CTags
     {
     public:
         CTags( void );
+        CTags( const CTags& other );
+        ~CTags();
+        CTags& operator=( const CTags& other );
 
     public:
         bool exec( const QTextDocument* document );
+        bool exec( const QString& fileName, const QByteArray& content );
+        bool exec( const QStringList& paths, const QString& workingDirectory );
 
     public:
-        struct Entry
-        {
-            QString tagName;
-            QString fileName;
-            QString exCmd;
-            QStringList extensionFields;
-            QString scope( void )const;
-            QString kind( void )const;
-        };
-
         int count( void )const;
-        const Entry& entry( int index )const;
+        QString tagName( int index )const;
+        QString fileName( int index )const;
+        int lineNumber( int index )const;
+        QString kind( int index )const;
+        QString scope( int index )const;
+        void append(
+            const QString& tagName,
+            const QString& fileName,
+            int lineNumber,
+            const QString& kind,
+            const QString& scope );
+
+        static QString findCTags( void );
+        static bool isScopeKind( const QByteArray& kind );
 
     private:
-        QString findCTags( void )const;
-        bool readTags( const QString& path );
+        bool readTags( const QSharedPointer<QFile>& file );
 
     private:
-        QList<Entry> m_entries;
+        struct Data;
+        QSharedDataPointer<Data> m_data;
     };
 }
+
+Q_DECLARE_METATYPE( mote::CTags )
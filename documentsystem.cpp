@@ -1,21 +1,52 @@
 #include "documentsystem.h"
 
+#include <QFileInfo>
+
+#include "completionindex.h"
 #include "settings.h"
+#include "symbolindex.h"
+#include "tagservice.h"
 #include "textdocument.h"
+#include "textedit.h"
 
 namespace mote
 {
     DocumentSystem::DocumentSystem( Settings* settings, QObject* parent )
-        : QObject( parent )
+        : QObject( parent ),
+          m_settings( settings ),
+          m_tagService( new TagService( this ) ),
+          m_symbolIndex( new SymbolIndex( this ) ),
+          m_completionIndex( new CompletionIndex( this ) )
     {
         connect(
             settings, SIGNAL( fontChanged( const QFont& ) ),
             SLOT( onFontChanged( const QFont& ) ) );
+        connect(
+            settings, SIGNAL( projectDirectoryChanged( const QString& ) ),
+            m_symbolIndex, SLOT( setRootPath( const QString& ) ) );
+        connect(
+            settings, SIGNAL( completeProjectSymbolsChanged( bool ) ),
+            SLOT( updateProjectSymbols( void ) ) );
+        connect(
+            m_symbolIndex, SIGNAL( updateFinished( bool ) ),
+            SLOT( updateProjectSymbols( void ) ) );
+
+        m_symbolIndex->setRootPath( settings->projectDirectory() );
+        m_formatterProfiles.restore( settings );
+        updateProjectSymbols();
     }
 
     TextDocument* DocumentSystem::createDocument( void )
     {
         TextDocument* textDocument = new TextDocument( this );
+        textDocument->setFormatterProfiles( &m_formatterProfiles );
+        textDocument->setCompletionIndex( m_completionIndex );
+        m_completionIndex->addDocument( textDocument );
+        // Registered before being forwarded, so that receivers find the
+        // document under its new path.
+        connect(
+            textDocument, SIGNAL( filePathChanged( TextDocument* ) ),
+            SLOT( onFilePathChanged( TextDocument* ) ) );
         connect(
             textDocument, SIGNAL( filePathChanged( TextDocument* ) ),
             SIGNAL( filePathChanged( TextDocument* ) ) );
@@ -34,6 +65,96 @@ namespace mote
         return textDocument;
     }
 
+    TagService* DocumentSystem::tagService( void )const
+    {
+        return m_tagService;
+    }
+
+    SymbolIndex* DocumentSystem::symbolIndex( void )const
+    {
+        return m_symbolIndex;
+    }
+
+    FormatterProfiles* DocumentSystem::formatterProfiles( void )
+    {
+        return &m_formatterProfiles;
+    }
+
+    CompletionIndex* DocumentSystem::completionIndex( void )const
+    {
+        return m_completionIndex;
+    }
+
+    // Views are registered by whoever creates them. One destroyed without
+    // being removed, such as the last tab of a closed window, removes
+    // itself.
+    void DocumentSystem::addEdit( TextEdit* textEdit )
+    {
+        TextDocument* textDocument = qobject_cast<TextDocument*>( textEdit->document() );
+        if( !textDocument || m_editDocuments.contains( textEdit ) )
+        {
+            return;
+        }
+
+        m_edits[textDocument].append( textEdit );
+        m_editDocuments.insert( textEdit, textDocument );
+        connect(
+            textEdit, SIGNAL( destroyed( QObject* ) ),
+            SLOT( onEditDestroyed( QObject* ) ) );
+
+        if( !m_documentPaths.contains( textDocument ) )
+        {
+            onFilePathChanged( textDocument );
+        }
+    }
+
+    // A document left without views is no longer open; its path is free
+    // for the next document opened on it.
+    void DocumentSystem::removeEdit( TextEdit* textEdit )
+    {
+        disconnect(
+            textEdit, SIGNAL( destroyed( QObject* ) ),
+            this, SLOT( onEditDestroyed( QObject* ) ) );
+        onEditDestroyed( textEdit );
+    }
+
+    QList<TextEdit*> DocumentSystem::findEdits( TextDocument* textDocument )const
+    {
+        return m_edits.value( textDocument );
+    }
+
+    QList<TextEdit*> DocumentSystem::findEdits( const QString& path )const
+    {
+        return m_edits.value( findDocument( path ) );
+    }
+
+    TextDocument* DocumentSystem::findDocument( const QString& path )const
+    {
+        return path.isEmpty() ? NULL : m_documents.value( canonicalPath( path ) );
+    }
+
+    // The canonical paths of the documents shown in a view.
+    QSet<QString> DocumentSystem::openFilePaths( void )const
+    {
+        return QSet<QString>::fromList( m_documents.keys() );
+    }
+
+    // The key documents are registered under: links resolved where the
+    // file exists, and case folded where the file system ignores case.
+    QString DocumentSystem::canonicalPath( const QString& path )
+    {
+        const QFileInfo fileInfo( path );
+        QString canonicalPath = fileInfo.canonicalFilePath();
+        if( canonicalPath.isEmpty() )
+        {
+            canonicalPath = fileInfo.absoluteFilePath();
+        }
+#if defined( Q_OS_WIN ) || defined( Q_OS_MAC )
+        canonicalPath = canonicalPath.toLower();
+#endif
+        return canonicalPath;
+    }
+
     void DocumentSystem::onModificationChanged( void )
     {
         emit modificationChanged( qobject_cast<TextDocument*>( sender() ) );
@@ -51,4 +172,64 @@ namespace mote
             }
         }
     }
+
+    void DocumentSystem::updateProjectSymbols( void )
+    {
+        if( m_settings->completeProjectSymbols() )
+        {
+            m_completionIndex->setProjectSymbols( m_symbolIndex->names() );
+        }
+        else
+        {
+            m_completionIndex->setProjectSymbols( QStringList() );
+        }
+    }
+
+    void DocumentSystem::onFilePathChanged( TextDocument* textDocument )
+    {
+        const QString oldPath = m_documentPaths.take( textDocument );
+        if( !oldPath.isEmpty() && ( m_documents.value( oldPath ) == textDocument ) )
+        {
+            m_documents.remove( oldPath );
+        }
+
+        if( textDocument->filePath().isEmpty() || !m_edits.contains( textDocument ) )
+        {
+            return;
+        }
+
+        const QString path = canonicalPath( textDocument->filePath() );
+        m_documents.insert( path, textDocument );
+        m_documentPaths.insert( textDocument, path );
+    }
+
+    // Only the address is used; the view may be half destroyed.
+    void DocumentSystem::onEditDestroyed( QObject* object )
+    {
+        TextDocument* textDocument = m_editDocuments.take( object );
+        if( !textDocument )
+        {
+            return;
+        }
+
+        QList<TextEdit*>& edits = m_edits[textDocument];
+        for( int i = 0; i < edits.size(); ++i )
+        {
+            if( static_cast<QObject*>( edits.at( i ) ) == object )
+            {
+                edits.removeAt( i );
+                break;
+            }
+        }
+
+        if( edits.isEmpty() )
+        {
+            m_edits.remove( textDocument );
+            const QString path = m_documentPaths.take( textDocument );
+            if( m_documents.value( path ) == textDocument )
+            {
+                m_documents.remove( path );
+            }
+        }
+    }
 }
@@ -1,12 +1,22 @@
 #pragma once
 
 #include <QFont>
+#include <QHash>
+#include <QList>
 #include <QObject>
+#include <QSet>
+#include <QString>
+
+#include "formatterprofiles.h"
 
 namespace mote
 {
+    class CompletionIndex;
     class Settings;
+    class SymbolIndex;
+    class TagService;
     class TextDocument;
+    class TextEdit;
 
     class DocumentSystem : public QObject
     {
@@ -17,6 +27,19 @@ namespace mote
 
     public:
         TextDocument* createDocument( void );
+        TagService* tagService( void )const;
+        SymbolIndex* symbolIndex( void )const;
+        FormatterProfiles* formatterProfiles( void );
+        CompletionIndex* completionIndex( void )const;
+
+        void addEdit( TextEdit* textEdit );
+        void removeEdit( TextEdit* textEdit );
+        QList<TextEdit*> findEdits( TextDocument* textDocument )const;
+        QList<TextEdit*> findEdits( const QString& path )const;
+        TextDocument* findDocument( const QString& path )const;
+        QSet<QString> openFilePaths( void )const;
+
+        static QString canonicalPath( const QString& path );
 
     signals:
         void filePathChanged( TextDocument* textDocument );
@@ -28,5 +51,19 @@ namespace mote
     private slots:
         void onModificationChanged( void );
         void onFontChanged( const QFont& font );
+        void updateProjectSymbols( void );
+        void onFilePathChanged( TextDocument* textDocument );
+        void onEditDestroyed( QObject* object );
+
+    private:
+        Settings* m_settings;
+        TagService* m_tagService;
+        SymbolIndex* m_symbolIndex;
+        CompletionIndex* m_completionIndex;
+        FormatterProfiles m_formatterProfiles;
+        QHash< TextDocument*, QList<TextEdit*> > m_edits;
+        QHash<QObject*, TextDocument*> m_editDocuments;
+        QHash<QString, TextDocument*> m_documents;
+        QHash<TextDocument*, QString> m_documentPaths;
     };
 }
@@ -1,106 +1,131 @@
 #include "textedit.h"
 
-#ifdef Q_OS_WIN
-#define STDCALL __stdcall
-#else
-#define STDCALL
-#endif
+#include <QtConcurrent>
 
-extern "C"
-{
-    char* STDCALL AStyleMain(
-        const char* textIn,
-        const char* options,
-        void( STDCALL *errorHandler )( int, char* ),
-        char*( STDCALL *memoryAlloc )( unsigned long ) );
-
-}
+#include "textdocument.h"
 
 namespace mote
 {
-    static void STDCALL errorHandler( int /*errorNumber*/, char* /*errorMessage*/ )
+    // The document may be edited while AStyle runs; a result for an older
+    // revision is thrown away and the range is formatted again, a few times
+    // at most.
+    static const int MaxFormatRetryCount = 3;
+
+    void TextEdit::formatSourceCode( void )
     {
+        QTextCursor textCursor = this->textCursor();
+        if( !textCursor.hasSelection() )
+        {
+            return;
+        }
+
+        m_formatRange = textCursor;
+        m_formatRetryCount = 0;
+        startFormatting();
     }
 
-    static char* STDCALL memoryAlloc( unsigned long memoryNeeded )
+    void TextEdit::formatWholeSourceCode( void )
     {
-        return new char[memoryNeeded];
+        QTextCursor textCursor( document() );
+        textCursor.select( QTextCursor::Document );
+
+        m_formatRange = textCursor;
+        m_formatRetryCount = 0;
+        startFormatting();
     }
 
-    static int calcIndent( const int tab_num, const QString& text )
+    bool TextEdit::isFormatting( void )const
     {
-        if( tab_num == 0 )
+        return !m_formatRange.isNull();
+    }
+
+    void TextEdit::cancelFormatting( void )
+    {
+        // AStyle cannot be interrupted; its result is just ignored.
+        m_formatRange = QTextCursor();
+        m_formatRestart = false;
+    }
+
+    void TextEdit::startFormatting( void )
+    {
+        if( m_formatWatcher.isRunning() )
         {
-            return 0;
+            m_formatRestart = true;
+            return;
         }
 
-        int column = 0;
-        for( int i = 0; i < text.length() ; ++i )
+        const TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+        if( !textDocument || m_formatRange.isNull() )
         {
-            const QChar ch = text[i];
-            if ( ch == ' ' )
-            {
-                ++column;
-            }
-            else if ( ch == '\t' )
-            {
-                column = ( ( column / tab_num ) + 1 ) * tab_num;
-            }
-            else
-            {
-                break;
-            }
+            return;
         }
 
-        return column / tab_num;
+        const QString text = textDocument->text( m_formatRange.selectionStart(), m_formatRange.selectionEnd() );
+
+        m_formatStart = m_formatRange.selectionStart();
+        m_formatRevision = textDocument->editRevision();
+        m_formatWatcher.setFuture(
+            QtConcurrent::run(
+                textDocument->sourceFormatter( tabStopWidthBySpace() ),
+                &SourceFormatter::formatEdits,
+                text ) );
     }
 
-    void TextEdit::formatSourceCode( void )
+    void TextEdit::onFormattingFinished( void )
     {
-        QTextCursor textCursor = this->textCursor();
-        if( !textCursor.hasSelection() )
+        if( m_formatRestart )
         {
+            m_formatRestart = false;
+            startFormatting();
             return;
         }
 
-        QString option = "mode=c indent-namespaces pad-oper pad-paren-in convert-tabs style=break indent-cases min-conditional-indent=0 max-instatement-indent=70";
-        option += QString( " indent=spaces=%1" ).arg( tabStopWidthBySpace() );
-
-        QString text = textCursor.selectedText();
-        text.replace( QChar( 0x2029 ), '\n' );
+        const TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+        if( !textDocument || m_formatRange.isNull() )
+        {
+            return;
+        }
 
-        char* textOut = AStyleMain(
-                            text.toUtf8().constData(),
-                            option.toUtf8().constData(),
-                            errorHandler,
-                            memoryAlloc );
-        QString formattedText = QString::fromUtf8( textOut );
-        delete[] textOut;
-        textOut = NULL;
+        const SourceFormatter::Result result = m_formatWatcher.result();
+        if( !result.ok )
+        {
+            m_formatRange = QTextCursor();
+            return;
+        }
 
-        const int indent = calcIndent( tabStopWidthBySpace(), text );
-        if( indent > 0 )
+        if( textDocument->editRevision() != m_formatRevision )
         {
-            const QStringList lines = formattedText.split( '\n' );
-            formattedText.clear();
-            for( int i = 0; i < lines.size(); ++i )
+            if( ++m_formatRetryCount <= MaxFormatRetryCount )
+            {
+                startFormatting();
+            }
+            else
             {
-                const QString& line = lines.at( i );
-                if( !line.isEmpty() )
-                {
-                    formattedText += QString( indent * tabStopWidthBySpace(), ' ' );
-                    formattedText += line;
-                }
-                if( i < lines.size() - 1 )
-                {
-                    formattedText += '\n';
-                }
+                m_formatRange = QTextCursor();
             }
+            return;
+        }
+
+        m_formatRange = QTextCursor();
+
+        // Only the changed lines are replaced, back to front so that the
+        // positions of the earlier edits stay valid.
+        if( result.edits.isEmpty() )
+        {
+            return;
         }
 
+        QTextCursor textCursor( document() );
         textCursor.beginEditBlock();
-        textCursor.deleteChar();
-        textCursor.insertText( formattedText );
+        for( int i = result.edits.size() - 1; i >= 0; --i )
+        {
+            const SourceFormatter::Edit& edit = result.edits.at( i );
+            textCursor.setPosition( textDocument->advance( m_formatStart, edit.position ) );
+            textCursor.setPosition(
+                textDocument->advance( m_formatStart, edit.position + edit.length ),
+                QTextCursor::KeepAnchor );
+            textCursor.insertText( edit.text );
+        }
         textCursor.endEditBlock();
     }
 }
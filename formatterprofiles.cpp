@@ -0,0 +1,259 @@
+#include "formatterprofiles.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QTextStream>
+
+#include "settings.h"
+
+namespace mote
+{
+    namespace
+    {
+        // Where the style file of a directory is, or that it has none, is
+        // looked up again after this many milliseconds, so that one made,
+        // moved or removed later is noticed.
+        const qint64 StyleFileLookupInterval = 2000;
+
+        // Options are separated as AStyle separates them; the long form may
+        // be written with or without the leading dashes.
+        bool specifiesIndent( const QString& options )
+        {
+            const QStringList tokens = options.split( QRegExp( "[\\s,]+" ), QString::SkipEmptyParts );
+            for( int i = 0; i < tokens.size(); ++i )
+            {
+                const QString& token = tokens.at( i );
+                if( token.startsWith( "--" ) || !token.startsWith( '-' ) )
+                {
+                    const QString name = token.mid( token.startsWith( "--" ) ? 2 : 0 ).section( '=', 0, 0 );
+                    if( name == "indent" )
+                    {
+                        return true;
+                    }
+                }
+                else if( ( token == "-s" ) || ( token == "-t" ) || ( token == "-T" ) ||
+                         ( ( token.size() > 2 ) &&
+                           ( token.startsWith( "-s" ) || token.startsWith( "-t" ) || token.startsWith( "-T" ) ) &&
+                           token.at( 2 ).isDigit() ) )
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+
+    FormatterProfiles::FormatterProfiles( void )
+        : m_revision( 0 )
+    {
+        m_clock.start();
+    }
+
+    QList<FormatterProfiles::Profile> FormatterProfiles::profiles( void )const
+    {
+        return m_profiles;
+    }
+
+    void FormatterProfiles::setProfiles( const QList<Profile>& profiles )
+    {
+        m_profiles = profiles;
+        clearCache();
+    }
+
+    int FormatterProfiles::revision( void )const
+    {
+        return m_revision;
+    }
+
+    SourceFormatter FormatterProfiles::formatter( const QString& filePath, const int indentWidth )const
+    {
+        // An .astylerc next to the file or in a parent directory wins, then
+        // the first profile with a matching pattern, then the built-in style.
+        QString options;
+        if( !filePath.isEmpty() )
+        {
+            const QFileInfo info( filePath );
+            options = styleFileOptions( info.absolutePath() );
+            if( options.isNull() )
+            {
+                for( int i = 0; i < m_profiles.size(); ++i )
+                {
+                    const Profile& profile = m_profiles.at( i );
+                    if( QDir::match( profile.patterns, info.fileName() ) )
+                    {
+                        options = profile.options;
+                        if( !specifiesIndent( options ) )
+                        {
+                            options += QString( " indent=spaces=%1" ).arg( indentWidth );
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+        if( options.isNull() )
+        {
+            options = SourceFormatter::defaultOptions( indentWidth );
+        }
+
+        // Keyed by indent width too: it also re-indents selections.
+        const QString key = QString::number( indentWidth ) + '\n' + options;
+        QHash<QString, SourceFormatter>::const_iterator itr = m_formatters.find( key );
+        if( itr != m_formatters.end() )
+        {
+            return itr.value();
+        }
+
+        const SourceFormatter formatter( options, indentWidth );
+        m_formatters.insert( key, formatter );
+        return formatter;
+    }
+
+    // The style file that applies to a file, or an empty string if none.
+    QString FormatterProfiles::styleFile( const QString& filePath )const
+    {
+        if( filePath.isEmpty() )
+        {
+            return QString();
+        }
+        return styleFilePath( QFileInfo( filePath ).absolutePath() );
+    }
+
+    void FormatterProfiles::clearCache( void )
+    {
+        m_styleFilePaths.clear();
+        m_styleFiles.clear();
+        m_formatters.clear();
+        ++m_revision;
+    }
+
+    void FormatterProfiles::save( Settings* settings )const
+    {
+        settings->beginWriteArray( "formatterProfiles", m_profiles.size() );
+        for( int i = 0; i < m_profiles.size(); ++i )
+        {
+            const Profile& profile = m_profiles.at( i );
+            settings->setArrayIndex( i );
+            settings->setValue( "name", profile.name );
+            settings->setValue( "patterns", profile.patterns );
+            settings->setValue( "options", profile.options );
+        }
+        settings->endArray();
+    }
+
+    void FormatterProfiles::restore( Settings* settings )
+    {
+        QList<Profile> profiles;
+        const int count = settings->beginReadArray( "formatterProfiles" );
+        for( int i = 0; i < count; ++i )
+        {
+            settings->setArrayIndex( i );
+            Profile profile;
+            profile.name = settings->value( "name" ).toString();
+            profile.patterns = settings->value( "patterns" ).toStringList();
+            profile.options = settings->value( "options" ).toString();
+            profiles += profile;
+        }
+        settings->endArray();
+
+        setProfiles( profiles );
+    }
+
+    QString FormatterProfiles::styleFileOptions( const QString& dirPath )const
+    {
+        const QString path = styleFilePath( dirPath );
+        if( path.isEmpty() )
+        {
+            return QString();
+        }
+
+        // Read again once the file has been edited.
+        const QDateTime modified = QFileInfo( path ).lastModified();
+        QHash<QString, StyleFile>::iterator itr = m_styleFiles.find( path );
+        if( ( itr == m_styleFiles.end() ) || ( itr.value().modified != modified ) )
+        {
+            StyleFile styleFile;
+            styleFile.modified = modified;
+            styleFile.options = readStyleFile( path );
+            itr = m_styleFiles.insert( path, styleFile );
+        }
+        return itr.value().options;
+    }
+
+    QString FormatterProfiles::styleFilePath( const QString& dirPath )const
+    {
+        // Every directory on the way up remembers the answer, so a tree is
+        // walked once no matter how many files in it get formatted. An
+        // answer is only trusted for a while; after that the directories
+        // are looked at again.
+        const qint64 now = m_clock.elapsed();
+        QStringList visited;
+        StyleFilePath stylePath;
+        stylePath.checkedAt = now;
+        QDir dir( dirPath );
+        while( true )
+        {
+            const QString path = dir.absolutePath();
+            QHash<QString, StyleFilePath>::const_iterator itr = m_styleFilePaths.find( path );
+            if( ( itr != m_styleFilePaths.end() ) &&
+                ( now - itr.value().checkedAt < StyleFileLookupInterval ) )
+            {
+                stylePath = itr.value();
+                break;
+            }
+
+            visited += path;
+            if( dir.exists( ".astylerc" ) )
+            {
+                stylePath.path = dir.filePath( ".astylerc" );
+                break;
+            }
+            if( dir.exists( "_astylerc" ) )
+            {
+                stylePath.path = dir.filePath( "_astylerc" );
+                break;
+            }
+            if( !dir.cdUp() )
+            {
+                break;
+            }
+        }
+
+        for( int i = 0; i < visited.size(); ++i )
+        {
+            m_styleFilePaths.insert( visited.at( i ), stylePath );
+        }
+        return stylePath.path;
+    }
+
+    QString FormatterProfiles::readStyleFile( const QString& path )
+    {
+        QFile file( path );
+        if( !file.open( QIODevice::ReadOnly | QIODevice::Text ) )
+        {
+            return QString();
+        }
+
+        // One or more options per line, '#' starts a comment.
+        QStringList options;
+        QTextStream stream( &file );
+        while( !stream.atEnd() )
+        {
+            QString line = stream.readLine();
+            const int comment = line.indexOf( '#' );
+            if( comment >= 0 )
+            {
+                line.truncate( comment );
+            }
+            line = line.trimmed();
+            if( !line.isEmpty() )
+            {
+                options += line;
+            }
+        }
+
+        return options.isEmpty() ? QString() : options.join( "\n" );
+    }
+}
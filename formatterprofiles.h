@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include "sourceformatter.h"
+
+namespace mote
+{
+    class Settings;
+
+    class FormatterProfiles
+    {
+    public:
+        struct Profile
+        {
+            QString name;
+            QStringList patterns;
+            QString options;
+        };
+
+    public:
+        FormatterProfiles( void );
+
+    public:
+        QList<Profile> profiles( void )const;
+        void setProfiles( const QList<Profile>& profiles );
+        int revision( void )const;
+
+        SourceFormatter formatter( const QString& filePath, const int indentWidth )const;
+        QString styleFile( const QString& filePath )const;
+        void clearCache( void );
+
+        void save( Settings* settings )const;
+        void restore( Settings* settings );
+
+    private:
+        struct StyleFile
+        {
+            QDateTime modified;
+            QString options;
+        };
+
+        struct StyleFilePath
+        {
+            QString path;
+            qint64 checkedAt;
+        };
+
+    private:
+        QString styleFileOptions( const QString& dirPath )const;
+        QString styleFilePath( const QString& dirPath )const;
+        static QString readStyleFile( const QString& path );
+
+    private:
+        QList<Profile> m_profiles;
+        int m_revision;
+        QElapsedTimer m_clock;
+        mutable QHash<QString, StyleFilePath> m_styleFilePaths;
+        mutable QHash<QString, StyleFile> m_styleFiles;
+        mutable QHash<QString, SourceFormatter> m_formatters;
+    };
+}
@@ -0,0 +1,101 @@
+#include "formatterprofilesdialog.h"
+
+#include <QDialogButtonBox>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+namespace mote
+{
+    FormatterProfilesDialog::FormatterProfilesDialog( QWidget* parent )
+        : QDialog( parent )
+    {
+        setWindowTitle( tr( "Formatter Profiles" ) );
+
+        m_table = new QTableWidget( 0, 3 );
+        m_table->setHorizontalHeaderLabels(
+            QStringList() << tr( "Name" ) << tr( "File Patterns" ) << tr( "AStyle Options" ) );
+        m_table->horizontalHeader()->setStretchLastSection( true );
+        m_table->verticalHeader()->hide();
+        m_table->setSelectionBehavior( QAbstractItemView::SelectRows );
+
+        QLabel* label = new QLabel(
+            tr( "The first profile whose patterns (e.g. \"*.cpp *.h\") match the file name is used. "
+                "An .astylerc in the file's directory or a parent directory takes precedence." ) );
+        label->setWordWrap( true );
+
+        QPushButton* addButton = new QPushButton( tr( "Add" ) );
+        QPushButton* removeButton = new QPushButton( tr( "Remove" ) );
+
+        QDialogButtonBox* buttonBox =
+            new QDialogButtonBox( QDialogButtonBox::Ok | QDialogButtonBox::Cancel );
+
+        connect( addButton, SIGNAL( clicked() ), SLOT( addProfile( void ) ) );
+        connect( removeButton, SIGNAL( clicked() ), SLOT( removeProfile( void ) ) );
+        connect( buttonBox, SIGNAL( accepted() ), SLOT( accept() ) );
+        connect( buttonBox, SIGNAL( rejected() ), SLOT( reject() ) );
+
+        QHBoxLayout* buttonLayout = new QHBoxLayout;
+        buttonLayout->addWidget( addButton );
+        buttonLayout->addWidget( removeButton );
+        buttonLayout->addStretch();
+
+        QVBoxLayout* layout = new QVBoxLayout;
+        layout->addWidget( label );
+        layout->addWidget( m_table );
+        layout->addLayout( buttonLayout );
+        layout->addWidget( buttonBox );
+        setLayout( layout );
+    }
+
+    QList<FormatterProfiles::Profile> FormatterProfilesDialog::profiles( void )const
+    {
+        QList<FormatterProfiles::Profile> profiles;
+        for( int row = 0; row < m_table->rowCount(); ++row )
+        {
+            FormatterProfiles::Profile profile;
+            profile.name = m_table->item( row, 0 )->text().trimmed();
+            profile.patterns = m_table->item( row, 1 )->text().split( ' ', QString::SkipEmptyParts );
+            profile.options = m_table->item( row, 2 )->text().trimmed();
+            if( !profile.patterns.isEmpty() )
+            {
+                profiles += profile;
+            }
+        }
+        return profiles;
+    }
+
+    void FormatterProfilesDialog::setProfiles( const QList<FormatterProfiles::Profile>& profiles )
+    {
+        m_table->setRowCount( profiles.size() );
+        for( int row = 0; row < profiles.size(); ++row )
+        {
+            const FormatterProfiles::Profile& profile = profiles.at( row );
+            m_table->setItem( row, 0, new QTableWidgetItem( profile.name ) );
+            m_table->setItem( row, 1, new QTableWidgetItem( profile.patterns.join( " " ) ) );
+            m_table->setItem( row, 2, new QTableWidgetItem( profile.options ) );
+        }
+    }
+
+    void FormatterProfilesDialog::addProfile( void )
+    {
+        const int row = m_table->rowCount();
+        m_table->insertRow( row );
+        m_table->setItem( row, 0, new QTableWidgetItem( tr( "New Profile" ) ) );
+        m_table->setItem( row, 1, new QTableWidgetItem( "*.cpp *.h" ) );
+        m_table->setItem( row, 2, new QTableWidgetItem( SourceFormatter::defaultOptions( 4 ) ) );
+        m_table->setCurrentCell( row, 0 );
+        m_table->editItem( m_table->item( row, 0 ) );
+    }
+
+    void FormatterProfilesDialog::removeProfile( void )
+    {
+        const int row = m_table->currentRow();
+        if( row >= 0 )
+        {
+            m_table->removeRow( row );
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <QDialog>
+#include <QTableWidget>
+
+#include "formatterprofiles.h"
+
+namespace mote
+{
+    class FormatterProfilesDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        FormatterProfilesDialog( QWidget* parent = 0 );
+
+    public:
+        QList<FormatterProfiles::Profile> profiles( void )const;
+        void setProfiles( const QList<FormatterProfiles::Profile>& profiles );
+
+    private slots:
+        void addProfile( void );
+        void removeProfile( void );
+
+    private:
+        QTableWidget* m_table;
+    };
+}
@@ -0,0 +1,170 @@
+#include "frameprofiler.h"
+
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#include <algorithm>
+
+namespace mote
+{
+    namespace
+    {
+        const int MaxSampleCount = 4096;
+
+        double toMilliseconds( const qint64 nsecs )
+        {
+            return nsecs / 1000000.0;
+        }
+    }
+
+    Q_GLOBAL_STATIC( FrameProfiler, frameProfiler )
+
+    QJsonObject FrameProfiler::Statistics::toJson( void )const
+    {
+        QJsonObject object;
+        object.insert( "count", count );
+        object.insert( "mean", mean );
+        object.insert( "p50", p50 );
+        object.insert( "p99", p99 );
+        object.insert( "max", max );
+        return object;
+    }
+
+    FrameProfiler::Scope::Scope( const Phase phase )
+        : m_phase( phase ),
+          m_active( FrameProfiler::instance()->isEnabled() )
+    {
+        if( m_active )
+        {
+            m_timer.start();
+        }
+    }
+
+    FrameProfiler::Scope::~Scope()
+    {
+        if( m_active )
+        {
+            FrameProfiler::instance()->addSample( m_phase, m_timer.nsecsElapsed() );
+        }
+    }
+
+    FrameProfiler::FrameProfiler( void )
+        : m_enabled( false )
+    {
+        for( int i = 0; i < PhaseCount; ++i )
+        {
+            m_nextSample[i] = 0;
+        }
+    }
+
+    FrameProfiler* FrameProfiler::instance( void )
+    {
+        return frameProfiler();
+    }
+
+    bool FrameProfiler::isEnabled( void )const
+    {
+        return m_enabled;
+    }
+
+    void FrameProfiler::setEnabled( const bool onoff )
+    {
+        m_enabled = onoff;
+    }
+
+    void FrameProfiler::clear( void )
+    {
+        for( int i = 0; i < PhaseCount; ++i )
+        {
+            m_samples[i].clear();
+            m_nextSample[i] = 0;
+        }
+    }
+
+    void FrameProfiler::addSample( const Phase phase, const qint64 nsecs )
+    {
+        QVector<qint64>& samples = m_samples[phase];
+        if( samples.size() < MaxSampleCount )
+        {
+            samples += nsecs;
+        }
+        else
+        {
+            samples[m_nextSample[phase]] = nsecs;
+            m_nextSample[phase] = ( m_nextSample[phase] + 1 ) % MaxSampleCount;
+        }
+    }
+
+    FrameProfiler::Statistics FrameProfiler::statistics( const Phase phase )const
+    {
+        return calculate( m_samples[phase] );
+    }
+
+    QJsonObject FrameProfiler::toJson( void )const
+    {
+        QJsonObject object;
+        for( int i = 0; i < PhaseCount; ++i )
+        {
+            const Phase phase = static_cast<Phase>( i );
+            object.insert( phaseName( phase ), statistics( phase ).toJson() );
+        }
+        return object;
+    }
+
+    bool FrameProfiler::saveJson( const QString& path )const
+    {
+        QSaveFile file( path );
+        if( !file.open( QIODevice::WriteOnly ) )
+        {
+            return false;
+        }
+
+        file.write( QJsonDocument( toJson() ).toJson() );
+        return file.commit();
+    }
+
+    QString FrameProfiler::phaseName( const Phase phase )
+    {
+        switch( phase )
+        {
+        case FramePhase:
+            return "frame";
+        case TextPhase:
+            return "text";
+        case GutterPhase:
+            return "gutter";
+        case MarkerPhase:
+            return "markers";
+        case HighlightPhase:
+            return "highlight";
+        case ExtraSelectionPhase:
+            return "extraSelections";
+        default:
+            return QString();
+        }
+    }
+
+    FrameProfiler::Statistics FrameProfiler::calculate( QVector<qint64> nsecs )
+    {
+        Statistics statistics;
+        if( nsecs.isEmpty() )
+        {
+            return statistics;
+        }
+
+        std::sort( nsecs.begin(), nsecs.end() );
+
+        qint64 total = 0;
+        for( int i = 0; i < nsecs.size(); ++i )
+        {
+            total += nsecs.at( i );
+        }
+
+        statistics.count = nsecs.size();
+        statistics.mean = toMilliseconds( total ) / nsecs.size();
+        statistics.p50 = toMilliseconds( nsecs.at( ( nsecs.size() - 1 ) * 50 / 100 ) );
+        statistics.p99 = toMilliseconds( nsecs.at( ( nsecs.size() - 1 ) * 99 / 100 ) );
+        statistics.max = toMilliseconds( nsecs.last() );
+        return statistics;
+    }
+}
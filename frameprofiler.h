@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+
+namespace mote
+{
+    // Timings of the phases of painting an editor, kept for the last few
+    // thousand samples of each phase. Nothing is measured while disabled.
+    class FrameProfiler
+    {
+    public:
+        enum Phase
+        {
+            FramePhase,
+            TextPhase,
+            GutterPhase,
+            MarkerPhase,
+            HighlightPhase,
+            ExtraSelectionPhase,
+            PhaseCount
+        };
+
+        // In milliseconds.
+        struct Statistics
+        {
+            Statistics( void )
+                : count( 0 ),
+                  mean( 0 ),
+                  p50( 0 ),
+                  p99( 0 ),
+                  max( 0 )
+            {
+            }
+
+            QJsonObject toJson( void )const;
+
+            int count;
+            double mean;
+            double p50;
+            double p99;
+            double max;
+        };
+
+        class Scope
+        {
+        public:
+            Scope( const Phase phase );
+            ~Scope();
+
+        private:
+            Phase m_phase;
+            bool m_active;
+            QElapsedTimer m_timer;
+        };
+
+    public:
+        FrameProfiler( void );
+
+    public:
+        static FrameProfiler* instance( void );
+
+        bool isEnabled( void )const;
+        void setEnabled( const bool onoff );
+        void clear( void );
+
+        void addSample( const Phase phase, const qint64 nsecs );
+        Statistics statistics( const Phase phase )const;
+
+        QJsonObject toJson( void )const;
+        bool saveJson( const QString& path )const;
+
+        static QString phaseName( const Phase phase );
+        static Statistics calculate( QVector<qint64> nsecs );
+
+    private:
+        bool m_enabled;
+        QVector<qint64> m_samples[PhaseCount];
+        int m_nextSample[PhaseCount];
+    };
+}
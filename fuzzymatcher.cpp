@@ -0,0 +1,195 @@
+#include "fuzzymatcher.h"
+
+namespace mote
+{
+    namespace
+    {
+        const int MatchScore = 16;
+        const int ConsecutiveBonus = 24;
+        const int LeadingBonus = 32;
+        const int BoundaryBonus = 24;
+
+        // One bit per letter, digit and underscore; anything else shares
+        // the remaining bits.
+        int charBit( const QChar ch )
+        {
+            const ushort unicode = ch.toCaseFolded().unicode();
+            if( ( unicode >= 'a' ) && ( unicode <= 'z' ) )
+            {
+                return unicode - 'a';
+            }
+            if( ( unicode >= '0' ) && ( unicode <= '9' ) )
+            {
+                return 26 + ( unicode - '0' );
+            }
+            if( unicode == '_' )
+            {
+                return 36;
+            }
+            return 37 + ( unicode % 27 );
+        }
+
+        // The head of a word part: after an underscore or any other
+        // separator, an upper case letter after a lower case one, or a
+        // letter after a digit.
+        bool isBoundary( const QChar* data, const int i )
+        {
+            if( i == 0 )
+            {
+                return true;
+            }
+
+            const QChar previous = data[i - 1];
+            const QChar current = data[i];
+            if( !previous.isLetterOrNumber() )
+            {
+                return current.isLetterOrNumber();
+            }
+            if( previous.isLower() && current.isUpper() )
+            {
+                return true;
+            }
+            return previous.isDigit() && current.isLetter();
+        }
+    }
+
+    FuzzyMatcher::FuzzyMatcher( const QString& pattern )
+        : m_pattern( pattern ),
+          m_foldedPattern( pattern.toCaseFolded() ),
+          m_mask( charMask( pattern ) )
+    {
+    }
+
+    QString FuzzyMatcher::pattern( void )const
+    {
+        return m_pattern;
+    }
+
+    bool FuzzyMatcher::isEmpty( void )const
+    {
+        return m_pattern.isEmpty();
+    }
+
+    // False when the text lacks some character of the pattern, judged
+    // only from the text's charMask(); a cheap test before match().
+    bool FuzzyMatcher::mayMatch( const quint64 mask )const
+    {
+        return ( m_mask & ~mask ) == 0;
+    }
+
+    bool FuzzyMatcher::match( const QString& text, int* score, QVector<int>* positions )const
+    {
+        // Characters of the pattern must appear in order, not necessarily
+        // adjacent. Runs of adjacent characters, a match at the head of the
+        // text and matches at the heads of camelCase or snake_case parts
+        // rank higher; every unmatched character costs one point.
+        const int patternLength = m_foldedPattern.size();
+        const int textLength = text.size();
+        if( patternLength > textLength )
+        {
+            return false;
+        }
+
+        const QChar* const pattern = m_foldedPattern.constData();
+        const QChar* const data = text.constData();
+
+        if( positions )
+        {
+            positions->clear();
+        }
+
+        int total = 0;
+        int previous = -2;
+        int j = 0;
+        for( int i = 0; ( i < textLength ) && ( j < patternLength ); ++i )
+        {
+            if( data[i].toCaseFolded() != pattern[j] )
+            {
+                continue;
+            }
+
+            // Rather than the first occurrence, take a later one at the
+            // head of a word part if the rest of the pattern still fits.
+            if( ( i != previous + 1 ) && !isBoundary( data, i ) )
+            {
+                for( int k = i + 1; k < textLength; ++k )
+                {
+                    if( ( data[k].toCaseFolded() == pattern[j] ) &&
+                        isBoundary( data, k ) &&
+                        matchFrom( data, textLength, k + 1, j + 1 ) )
+                    {
+                        i = k;
+                        break;
+                    }
+                }
+            }
+
+            total += MatchScore;
+            if( i == previous + 1 )
+            {
+                total += ConsecutiveBonus;
+            }
+            if( i == 0 )
+            {
+                total += LeadingBonus;
+            }
+            else if( isBoundary( data, i ) )
+            {
+                total += BoundaryBonus;
+            }
+            if( positions )
+            {
+                positions->append( i );
+            }
+            previous = i;
+            ++j;
+        }
+
+        if( j < patternLength )
+        {
+            return false;
+        }
+
+        if( score )
+        {
+            *score = total - ( textLength - patternLength );
+        }
+        return true;
+    }
+
+    // The score of a text that is the pattern itself.
+    int FuzzyMatcher::maxScore( void )const
+    {
+        const int patternLength = m_foldedPattern.size();
+        if( patternLength == 0 )
+        {
+            return 0;
+        }
+        return patternLength * MatchScore + ( patternLength - 1 ) * ConsecutiveBonus + LeadingBonus;
+    }
+
+    quint64 FuzzyMatcher::charMask( const QString& text )
+    {
+        quint64 mask = 0;
+        const QChar* const data = text.constData();
+        for( int i = 0; i < text.size(); ++i )
+        {
+            mask |= Q_UINT64_C( 1 ) << charBit( data[i] );
+        }
+        return mask;
+    }
+
+    bool FuzzyMatcher::matchFrom( const QChar* data, int textLength, int i, int j )const
+    {
+        const int patternLength = m_foldedPattern.size();
+        const QChar* const pattern = m_foldedPattern.constData();
+        for( ; ( i < textLength ) && ( j < patternLength ); ++i )
+        {
+            if( data[i].toCaseFolded() == pattern[j] )
+            {
+                ++j;
+            }
+        }
+        return j == patternLength;
+    }
+}
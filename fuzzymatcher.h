@@ -0,0 +1,30 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+namespace mote
+{
+    class FuzzyMatcher
+    {
+    public:
+        FuzzyMatcher( const QString& pattern = QString() );
+
+    public:
+        QString pattern( void )const;
+        bool isEmpty( void )const;
+        bool mayMatch( const quint64 mask )const;
+        bool match( const QString& text, int* score = NULL, QVector<int>* positions = NULL )const;
+        int maxScore( void )const;
+
+        static quint64 charMask( const QString& text );
+
+    private:
+        bool matchFrom( const QChar* data, int textLength, int i, int j )const;
+
+    private:
+        QString m_pattern;
+        QString m_foldedPattern;
+        quint64 m_mask;
+    };
+}
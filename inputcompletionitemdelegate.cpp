@@ -1,6 +1,9 @@
 #include "inputcompletionitemdelegate.h"
 
+#include <QApplication>
+#include <QPainter>
 #include <QStyleOptionViewItemV4>
+#include <QTextLayout>
 
 namespace mote
 {
@@ -15,8 +18,61 @@ namespace mote
         const QModelIndex& index )const
     {
         QStyleOptionViewItemV4 optionCopy = option;
+        initStyleOption( &optionCopy, index );
         optionCopy.state |= QStyle::State_Active;
         //optionCopy.palette.setCurrentColorGroup( QPalette::Active );
-        return QStyledItemDelegate::paint( painter, optionCopy, index );
+
+        // The style draws the item without its text, which is then drawn
+        // here with the characters matching the pattern in bold.
+        const QString text = optionCopy.text;
+        optionCopy.text = QString();
+        const QWidget* widget = optionCopy.widget;
+        const QStyle* style = widget ? widget->style() : QApplication::style();
+        style->drawControl( QStyle::CE_ItemViewItem, &optionCopy, painter, widget );
+
+        QList<QTextLayout::FormatRange> formats;
+        QVector<int> positions;
+        if( m_matcher.match( text, NULL, &positions ) )
+        {
+            QTextLayout::FormatRange range;
+            range.format.setFontWeight( QFont::Bold );
+            for( int i = 0; i < positions.size(); ++i )
+            {
+                if( !formats.isEmpty() && ( formats.last().start + formats.last().length == positions.at( i ) ) )
+                {
+                    ++formats.last().length;
+                    continue;
+                }
+                range.start = positions.at( i );
+                range.length = 1;
+                formats += range;
+            }
+        }
+
+        const int margin = style->pixelMetric( QStyle::PM_FocusFrameHMargin, &optionCopy, widget ) + 1;
+        const QRect textRect =
+            style->subElementRect( QStyle::SE_ItemViewItemText, &optionCopy, widget ).adjusted( margin, 0, -margin, 0 );
+
+        QTextLayout layout( text, optionCopy.font );
+        layout.setAdditionalFormats( formats );
+        layout.beginLayout();
+        QTextLine line = layout.createLine();
+        line.setLineWidth( textRect.width() );
+        layout.endLayout();
+
+        painter->save();
+        painter->setPen(
+            optionCopy.palette.color(
+                QPalette::Active,
+                ( optionCopy.state & QStyle::State_Selected ) ? QPalette::HighlightedText : QPalette::Text ) );
+        painter->setClipRect( textRect );
+        const qreal y = textRect.top() + ( textRect.height() - line.height() ) / 2;
+        layout.draw( painter, QPointF( textRect.left(), y ) );
+        painter->restore();
+    }
+
+    void InputCompletionItemDelegate::setPattern( const QString& pattern )
+    {
+        m_matcher = FuzzyMatcher( pattern );
     }
 }
@@ -2,6 +2,8 @@
 
 #include <QStyledItemDelegate>
 
+#include "fuzzymatcher.h"
+
 namespace mote
 {
     class InputCompletionItemDelegate : public QStyledItemDelegate
@@ -16,5 +18,11 @@ namespace mote
             QPainter* painter,
             const QStyleOptionViewItem& option,
             const QModelIndex& index )const;
+
+    public:
+        void setPattern( const QString& pattern );
+
+    private:
+        FuzzyMatcher m_matcher;
     };
 }
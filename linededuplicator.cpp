@@ -0,0 +1,194 @@
+#include "linededuplicator.h"
+
+#include "textlines.h"
+
+namespace mote
+{
+    namespace
+    {
+        // 64-bit FNV-1a over the UTF-16 code units of a line.
+        quint64 hashLine( const QChar* data, const int length )
+        {
+            quint64 hash = Q_UINT64_C( 14695981039346656037 );
+            for( int i = 0; i < length; ++i )
+            {
+                const ushort ch = data[i].unicode();
+                hash ^= ( ch & 0xFF );
+                hash *= Q_UINT64_C( 1099511628211 );
+                hash ^= ( ch >> 8 );
+                hash *= Q_UINT64_C( 1099511628211 );
+            }
+            return hash;
+        }
+
+        struct Group
+        {
+            int firstLine;
+            int lastLine;
+            int count;
+        };
+    }
+
+    LineDeduplicator::LineDeduplicator( const Mode mode, const bool countOccurrences )
+        : m_mode( mode ),
+          m_countOccurrences( countOccurrences )
+    {
+    }
+
+    LineDeduplicator::Mode LineDeduplicator::mode( void )const
+    {
+        return m_mode;
+    }
+
+    bool LineDeduplicator::countOccurrences( void )const
+    {
+        return m_countOccurrences;
+    }
+
+    QVector<int> LineDeduplicator::unique( const TextLines& lines, QVector<int>* counts )const
+    {
+        if( m_mode == Adjacent )
+        {
+            return uniqueAdjacent( lines, counts );
+        }
+        else
+        {
+            return uniqueGlobal( lines, counts );
+        }
+    }
+
+    QString LineDeduplicator::exec( const TextLines& lines )const
+    {
+        if( !m_countOccurrences )
+        {
+            return lines.join( unique( lines ) );
+        }
+
+        QVector<int> counts;
+        const QVector<int> order = unique( lines, &counts );
+
+        // Each line gains its count, at least eight characters with the
+        // space.
+        QString result;
+        result.reserve( lines.text().length() + order.size() * 8 );
+        for( int i = 0; i < order.size(); ++i )
+        {
+            if( i > 0 )
+            {
+                result += lines.separator();
+            }
+
+            // Same layout as "uniq -c".
+            result += QString::number( counts.at( i ) ).rightJustified( 7, ' ' );
+            result += ' ';
+            result.append( lines.data( order.at( i ) ), lines.view( order.at( i ) ).length );
+        }
+        if( lines.hasTrailingSeparator() )
+        {
+            result += lines.separator();
+        }
+
+        return result;
+    }
+
+    QVector<int> LineDeduplicator::uniqueAdjacent( const TextLines& lines, QVector<int>* counts )const
+    {
+        QVector<int> order;
+        for( int i = 0; i < lines.count(); ++i )
+        {
+            if( !order.isEmpty() && lines.equals( order.back(), i ) )
+            {
+                if( counts )
+                {
+                    ++counts->back();
+                }
+                continue;
+            }
+
+            order.push_back( i );
+            if( counts )
+            {
+                counts->push_back( 1 );
+            }
+        }
+        return order;
+    }
+
+    QVector<int> LineDeduplicator::uniqueGlobal( const TextLines& lines, QVector<int>* counts )const
+    {
+        const int count = lines.count();
+
+        int capacity = 16;
+        while( capacity < count * 2 )
+        {
+            capacity *= 2;
+        }
+        const int mask = capacity - 1;
+
+        // Open addressing table of group indexes. Lines are compared only
+        // when their 64-bit hashes collide.
+        QVector<int> table( capacity, -1 );
+        QVector<quint64> groupHashes;
+        QVector<Group> groups;
+        QVector<int> lineGroups( count );
+        for( int i = 0; i < count; ++i )
+        {
+            const quint64 hash = hashLine( lines.data( i ), lines.view( i ).length );
+
+            int slot = ( int )( hash & mask );
+            int groupIndex = -1;
+            while( table.at( slot ) != -1 )
+            {
+                const int candidate = table.at( slot );
+                if( ( groupHashes.at( candidate ) == hash ) &&
+                    lines.equals( groups.at( candidate ).firstLine, i ) )
+                {
+                    groupIndex = candidate;
+                    break;
+                }
+                slot = ( slot + 1 ) & mask;
+            }
+
+            if( groupIndex == -1 )
+            {
+                groupIndex = groups.size();
+                Group group;
+                group.firstLine = i;
+                group.lastLine = i;
+                group.count = 1;
+                groups.push_back( group );
+                groupHashes.push_back( hash );
+                table[slot] = groupIndex;
+            }
+            else
+            {
+                Group& group = groups[groupIndex];
+                group.lastLine = i;
+                ++group.count;
+            }
+
+            lineGroups[i] = groupIndex;
+        }
+
+        QVector<int> order;
+        order.reserve( groups.size() );
+        if( counts )
+        {
+            counts->reserve( groups.size() );
+        }
+        for( int i = 0; i < count; ++i )
+        {
+            const Group& group = groups.at( lineGroups.at( i ) );
+            const int representative = ( m_mode == KeepLast ) ? group.lastLine : group.firstLine;
+            if( representative == i )
+            {
+                order.push_back( i );
+                if( counts )
+                {
+                    counts->push_back( group.count );
+                }
+            }
+        }
+        return order;
+    }
+}
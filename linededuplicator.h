@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+namespace mote
+{
+    class TextLines;
+
+    class LineDeduplicator
+    {
+    public:
+        enum Mode
+        {
+            Adjacent,
+            KeepFirst,
+            KeepLast
+        };
+
+    public:
+        LineDeduplicator( const Mode mode = KeepFirst, const bool countOccurrences = false );
+
+    public:
+        Mode mode( void )const;
+        bool countOccurrences( void )const;
+
+        QVector<int> unique( const TextLines& lines, QVector<int>* counts = NULL )const;
+        QString exec( const TextLines& lines )const;
+
+    private:
+        QVector<int> uniqueAdjacent( const TextLines& lines, QVector<int>* counts )const;
+        QVector<int> uniqueGlobal( const TextLines& lines, QVector<int>* counts )const;
+
+    private:
+        Mode m_mode;
+        bool m_countOccurrences;
+    };
+}
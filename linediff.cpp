@@ -0,0 +1,204 @@
+#include "linediff.h"
+
+#include <QHash>
+
+namespace mote
+{
+    namespace
+    {
+        class LineMatcher
+        {
+        public:
+            LineMatcher( const QStringList& oldLines, const QStringList& newLines )
+                : m_oldLines( oldLines ),
+                  m_newLines( newLines ),
+                  m_oldHashes( oldLines.size() ),
+                  m_newHashes( newLines.size() )
+            {
+                for( int i = 0; i < oldLines.size(); ++i )
+                {
+                    m_oldHashes[i] = qHash( oldLines.at( i ) );
+                }
+                for( int i = 0; i < newLines.size(); ++i )
+                {
+                    m_newHashes[i] = qHash( newLines.at( i ) );
+                }
+            }
+
+            bool operator()( int oldIndex, int newIndex )const
+            {
+                return ( m_oldHashes.at( oldIndex ) == m_newHashes.at( newIndex ) ) &&
+                       ( m_oldLines.at( oldIndex ) == m_newLines.at( newIndex ) );
+            }
+
+        private:
+            const QStringList& m_oldLines;
+            const QStringList& m_newLines;
+            QVector<uint> m_oldHashes;
+            QVector<uint> m_newHashes;
+        };
+    }
+
+    LineDiff::LineDiff( const int maxEditCount )
+        : m_maxEditCount( maxEditCount )
+    {
+    }
+
+    int LineDiff::maxEditCount( void )const
+    {
+        return m_maxEditCount;
+    }
+
+    QVector<LineDiff::Hunk> LineDiff::exec( const QStringList& oldLines, const QStringList& newLines )const
+    {
+        QVector<Hunk> hunks;
+        const LineMatcher equals( oldLines, newLines );
+
+        // Common head and tail cost nothing; formatting usually leaves most
+        // of the text alone.
+        int head = 0;
+        while( ( head < oldLines.size() ) && ( head < newLines.size() ) && equals( head, head ) )
+        {
+            ++head;
+        }
+        int tail = 0;
+        while( ( tail < oldLines.size() - head ) && ( tail < newLines.size() - head ) &&
+               equals( oldLines.size() - 1 - tail, newLines.size() - 1 - tail ) )
+        {
+            ++tail;
+        }
+
+        const int n = oldLines.size() - head - tail;
+        const int m = newLines.size() - head - tail;
+        if( ( n == 0 ) && ( m == 0 ) )
+        {
+            return hunks;
+        }
+
+        Hunk whole;
+        whole.oldStart = head;
+        whole.oldCount = n;
+        whole.newStart = head;
+        whole.newCount = m;
+        if( ( n == 0 ) || ( m == 0 ) )
+        {
+            hunks += whole;
+            return hunks;
+        }
+
+        // Myers' O(ND) difference algorithm. v[k] is the furthest x reached
+        // on diagonal k; trace[d] keeps v[-d..d] after step d for the walk
+        // back. Past maxEditCount the middle is replaced as a whole.
+        const int maxD = qMin( n + m, m_maxEditCount );
+        const int offset = maxD + 1;
+        QVector<int> v( 2 * maxD + 3, 0 );
+        QVector< QVector<int> > trace;
+        int d = 0;
+        bool found = false;
+        for( ; ( d <= maxD ) && !found; ++d )
+        {
+            for( int k = -d; k <= d; k += 2 )
+            {
+                int x;
+                if( ( k == -d ) || ( ( k != d ) && ( v.at( offset + k - 1 ) < v.at( offset + k + 1 ) ) ) )
+                {
+                    x = v.at( offset + k + 1 );
+                }
+                else
+                {
+                    x = v.at( offset + k - 1 ) + 1;
+                }
+                int y = x - k;
+                while( ( x < n ) && ( y < m ) && equals( head + x, head + y ) )
+                {
+                    ++x;
+                    ++y;
+                }
+                v[offset + k] = x;
+                if( ( x >= n ) && ( y >= m ) )
+                {
+                    found = true;
+                    break;
+                }
+            }
+            trace += v.mid( offset - d, 2 * d + 1 );
+        }
+        if( !found )
+        {
+            hunks += whole;
+            return hunks;
+        }
+
+        // Walk back from (n, m); each step is one deletion or insertion just
+        // before a run of equal lines. Adjacent edits merge into one hunk.
+        QVector<Hunk> reversed;
+        int x = n;
+        int y = m;
+        for( int step = d - 1; step > 0; --step )
+        {
+            const QVector<int>& previous = trace.at( step - 1 );
+            const int base = step - 1;
+            const int k = x - y;
+
+            int previousK;
+            if( ( k == -step ) ||
+                ( ( k != step ) && ( previous.at( base + k - 1 ) < previous.at( base + k + 1 ) ) ) )
+            {
+                previousK = k + 1;
+            }
+            else
+            {
+                previousK = k - 1;
+            }
+            const int previousX = previous.at( base + previousK );
+            const int previousY = previousX - previousK;
+
+            Hunk edit;
+            edit.oldStart = head + previousX;
+            edit.newStart = head + previousY;
+            edit.oldCount = ( previousK == k + 1 ) ? 0 : 1;
+            edit.newCount = ( previousK == k + 1 ) ? 1 : 0;
+
+            if( !reversed.isEmpty() &&
+                ( edit.oldStart + edit.oldCount == reversed.last().oldStart ) &&
+                ( edit.newStart + edit.newCount == reversed.last().newStart ) )
+            {
+                Hunk& hunk = reversed.last();
+                hunk.oldCount += edit.oldCount;
+                hunk.newCount += edit.newCount;
+                hunk.oldStart = edit.oldStart;
+                hunk.newStart = edit.newStart;
+            }
+            else
+            {
+                reversed += edit;
+            }
+
+            x = previousX;
+            y = previousY;
+        }
+
+        hunks.reserve( reversed.size() );
+        for( int i = reversed.size() - 1; i >= 0; --i )
+        {
+            hunks += reversed.at( i );
+        }
+        return hunks;
+    }
+
+    QStringList LineDiff::splitLines( const QString& text )
+    {
+        // Each line keeps its '\n', so that joining the lines of a hunk
+        // gives back the exact text it covers.
+        QStringList lines;
+        int start = 0;
+        while( start < text.size() )
+        {
+            int end = text.indexOf( '\n', start );
+            end = ( end < 0 ) ? text.size() : ( end + 1 );
+            lines += text.mid( start, end - start );
+            start = end;
+        }
+        return lines;
+    }
+}
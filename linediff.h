@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QStringList>
+#include <QVector>
+
+namespace mote
+{
+    class LineDiff
+    {
+    public:
+        // Replace oldCount lines at oldStart with newCount lines at newStart.
+        struct Hunk
+        {
+            int oldStart;
+            int oldCount;
+            int newStart;
+            int newCount;
+        };
+
+    public:
+        LineDiff( const int maxEditCount = 1024 );
+
+    public:
+        int maxEditCount( void )const;
+        QVector<Hunk> exec( const QStringList& oldLines, const QStringList& newLines )const;
+
+        static QStringList splitLines( const QString& text );
+
+    private:
+        int m_maxEditCount;
+    };
+}
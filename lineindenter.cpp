@@ -0,0 +1,79 @@
+#include "lineindenter.h"
+
+#include "textlines.h"
+
+namespace mote
+{
+    LineIndenter::LineIndenter( const int width )
+        : m_width( width )
+    {
+    }
+
+    int LineIndenter::width( void )const
+    {
+        return m_width;
+    }
+
+    // Every line gains width spaces, empty ones included.
+    QString LineIndenter::indent( const TextLines& lines )const
+    {
+        const QString indentText( m_width, ' ' );
+        const int lineCount = lines.count() + ( lines.hasTrailingSeparator() ? 1 : 0 );
+
+        QString result;
+        result.reserve( lines.text().length() + lineCount * m_width );
+        for( int i = 0; i < lines.count(); ++i )
+        {
+            if( i > 0 )
+            {
+                result += lines.separator();
+            }
+
+            result += indentText;
+            result.append( lines.data( i ), lines.view( i ).length );
+        }
+        if( lines.hasTrailingSeparator() )
+        {
+            // The last line is empty.
+            result += lines.separator();
+            result += indentText;
+        }
+
+        return result;
+    }
+
+    // Every line loses up to width leading spaces, or the spaces before a
+    // tab and the tab itself.
+    QString LineIndenter::unindent( const TextLines& lines )const
+    {
+        QString result;
+        result.reserve( lines.text().length() );
+        for( int i = 0; i < lines.count(); ++i )
+        {
+            if( i > 0 )
+            {
+                result += lines.separator();
+            }
+
+            const QChar* const data = lines.data( i );
+            const int length = lines.view( i ).length;
+            int start = 0;
+            while( ( start < length ) && ( start < m_width ) && ( data[start] == ' ' ) )
+            {
+                ++start;
+            }
+            if( ( start < length ) && ( start < m_width ) && ( data[start] == '\t' ) )
+            {
+                ++start;
+            }
+
+            result.append( data + start, length - start );
+        }
+        if( lines.hasTrailingSeparator() )
+        {
+            result += lines.separator();
+        }
+
+        return result;
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QString>
+
+namespace mote
+{
+    class TextLines;
+
+    // Shifts whole lines by one indent width, producing the new text in a
+    // single pass so that it can replace the old one in one edit.
+    class LineIndenter
+    {
+    public:
+        LineIndenter( const int width = 4 );
+
+    public:
+        int width( void )const;
+
+        QString indent( const TextLines& lines )const;
+        QString unindent( const TextLines& lines )const;
+
+    private:
+        int m_width;
+    };
+}
@@ -0,0 +1,426 @@
+#include "linesorter.h"
+
+#include <algorithm>
+
+#include <QCollator>
+#include <QThread>
+#include <QtConcurrentMap>
+
+#include "textlines.h"
+
+namespace mote
+{
+    namespace
+    {
+        // Lines per chunk below which a chunk is not worth a thread of its own.
+        const int MinimumChunkSize = 4096;
+
+        inline int compareLength( const int length1, const int length2 )
+        {
+            return ( length1 < length2 ) ? -1 : ( ( length1 > length2 ) ? 1 : 0 );
+        }
+
+        inline bool isAsciiDigit( const QChar ch )
+        {
+            return ( ch.unicode() >= '0' ) && ( ch.unicode() <= '9' );
+        }
+
+        int compareLexical( const QChar* str1, const int length1, const QChar* str2, const int length2 )
+        {
+            const int length = qMin( length1, length2 );
+            for( int i = 0; i < length; ++i )
+            {
+                if( str1[i] != str2[i] )
+                {
+                    return ( str1[i].unicode() < str2[i].unicode() ) ? -1 : 1;
+                }
+            }
+            return compareLength( length1, length2 );
+        }
+
+        int compareCaseInsensitive( const QChar* str1, const int length1, const QChar* str2, const int length2 )
+        {
+            const int length = qMin( length1, length2 );
+            for( int i = 0; i < length; ++i )
+            {
+                if( str1[i] != str2[i] )
+                {
+                    const ushort ch1 = str1[i].toCaseFolded().unicode();
+                    const ushort ch2 = str2[i].toCaseFolded().unicode();
+                    if( ch1 != ch2 )
+                    {
+                        return ( ch1 < ch2 ) ? -1 : 1;
+                    }
+                }
+            }
+            return compareLength( length1, length2 );
+        }
+
+        int compareNatural( const QChar* str1, const int length1, const QChar* str2, const int length2 )
+        {
+            int i = 0;
+            int j = 0;
+            while( ( i < length1 ) && ( j < length2 ) )
+            {
+                if( isAsciiDigit( str1[i] ) && isAsciiDigit( str2[j] ) )
+                {
+                    // Compare digit runs by value: ignore leading zeros, then
+                    // the longer run is the larger number.
+                    while( ( i < length1 ) && ( str1[i] == '0' ) )
+                    {
+                        ++i;
+                    }
+                    while( ( j < length2 ) && ( str2[j] == '0' ) )
+                    {
+                        ++j;
+                    }
+
+                    const int start1 = i;
+                    const int start2 = j;
+                    while( ( i < length1 ) && isAsciiDigit( str1[i] ) )
+                    {
+                        ++i;
+                    }
+                    while( ( j < length2 ) && isAsciiDigit( str2[j] ) )
+                    {
+                        ++j;
+                    }
+
+                    const int result = compareLength( i - start1, j - start2 );
+                    if( result != 0 )
+                    {
+                        return result;
+                    }
+                    for( int k = 0; k < i - start1; ++k )
+                    {
+                        if( str1[start1 + k] != str2[start2 + k] )
+                        {
+                            return ( str1[start1 + k].unicode() < str2[start2 + k].unicode() ) ? -1 : 1;
+                        }
+                    }
+                    continue;
+                }
+
+                const ushort ch1 = str1[i].toCaseFolded().unicode();
+                const ushort ch2 = str2[j].toCaseFolded().unicode();
+                if( ch1 != ch2 )
+                {
+                    return ( ch1 < ch2 ) ? -1 : 1;
+                }
+                ++i;
+                ++j;
+            }
+            return compareLength( length1 - i, length2 - j );
+        }
+
+        double parseNumber( const QChar* str, const int length )
+        {
+            int i = 0;
+            while( ( i < length ) && str[i].isSpace() )
+            {
+                ++i;
+            }
+
+            bool negative = false;
+            if( ( i < length ) && ( ( str[i] == '-' ) || ( str[i] == '+' ) ) )
+            {
+                negative = ( str[i] == '-' );
+                ++i;
+            }
+
+            double value = 0.0;
+            while( ( i < length ) && isAsciiDigit( str[i] ) )
+            {
+                value = value * 10.0 + ( str[i].unicode() - '0' );
+                ++i;
+            }
+            if( ( i < length ) && ( str[i] == '.' ) )
+            {
+                ++i;
+                double scale = 0.1;
+                while( ( i < length ) && isAsciiDigit( str[i] ) )
+                {
+                    value += ( str[i].unicode() - '0' ) * scale;
+                    scale *= 0.1;
+                    ++i;
+                }
+            }
+
+            return negative ? -value : value;
+        }
+
+        class ItemComparator
+        {
+        public:
+            ItemComparator(
+                const LineSorter::Options& options,
+                const QChar* text,
+                const QCollator* collator )
+                : m_key( options.key ),
+                  m_descending( options.descending ),
+                  m_text( text ),
+                  m_collator( collator )
+            {
+            }
+
+            bool operator()( const LineSorter::Item& item1, const LineSorter::Item& item2 )const
+            {
+                const int result = compare( item1, item2 );
+                return m_descending ? ( result > 0 ) : ( result < 0 );
+            }
+
+        private:
+            int compare( const LineSorter::Item& item1, const LineSorter::Item& item2 )const
+            {
+                const QChar* str1 = m_text + item1.keyOffset;
+                const QChar* str2 = m_text + item2.keyOffset;
+                switch( m_key )
+                {
+                case LineSorter::CaseInsensitive:
+                    return compareCaseInsensitive( str1, item1.keyLength, str2, item2.keyLength );
+                case LineSorter::Numeric:
+                    if( item1.number != item2.number )
+                    {
+                        return ( item1.number < item2.number ) ? -1 : 1;
+                    }
+                    return 0;
+                case LineSorter::Natural:
+                    return compareNatural( str1, item1.keyLength, str2, item2.keyLength );
+                case LineSorter::LocaleAware:
+                    return m_collator->compare( str1, item1.keyLength, str2, item2.keyLength );
+                default:
+                    return compareLexical( str1, item1.keyLength, str2, item2.keyLength );
+                }
+            }
+
+        private:
+            LineSorter::Key m_key;
+            bool m_descending;
+            const QChar* m_text;
+            const QCollator* m_collator;
+        };
+
+        class KeyExtractor
+        {
+        public:
+            KeyExtractor(
+                const TextLines& lines,
+                const LineSorter::Options& options,
+                LineSorter::Item* items )
+                : m_lines( &lines ),
+                  m_options( &options ),
+                  m_items( items )
+            {
+            }
+
+            void operator()( const LineSorter::Range& range )const
+            {
+                // Every chunk gets its own expression so that matching does
+                // not contend on shared state.
+                const QRegularExpression regExp(
+                    m_options->regularExpression.pattern(),
+                    m_options->regularExpression.patternOptions() );
+                const bool regExpEnabled = !regExp.pattern().isEmpty() && regExp.isValid();
+                const int group = ( regExp.captureCount() > 0 ) ? 1 : 0;
+
+                for( int i = range.begin; i < range.end; ++i )
+                {
+                    const TextLines::View& view = m_lines->view( i );
+                    int offset = qMin( qMax( m_options->column, 0 ), view.length );
+                    int length = view.length - offset;
+
+                    if( regExpEnabled )
+                    {
+                        const QString subject =
+                            QString::fromRawData( m_lines->data( i ) + offset, length );
+                        const QRegularExpressionMatch match = regExp.match( subject );
+                        if( match.hasMatch() && ( match.capturedStart( group ) >= 0 ) )
+                        {
+                            offset += match.capturedStart( group );
+                            length = match.capturedLength( group );
+                        }
+                        else
+                        {
+                            length = 0;
+                        }
+                    }
+
+                    LineSorter::Item& item = m_items[i];
+                    item.index = i;
+                    item.keyOffset = view.offset + offset;
+                    item.keyLength = length;
+                    item.number =
+                        ( m_options->key == LineSorter::Numeric ) ?
+                        parseNumber( m_lines->text().constData() + item.keyOffset, length ) : 0.0;
+                }
+            }
+
+        private:
+            const TextLines* m_lines;
+            const LineSorter::Options* m_options;
+            LineSorter::Item* m_items;
+        };
+
+        class ChunkSorter
+        {
+        public:
+            ChunkSorter(
+                const LineSorter::Options& options,
+                const QChar* text,
+                LineSorter::Item* items )
+                : m_options( &options ),
+                  m_text( text ),
+                  m_items( items )
+            {
+            }
+
+            void operator()( const LineSorter::Range& range )const
+            {
+                QCollator collator( m_options->locale );
+                std::stable_sort(
+                    m_items + range.begin,
+                    m_items + range.end,
+                    ItemComparator( *m_options, m_text, &collator ) );
+            }
+
+        private:
+            const LineSorter::Options* m_options;
+            const QChar* m_text;
+            LineSorter::Item* m_items;
+        };
+
+        struct MergeTask
+        {
+            LineSorter::Range first;
+            LineSorter::Range second;
+        };
+
+        class ChunkMerger
+        {
+        public:
+            ChunkMerger(
+                const LineSorter::Options& options,
+                const QChar* text,
+                const LineSorter::Item* source,
+                LineSorter::Item* destination )
+                : m_options( &options ),
+                  m_text( text ),
+                  m_source( source ),
+                  m_destination( destination )
+            {
+            }
+
+            void operator()( const MergeTask& task )const
+            {
+                // std::merge takes from the first range on ties, which keeps
+                // the sort stable across chunks.
+                QCollator collator( m_options->locale );
+                std::merge(
+                    m_source + task.first.begin,
+                    m_source + task.first.end,
+                    m_source + task.second.begin,
+                    m_source + task.second.end,
+                    m_destination + task.first.begin,
+                    ItemComparator( *m_options, m_text, &collator ) );
+            }
+
+        private:
+            const LineSorter::Options* m_options;
+            const QChar* m_text;
+            const LineSorter::Item* m_source;
+            LineSorter::Item* m_destination;
+        };
+    }
+
+    LineSorter::Options::Options( void )
+        : key( Lexical ),
+          descending( false ),
+          column( 0 )
+    {
+    }
+
+    LineSorter::LineSorter( const Options& options )
+        : m_options( options )
+    {
+    }
+
+    const LineSorter::Options& LineSorter::options( void )const
+    {
+        return m_options;
+    }
+
+    QVector<int> LineSorter::sort( const TextLines& lines )const
+    {
+        const int count = lines.count();
+        if( count < 2 )
+        {
+            QVector<int> order( count );
+            for( int i = 0; i < count; ++i )
+            {
+                order[i] = i;
+            }
+            return order;
+        }
+
+        const int chunkCount =
+            qBound( 1, count / MinimumChunkSize, qMax( QThread::idealThreadCount(), 1 ) );
+        QVector<Range> ranges( chunkCount );
+        for( int i = 0; i < chunkCount; ++i )
+        {
+            ranges[i].begin = ( int )( ( qint64 )count * i / chunkCount );
+            ranges[i].end = ( int )( ( qint64 )count * ( i + 1 ) / chunkCount );
+        }
+
+        const QChar* text = lines.text().constData();
+
+        QVector<Item> items( count );
+        QtConcurrent::blockingMap( ranges, KeyExtractor( lines, m_options, items.data() ) );
+        QtConcurrent::blockingMap( ranges, ChunkSorter( m_options, text, items.data() ) );
+
+        QVector<Item> buffer;
+        if( ranges.size() > 1 )
+        {
+            buffer.resize( count );
+        }
+
+        Item* source = items.data();
+        Item* destination = buffer.data();
+        while( ranges.size() > 1 )
+        {
+            QVector<MergeTask> tasks;
+            QVector<Range> merged;
+            for( int i = 0; i < ranges.size(); i += 2 )
+            {
+                MergeTask task;
+                task.first = ranges.at( i );
+                if( i + 1 < ranges.size() )
+                {
+                    task.second = ranges.at( i + 1 );
+                }
+                else
+                {
+                    task.second.begin = task.first.end;
+                    task.second.end = task.first.end;
+                }
+                tasks.push_back( task );
+
+                Range range;
+                range.begin = task.first.begin;
+                range.end = task.second.end;
+                merged.push_back( range );
+            }
+
+            QtConcurrent::blockingMap( tasks, ChunkMerger( m_options, text, source, destination ) );
+
+            qSwap( source, destination );
+            ranges = merged;
+        }
+
+        QVector<int> order( count );
+        for( int i = 0; i < count; ++i )
+        {
+            order[i] = source[i].index;
+        }
+        return order;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QLocale>
+#include <QRegularExpression>
+#include <QVector>
+
+namespace mote
+{
+    class TextLines;
+
+    class LineSorter
+    {
+    public:
+        enum Key
+        {
+            Lexical,
+            CaseInsensitive,
+            Numeric,
+            Natural,
+            LocaleAware
+        };
+
+        struct Options
+        {
+            Options( void );
+
+            Key key;
+            bool descending;
+            int column;
+            QRegularExpression regularExpression;
+            QLocale locale;
+        };
+
+    public:
+        LineSorter( const Options& options = Options() );
+
+    public:
+        const Options& options( void )const;
+        QVector<int> sort( const TextLines& lines )const;
+
+    public:
+        struct Item
+        {
+            int index;
+            int keyOffset;
+            int keyLength;
+            double number;
+        };
+
+        struct Range
+        {
+            int begin;
+            int end;
+        };
+
+    private:
+        Options m_options;
+    };
+}
@@ -1,15 +1,170 @@
 #include <QApplication>
 #include <QDir>
+#include <QJsonDocument>
 #include <QLocale>
+#include <QSaveFile>
+#include <QStringList>
 #include <QTranslator>
 
+#include <cstdio>
+#include <cstring>
+
+#include "batchformatter.h"
+#include "benchmark.h"
 #include "documentsystem.h"
 #include "mainwindow.h"
 #include "settings.h"
 #include "textdocument.h"
 
+static bool hasOption( int argc, char** argv, const char* option )
+{
+    for( int i = 1; i < argc; ++i )
+    {
+        if( strcmp( argv[i], option ) == 0 )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// mote --format [--indent=N] <file or directory>...
+static int formatFiles( const QStringList& arguments )
+{
+    int indentWidth = 4;
+    QStringList paths;
+    for( int i = 1; i < arguments.size(); ++i )
+    {
+        const QString& argument = arguments.at( i );
+        if( argument == "--format" )
+        {
+            continue;
+        }
+        else if( argument.startsWith( "--indent=" ) )
+        {
+            indentWidth = argument.mid( 9 ).toInt();
+        }
+        else
+        {
+            paths += argument;
+        }
+    }
+
+    if( paths.isEmpty() || ( indentWidth <= 0 ) )
+    {
+        fprintf( stderr, "usage: mote --format [--indent=N] <file or directory>...\n" );
+        return 2;
+    }
+
+    mote::Settings settings;
+    mote::FormatterProfiles profiles;
+    profiles.restore( &settings );
+
+    const mote::BatchFormatter::Statistics statistics =
+        mote::BatchFormatter( profiles, indentWidth ).exec( paths );
+    for( int i = 0; i < statistics.errors.size(); ++i )
+    {
+        fprintf( stderr, "%s\n", qPrintable( statistics.errors.at( i ) ) );
+    }
+    printf( "%s\n", qPrintable( statistics.summary() ) );
+
+    return ( statistics.failedCount > 0 ) ? 1 : 0;
+}
+
+// mote --benchmark [--lines=N,...] [--dedup-lines=N,...] [--frames=N] [--json=FILE]
+static int runBenchmark( const QStringList& arguments )
+{
+    QList<int> lineCounts;
+    QList<int> deduplicateLineCounts;
+    int frameCount = 300;
+    QString jsonPath;
+    for( int i = 1; i < arguments.size(); ++i )
+    {
+        const QString& argument = arguments.at( i );
+        if( argument == "--benchmark" )
+        {
+            continue;
+        }
+        else if( argument.startsWith( "--lines=" ) )
+        {
+            const QStringList values = argument.mid( 8 ).split( ',' );
+            for( int j = 0; j < values.size(); ++j )
+            {
+                lineCounts += values.at( j ).toInt();
+            }
+        }
+        else if( argument.startsWith( "--dedup-lines=" ) )
+        {
+            const QStringList values = argument.mid( 14 ).split( ',' );
+            for( int j = 0; j < values.size(); ++j )
+            {
+                deduplicateLineCounts += values.at( j ).toInt();
+            }
+        }
+        else if( argument.startsWith( "--frames=" ) )
+        {
+            frameCount = argument.mid( 9 ).toInt();
+        }
+        else if( argument.startsWith( "--json=" ) )
+        {
+            jsonPath = argument.mid( 7 );
+        }
+        else
+        {
+            fprintf( stderr, "usage: mote --benchmark [--lines=N,...] [--dedup-lines=N,...] [--frames=N] [--json=FILE]\n" );
+            return 2;
+        }
+    }
+    if( lineCounts.isEmpty() )
+    {
+        lineCounts << 10000 << 100000 << 1000000;
+    }
+    if( deduplicateLineCounts.isEmpty() )
+    {
+        deduplicateLineCounts << 10000000;
+    }
+
+    const QList<mote::Benchmark::Result> results =
+        mote::Benchmark( frameCount ).exec( lineCounts, deduplicateLineCounts );
+    for( int i = 0; i < results.size(); ++i )
+    {
+        printf( "%s\n", qPrintable( results.at( i ).summary() ) );
+    }
+
+    if( !jsonPath.isEmpty() )
+    {
+        QSaveFile file( jsonPath );
+        if( !file.open( QIODevice::WriteOnly ) ||
+            ( file.write( QJsonDocument( mote::Benchmark::toJson( results ) ).toJson() ) < 0 ) ||
+            !file.commit() )
+        {
+            fprintf( stderr, "%s: %s\n", qPrintable( jsonPath ), qPrintable( file.errorString() ) );
+            return 1;
+        }
+    }
+
+    return results.isEmpty() ? 1 : 0;
+}
+
 int main( int argc, char** argv )
 {
+    if( hasOption( argc, argv, "--format" ) )
+    {
+        QCoreApplication app( argc, argv );
+        return formatFiles( app.arguments() );
+    }
+
+    if( hasOption( argc, argv, "--benchmark" ) )
+    {
+        // No window system is needed to measure painting.
+        if( qgetenv( "QT_QPA_PLATFORM" ).isEmpty() )
+        {
+            qputenv( "QT_QPA_PLATFORM", "offscreen" );
+        }
+        QApplication app( argc, argv );
+        return runBenchmark( app.arguments() );
+    }
+
     QApplication app( argc, argv );
 
     QTranslator translator;
@@ -45,6 +200,7 @@ int main( int argc, char** argv )
         mote::MainWindow* win = new mote::MainWindow( &settings, &documentSystem );
         win->setAttribute( Qt::WA_DeleteOnClose );
         win->restoreGeometryAndState();
+        win->restoreSession();
         win->show();
     }
 
@@ -2,6 +2,7 @@
 
 #include <QApplication>
 #include <QDesktopWidget>
+#include <QDir>
 #include <QFile>
 #include <QFileDialog>
 #include <QFileInfo>
@@ -12,8 +13,10 @@
 #include <QMenuBar>
 #include <QMessageBox>
 #include <QScrollBar>
-#include <QSet>
 #include <QShortcut>
+#include <QSplitter>
+#include <QStatusBar>
+#include <QtConcurrent>
 #include <QTextBlock>
 #include <QToolBar>
 #include <QVector>
@@ -22,15 +25,49 @@
 #include "ctags.h"
 #include "documentsystem.h"
 #include "finddialog.h"
+#include "formatterprofilesdialog.h"
+#include "frameprofiler.h"
+#include "linededuplicator.h"
 #include "newlinecharacteraction.h"
+#include "outlinedock.h"
 #include "settings.h"
+#include "sortlinesdialog.h"
+#include "symbolindex.h"
 #include "tagjumpdialog.h"
+#include "tagservice.h"
 #include "textcodecaction.h"
 #include "textdocument.h"
 #include "textedit.h"
+#include "textlines.h"
 
 namespace mote
 {
+    namespace
+    {
+        // Tabs beyond this many since last shown give up what they can.
+        const int LoadedPageCount = 16;
+
+        // The selected lines joined by '\n', long lines whole rather than
+        // cut into their blocks.
+        QString selectedLines( const QTextCursor& textCursor )
+        {
+            const TextDocument* textDocument = qobject_cast<const TextDocument*>( textCursor.document() );
+            if( textDocument )
+            {
+                return textDocument->text( textCursor.selectionStart(), textCursor.selectionEnd() );
+            }
+            return textCursor.selectedText().replace( QChar( 0x2029 ), '\n' );
+        }
+
+        // Checked before formatting on save, so that a file that cannot be
+        // written is not reformatted for nothing.
+        bool isWritable( const QString& path )
+        {
+            const QFileInfo info( path );
+            return info.exists() ? info.isWritable() : QFileInfo( info.absolutePath() ).isWritable();
+        }
+    }
+
     MainWindow::MainWindow(
         Settings* settings,
         DocumentSystem* documentSystem,
@@ -38,16 +75,18 @@ namespace mote
         : QMainWindow( parent ),
           m_settings( settings ),
           m_documentSystem( documentSystem ),
-          m_findDialog( NULL )
+          m_findDialog( NULL ),
+          m_outlineDock( NULL ),
+          m_closing( false )
     {
         TextDocument* textDocument = documentSystem->createDocument();
 
-        TextEdit* textEdit = new TextEdit( textDocument );
+        TextEdit* textEdit = createEdit( textDocument );
 
         m_tabWidget = new QTabWidget;
         m_tabWidget->setTabsClosable( true );
         m_tabWidget->setMovable( true );
-        m_tabWidget->addTab( textEdit, makeTabTitle( textDocument ) );
+        m_recentPages += m_tabWidget->widget( addPage( textEdit ) );
 
         setCentralWidget( m_tabWidget );
 
@@ -58,6 +97,10 @@ namespace mote
         toolBar->addAction( new TextCodecAction( documentSystem, this ) );
         toolBar->addAction( new BOMAction( documentSystem, this ) );
 
+        m_outlineDock = new OutlineDock( documentSystem, this );
+        addDockWidget( Qt::RightDockWidgetArea, m_outlineDock );
+        m_outlineDock->setTextEdit( textEdit );
+
         statusBar();
 
         QMenuBar* menuBar = this->menuBar();
@@ -89,14 +132,54 @@ namespace mote
             tr( "Sort Ascending" ),
             this, SLOT( sortAscending( void ) ),
             QKeySequence( Qt::CTRL | Qt::Key_1 ) );
+        editMenu->addAction(
+            tr( "Sort Descending" ),
+            this, SLOT( sortDescending( void ) ),
+            QKeySequence( Qt::CTRL | Qt::SHIFT | Qt::Key_1 ) );
+        editMenu->addAction(
+            tr( "Sort Lines..." ),
+            this, SLOT( sortLinesWithOptions( void ) ) );
         editMenu->addAction(
             tr( "Format Source Code" ),
             this, SLOT( formatSourceCode( void ) ),
             QKeySequence( Qt::CTRL | Qt::Key_2 ) );
+        editMenu->addAction(
+            tr( "Format Whole Source Code" ),
+            this, SLOT( formatWholeSourceCode( void ) ),
+            QKeySequence( Qt::CTRL | Qt::SHIFT | Qt::Key_2 ) );
+        editMenu->addAction(
+            tr( "Re-indent Lines" ),
+            this, SLOT( reindentLines( void ) ),
+            QKeySequence( Qt::CTRL | Qt::SHIFT | Qt::Key_I ) );
+        editMenu->addAction(
+            tr( "Format Files in Directory..." ),
+            this, SLOT( formatFilesInDirectory( void ) ) );
+        editMenu->addAction(
+            tr( "Formatter Profiles..." ),
+            this, SLOT( editFormatterProfiles( void ) ) );
+        QAction* formatOnSaveAction = editMenu->addAction(
+                                          tr( "Format Changed Lines on Save" ),
+                                          settings, SLOT( setFormatOnSave( bool ) ) );
+        formatOnSaveAction->setCheckable( true );
+        formatOnSaveAction->setChecked( settings->formatOnSave() );
+        QAction* completeProjectSymbolsAction = editMenu->addAction(
+                                                    tr( "Complete Project Symbols" ),
+                                                    settings, SLOT( setCompleteProjectSymbols( bool ) ) );
+        completeProjectSymbolsAction->setCheckable( true );
+        completeProjectSymbolsAction->setChecked( settings->completeProjectSymbols() );
         editMenu->addAction(
             tr( "Delete Duplicate" ),
             this, SLOT( deleteDuplicate( void ) ),
             QKeySequence( Qt::CTRL | Qt::Key_3 ) );
+        editMenu->addAction(
+            tr( "Delete Adjacent Duplicate" ),
+            this, SLOT( deleteAdjacentDuplicate( void ) ) );
+        editMenu->addAction(
+            tr( "Delete Duplicate (Keep Last)" ),
+            this, SLOT( deleteDuplicateKeepLast( void ) ) );
+        editMenu->addAction(
+            tr( "Count Duplicate" ),
+            this, SLOT( countDuplicate( void ) ) );
         editMenu->addAction(
             tr( "Reload" ),
             this, SLOT( reload( void ) ) );
@@ -122,14 +205,29 @@ namespace mote
             tr( "Tag Jump..." ),
             this, SLOT( tagJump( void ) ),
             QKeySequence( Qt::CTRL | Qt::Key_T ) );
+        searchMenu->addAction(
+            tr( "Jump to Definition" ),
+            this, SLOT( jumpToDefinition( void ) ),
+            QKeySequence( Qt::Key_F12 ) );
         searchMenu->addAction(
             tr( "Go to Corresponding Parenthesis" ),
             this, SLOT( jumpToCoBrace( void ) ),
             QKeySequence( Qt::CTRL | Qt::Key_K ) );
+        searchMenu->addAction(
+            tr( "Select All Occurrences" ),
+            this, SLOT( selectAllOccurrences( void ) ),
+            QKeySequence( Qt::CTRL | Qt::SHIFT | Qt::Key_L ) );
         searchMenu->addAction(
             tr( "Go to Line..." ),
             this, SLOT( jumpToLine( void ) ),
             QKeySequence( Qt::CTRL | Qt::Key_I ) );
+        searchMenu->addSeparator();
+        searchMenu->addAction(
+            tr( "Set Project Directory..." ),
+            this, SLOT( setProjectDirectory( void ) ) );
+        searchMenu->addAction(
+            tr( "Update Project Index" ),
+            this, SLOT( updateProjectIndex( void ) ) );
 
         QMenu* viewMenu = menuBar->addMenu( tr( "&View" ) );
         viewMenu->addAction( tr( "Font..." ), this, SLOT( changeFont( void ) ) );
@@ -137,9 +235,29 @@ namespace mote
                                  tr( "Line Number" ),
                                  settings, SLOT( setLineNumberVisible( bool ) ) );
         m_lineNumberAction->setCheckable( true );
+        viewMenu->addAction( m_outlineDock->toggleViewAction() );
+        viewMenu->addSeparator();
+        m_frameTimingsAction = viewMenu->addAction(
+                                   tr( "Frame Timings" ),
+                                   this, SLOT( setFrameTimingsVisible( bool ) ) );
+        m_frameTimingsAction->setCheckable( true );
+        m_frameTimingsAction->setChecked( FrameProfiler::instance()->isEnabled() );
+        viewMenu->addAction(
+            tr( "Save Frame Timings..." ),
+            this, SLOT( saveFrameTimings( void ) ) );
 
         QMenu* windowMenu = menuBar->addMenu( tr( "&Window" ) );
         windowMenu->addAction( tr( "New Window" ), this, SLOT( createNewWindow( void ) ) );
+        windowMenu->addSeparator();
+        windowMenu->addAction(
+            tr( "Split Horizontally" ),
+            this, SLOT( splitHorizontally( void ) ) );
+        windowMenu->addAction(
+            tr( "Split Vertically" ),
+            this, SLOT( splitVertically( void ) ) );
+        windowMenu->addAction(
+            tr( "Close Split View" ),
+            this, SLOT( closeSplitView( void ) ) );
 
         textDocument->setFont( settings->font() );
 
@@ -177,9 +295,28 @@ namespace mote
             documentSystem, SIGNAL( modificationChanged( TextDocument* ) ),
             SLOT( updateTabTitle( TextDocument* ) ) );
 
+        connect(
+            documentSystem->tagService(), SIGNAL( tagsUpdated( TextDocument* ) ),
+            SLOT( onTagsUpdated( TextDocument* ) ) );
+        connect(
+            documentSystem->tagService(), SIGNAL( tagsFailed( TextDocument* ) ),
+            SLOT( onTagsFailed( TextDocument* ) ) );
+        connect(
+            documentSystem->symbolIndex(), SIGNAL( updateStarted( void ) ),
+            SLOT( onSymbolIndexUpdateStarted( void ) ) );
+        connect(
+            documentSystem->symbolIndex(), SIGNAL( updateFinished( bool ) ),
+            SLOT( onSymbolIndexUpdateFinished( bool ) ) );
+
         connect(
             settings, SIGNAL( lineNumberVisibilityChanged( bool ) ),
             SLOT( onLineNumberVisibilityChanged( bool ) ) );
+        connect(
+            settings, SIGNAL( formatOnSaveChanged( bool ) ),
+            formatOnSaveAction, SLOT( setChecked( bool ) ) );
+        connect(
+            settings, SIGNAL( completeProjectSymbolsChanged( bool ) ),
+            completeProjectSymbolsAction, SLOT( setChecked( bool ) ) );
 
         connect(
             m_tabWidget, SIGNAL( currentChanged( int ) ),
@@ -187,15 +324,22 @@ namespace mote
         connect(
             m_tabWidget, SIGNAL( tabCloseRequested( int ) ),
             SLOT( onTabCloseRequested( int ) ) );
+        connect(
+            qApp, SIGNAL( focusChanged( QWidget*, QWidget* ) ),
+            SLOT( onFocusChanged( QWidget*, QWidget* ) ) );
 
         connect(
             this, SIGNAL( currentDocumentChanged( TextDocument* ) ),
             SLOT( updateWindowTitle( TextDocument* ) ) );
+
+        connect(
+            &m_batchFormatWatcher, SIGNAL( finished() ),
+            SLOT( onBatchFormatFinished( void ) ) );
     }
 
     TextEdit* MainWindow::currentEdit( void )const
     {
-        return qobject_cast<TextEdit*>( m_tabWidget->currentWidget() );
+        return editAt( m_tabWidget->currentIndex() );
     }
 
     TextDocument* MainWindow::currentDocument( void )const
@@ -204,6 +348,32 @@ namespace mote
         return textEdit ? qobject_cast<TextDocument*>( textEdit->document() ) : NULL;
     }
 
+    // The views of a tab, which all show the same document.
+    QList<TextEdit*> MainWindow::editsAt( const int index )const
+    {
+        const QWidget* page = m_tabWidget->widget( index );
+        return page ? page->findChildren<TextEdit*>() : QList<TextEdit*>();
+    }
+
+    // The view of a tab that last had the focus.
+    TextEdit* MainWindow::editAt( const int index )const
+    {
+        QWidget* page = m_tabWidget->widget( index );
+        if( !page )
+        {
+            return NULL;
+        }
+
+        TextEdit* textEdit = m_currentEdits.value( page );
+        if( textEdit )
+        {
+            return textEdit;
+        }
+
+        const QList<TextEdit*> edits = page->findChildren<TextEdit*>();
+        return edits.isEmpty() ? NULL : edits.front();
+    }
+
     void MainWindow::saveGeometryAndState( void )
     {
         m_settings->setValue( "mainWindowGeometry", saveGeometry() );
@@ -225,48 +395,115 @@ namespace mote
         }
     }
 
-    QList<TextEdit*> MainWindow::findEdits( TextDocument* textDocument )const
+    // The files of the tabs, in order, with their cursor and scroll
+    // positions. Tabs not loaded yet keep what they were restored with.
+    void MainWindow::saveSession( void )
+    {
+        saveSession( session() );
+    }
+
+    MainWindow::Session MainWindow::session( void )const
     {
-        QList<TextEdit*> edits;
+        Session session;
+        session.currentIndex = 0;
         for( int i = 0; i < m_tabWidget->count(); ++i )
         {
-            TextEdit* textEdit = qobject_cast<TextEdit*>( m_tabWidget->widget( i ) );
-            if( textEdit &&
-                ( !textDocument || ( textEdit->document() == textDocument ) ) )
+            QWidget* page = m_tabWidget->widget( i );
+            Placeholder placeholder;
+            if( m_placeholders.contains( page ) )
+            {
+                placeholder = m_placeholders.value( page );
+            }
+            else
+            {
+                const TextEdit* textEdit = editAt( i );
+                const TextDocument* textDocument =
+                    textEdit ? qobject_cast<TextDocument*>( textEdit->document() ) : NULL;
+                if( !textDocument || textDocument->filePath().isEmpty() )
+                {
+                    continue;
+                }
+                placeholder.path = textDocument->filePath();
+                placeholder.cursorPosition = textEdit->textCursor().position();
+                placeholder.scrollValue = textEdit->verticalScrollBar()->value();
+            }
+
+            if( i == m_tabWidget->currentIndex() )
             {
-                edits.append( textEdit );
+                session.currentIndex = session.paths.size();
             }
+            session.paths += placeholder.path;
+            session.cursorPositions += placeholder.cursorPosition;
+            session.scrollValues += placeholder.scrollValue;
         }
-        return edits;
+        return session;
     }
 
-    QList<TextEdit*> MainWindow::findEdits( const QString& path )const
+    void MainWindow::saveSession( const Session& session )
     {
-        QList<TextEdit*> edits;
-        for( int i = 0; i < m_tabWidget->count(); ++i )
+        m_settings->setValue( "sessionFiles", session.paths );
+        m_settings->setValue( "sessionCursorPositions", session.cursorPositions );
+        m_settings->setValue( "sessionScrollValues", session.scrollValues );
+        m_settings->setValue( "sessionCurrentIndex", session.currentIndex );
+    }
+
+    // Reopens the files of the last session as placeholder tabs; a file
+    // is read when its tab is first shown.
+    void MainWindow::restoreSession( void )
+    {
+        const QStringList paths = m_settings->value( "sessionFiles" ).toStringList();
+        const QVariantList cursorPositions = m_settings->value( "sessionCursorPositions" ).toList();
+        const QVariantList scrollValues = m_settings->value( "sessionScrollValues" ).toList();
+        if( paths.isEmpty() )
         {
-            TextEdit* textEdit = qobject_cast<TextEdit*>( m_tabWidget->widget( i ) );
-            if( textEdit )
+            return;
+        }
+
+        const int firstIndex = m_tabWidget->count();
+        for( int i = 0; i < paths.size(); ++i )
+        {
+            Placeholder placeholder;
+            placeholder.path = paths.at( i );
+            placeholder.canonicalPath = DocumentSystem::canonicalPath( placeholder.path );
+            placeholder.cursorPosition = cursorPositions.value( i ).toInt();
+            placeholder.scrollValue = scrollValues.value( i ).toInt();
+            if( !m_documentSystem->findEdits( placeholder.path ).isEmpty() ||
+                ( placeholderIndexOf( placeholder.path ) != -1 ) )
             {
-                const TextDocument* textDocument =
-                    qobject_cast<TextDocument*>( textEdit->document() );
-                if( textDocument )
-                {
-                    if( QFileInfo( textDocument->filePath() ) == QFileInfo( path ) )
-                    {
-                        edits.append( textEdit );
-                    }
-                }
+                continue;
             }
+
+            QSplitter* splitter = new QSplitter;
+            splitter->setChildrenCollapsible( false );
+            m_placeholders.insert( splitter, placeholder );
+            m_tabWidget->addTab( splitter, QFileInfo( placeholder.path ).fileName() );
+        }
+        if( m_tabWidget->count() == firstIndex )
+        {
+            return;
+        }
+
+        const int currentIndex = m_settings->value( "sessionCurrentIndex" ).toInt();
+        m_tabWidget->setCurrentIndex( qBound( firstIndex, firstIndex + currentIndex, m_tabWidget->count() - 1 ) );
+
+        // The empty document the window started with is not kept.
+        const TextEdit* firstEdit = editAt( 0 );
+        const TextDocument* textDocument =
+            firstEdit ? qobject_cast<TextDocument*>( firstEdit->document() ) : NULL;
+        if( ( firstIndex == 1 ) &&
+            textDocument &&
+            !textDocument->isModified() &&
+            textDocument->filePath().isEmpty() )
+        {
+            _closeTab( 0 );
         }
-        return edits;
     }
 
-    bool MainWindow::saveFile( TextDocument* textDocument )
+    MainWindow::SaveResult MainWindow::saveFile( TextDocument* textDocument )
     {
         if( !textDocument )
         {
-            return false;
+            return SaveFailed;
         }
 
         const QString path = textDocument->filePath();
@@ -274,34 +511,95 @@ namespace mote
         {
             return saveFileAs( textDocument );
         }
-        else
-        {
-            return textDocument->saveFile( path );
-        }
+
+        return saveFile( textDocument, path );
     }
 
-    bool MainWindow::saveFileAs( TextDocument* textDocument )
+    MainWindow::SaveResult MainWindow::saveFileAs( TextDocument* textDocument )
     {
         if( !textDocument )
         {
-            return false;
+            return SaveFailed;
         }
 
         const QString path = QFileDialog::getSaveFileName( this );
         if( path.isEmpty() )
+        {
+            return SaveFailed;
+        }
+
+        return saveFile( textDocument, path );
+    }
+
+    // Finishes a pending save, for callers that need the file written
+    // before they go on.
+    bool MainWindow::waitForSave( TextDocument* textDocument )
+    {
+        if( !m_pendingSaves.contains( textDocument ) )
+        {
+            return !textDocument->isModified();
+        }
+
+        const QString path = m_pendingSaves.take( textDocument );
+        textDocument->waitForFormatModifiedLines();
+        statusBar()->clearMessage();
+        return writeFile( textDocument, path );
+    }
+
+    // With format on save the modified lines are formatted in the
+    // background first and the file is written once that is done.
+    MainWindow::SaveResult MainWindow::saveFile( TextDocument* textDocument, const QString& path )
+    {
+        if( !isWritable( path ) )
+        {
+            return SaveFailed;
+        }
+
+        if( m_settings->formatOnSave() && textDocument->hasModifiedRanges() )
+        {
+            // The indent width belongs to the views; they all share it.
+            int indentWidth = 4;
+            const QList<TextEdit*> edits = m_documentSystem->findEdits( textDocument );
+            if( !edits.isEmpty() )
+            {
+                indentWidth = edits.front()->tabStopWidthBySpace();
+            }
+
+            if( textDocument->startFormatModifiedLines( indentWidth ) )
+            {
+                connect(
+                    textDocument, SIGNAL( modifiedLinesFormatted( TextDocument* ) ),
+                    SLOT( onModifiedLinesFormatted( TextDocument* ) ),
+                    Qt::UniqueConnection );
+                m_pendingSaves.insert( textDocument, path );
+                statusBar()->showMessage( tr( "Formatting..." ) );
+                return SavePending;
+            }
+        }
+
+        return writeFile( textDocument, path ) ? Saved : SaveFailed;
+    }
+
+    bool MainWindow::writeFile( TextDocument* textDocument, const QString& path )
+    {
+        if( !textDocument->saveFile( path ) )
         {
             return false;
         }
 
-        return textDocument->saveFile( path );
+        m_documentSystem->symbolIndex()->updateFile( path );
+        return true;
     }
 
     void MainWindow::activate( TextEdit* textEdit )
     {
-        const int index = m_tabWidget->indexOf( textEdit );
+        const int index = pageIndexOf( textEdit );
         if( index != -1 )
         {
             m_tabWidget->setCurrentIndex( index );
+            m_currentEdits.insert( m_tabWidget->widget( index ), textEdit );
+            m_outlineDock->setTextEdit( textEdit );
+            textEdit->setFocus();
         }
     }
 
@@ -312,7 +610,14 @@ namespace mote
             return;
         }
 
-        const QList<TextEdit*> edits = TextEdit::findEdits( path );
+        const int placeholderIndex = placeholderIndexOf( path );
+        if( placeholderIndex != -1 )
+        {
+            m_tabWidget->setCurrentIndex( placeholderIndex );
+            return;
+        }
+
+        const QList<TextEdit*> edits = m_documentSystem->findEdits( path );
         if( edits.isEmpty() )
         {
             TextDocument* currentDocument = this->currentDocument();
@@ -325,11 +630,9 @@ namespace mote
                 {
                     textDocument->setFont( m_settings->font() );
 
-                    TextEdit* textEdit = new TextEdit( textDocument );
-                    textEdit->setLineNumberVisible( m_settings->isLineNumberVisible() );
+                    TextEdit* textEdit = createEdit( textDocument );
 
-                    m_tabWidget->addTab( textEdit, makeTabTitle( textDocument ) );
-                    m_tabWidget->setCurrentWidget( textEdit );
+                    m_tabWidget->setCurrentIndex( addPage( textEdit ) );
                 }
             }
             else
@@ -410,6 +713,46 @@ namespace mote
         }
     }
 
+    void MainWindow::setFrameTimingsVisible( bool onoff )
+    {
+        FrameProfiler* profiler = FrameProfiler::instance();
+        profiler->clear();
+        profiler->setEnabled( onoff );
+
+        // The profiler is shared, so every window shows its state.
+        const QWidgetList wins = QApplication::topLevelWidgets();
+        for( int i = 0; i < wins.size(); ++i )
+        {
+            MainWindow* win = qobject_cast<MainWindow*>( wins.at( i ) );
+            if( !win )
+            {
+                continue;
+            }
+
+            win->m_frameTimingsAction->setChecked( onoff );
+            TextEdit* textEdit = win->currentEdit();
+            if( textEdit )
+            {
+                textEdit->viewport()->update();
+            }
+        }
+    }
+
+    void MainWindow::saveFrameTimings( void )
+    {
+        const QString path = QFileDialog::getSaveFileName(
+                                 this, QString(), QString(), tr( "JSON (*.json)" ) );
+        if( path.isEmpty() )
+        {
+            return;
+        }
+
+        if( !FrameProfiler::instance()->saveJson( path ) )
+        {
+            QMessageBox::warning( this, tr( "Save Frame Timings" ), tr( "Cannot write %1." ).arg( path ) );
+        }
+    }
+
     void MainWindow::formatSourceCode( void )
     {
         TextEdit* textEdit = currentEdit();
@@ -419,6 +762,76 @@ namespace mote
         }
     }
 
+    void MainWindow::formatWholeSourceCode( void )
+    {
+        TextEdit* textEdit = currentEdit();
+        if( textEdit )
+        {
+            textEdit->formatWholeSourceCode();
+        }
+    }
+
+    void MainWindow::reindentLines( void )
+    {
+        TextEdit* textEdit = currentEdit();
+        if( textEdit )
+        {
+            textEdit->reindentLines();
+        }
+    }
+
+    void MainWindow::formatFilesInDirectory( void )
+    {
+        if( m_batchFormatWatcher.isRunning() )
+        {
+            return;
+        }
+
+        const QString dir = QFileDialog::getExistingDirectory(
+                                this,
+                                tr( "Format Files in Directory" ),
+                                m_settings->projectDirectory() );
+        if( dir.isEmpty() )
+        {
+            return;
+        }
+
+        if( QMessageBox::question(
+                this,
+                tr( "Format Files in Directory" ),
+                tr( "Format all source files in %1 and overwrite them?" ).arg( QDir::toNativeSeparators( dir ) ) )
+            != QMessageBox::Yes )
+        {
+            return;
+        }
+
+        TextEdit* textEdit = currentEdit();
+        BatchFormatter batchFormatter(
+            *m_documentSystem->formatterProfiles(),
+            textEdit ? textEdit->tabStopWidthBySpace() : 4 );
+        batchFormatter.setOpenFiles( m_documentSystem->openFilePaths() );
+
+        statusBar()->showMessage( tr( "Formatting files..." ) );
+        m_batchFormatWatcher.setFuture(
+            QtConcurrent::run(
+                batchFormatter,
+                &BatchFormatter::exec,
+                QStringList( dir ) ) );
+    }
+
+    void MainWindow::editFormatterProfiles( void )
+    {
+        FormatterProfiles* profiles = m_documentSystem->formatterProfiles();
+
+        FormatterProfilesDialog dialog( this );
+        dialog.setProfiles( profiles->profiles() );
+        if( dialog.exec() == QDialog::Accepted )
+        {
+            profiles->setProfiles( dialog.profiles() );
+            profiles->save( m_settings );
+        }
+    }
+
     void MainWindow::closeTab( void )
     {
         if( m_tabWidget->count() == 1 )
@@ -492,112 +905,117 @@ namespace mote
         TextDocument* textDocument = m_documentSystem->createDocument();
         textDocument->setFont( m_settings->font() );
 
-        TextEdit* textEdit = new TextEdit( textDocument );
-        textEdit->setLineNumberVisible( m_settings->isLineNumberVisible() );
+        TextEdit* textEdit = createEdit( textDocument );
 
-        m_tabWidget->addTab( textEdit, makeTabTitle( textDocument ) );
-        m_tabWidget->setCurrentWidget( textEdit );
+        m_tabWidget->setCurrentIndex( addPage( textEdit ) );
     }
 
-    void MainWindow::jumpToCoBrace( void )
+    void MainWindow::splitHorizontally( void )
     {
-        TextEdit* textEdit = currentEdit();
-        if( textEdit )
-        {
-            textEdit->jumpToCoBrace();
-        }
+        splitEdit( Qt::Horizontal );
     }
 
-    void MainWindow::sortAscending( void )
+    void MainWindow::splitVertically( void )
+    {
+        splitEdit( Qt::Vertical );
+    }
+
+    // Closes the current view of a tab showing more than one.
+    void MainWindow::closeSplitView( void )
     {
+        const int index = m_tabWidget->currentIndex();
         TextEdit* textEdit = currentEdit();
-        if( !textEdit )
+        if( !textEdit || ( editsAt( index ).size() < 2 ) )
         {
             return;
         }
 
-        QTextCursor textCursor = textEdit->textCursor();
-        if( !textCursor.hasSelection() )
+        QSplitter* splitter = qobject_cast<QSplitter*>( textEdit->parentWidget() );
+        m_documentSystem->removeEdit( textEdit );
+        textEdit->hide();
+        textEdit->setParent( NULL );
+        textEdit->deleteLater();
+
+        // A nested splitter left with one view hands it back to its parent.
+        QSplitter* parentSplitter =
+            splitter ? qobject_cast<QSplitter*>( splitter->parentWidget() ) : NULL;
+        if( parentSplitter && ( splitter->count() == 1 ) )
         {
-            return;
+            parentSplitter->insertWidget( parentSplitter->indexOf( splitter ), splitter->widget( 0 ) );
+            delete splitter;
         }
 
-        QStringList strList = textCursor.selectedText().split( QChar( 0x2029 ) );
-        if( strList.isEmpty() )
+        TextEdit* nextEdit = editsAt( index ).front();
+        m_currentEdits.insert( m_tabWidget->widget( index ), nextEdit );
+        nextEdit->setFocus();
+        m_outlineDock->setTextEdit( nextEdit );
+    }
+
+    void MainWindow::jumpToCoBrace( void )
+    {
+        TextEdit* textEdit = currentEdit();
+        if( textEdit )
         {
-            return;
+            textEdit->jumpToCoBrace();
         }
+    }
 
-        bool lastEmpty = false;
-        if( strList.back().isEmpty() )
+    void MainWindow::selectAllOccurrences( void )
+    {
+        TextEdit* textEdit = currentEdit();
+        if( textEdit )
         {
-            strList.pop_back();
-            lastEmpty = true;
+            textEdit->selectAllOccurrences();
         }
+    }
 
-        qSort( strList.begin(), strList.end() );
+    void MainWindow::sortAscending( void )
+    {
+        sortLines( LineSorter::Options() );
+    }
 
-        textCursor.beginEditBlock();
-        textCursor.deleteChar();
-        textCursor.insertText( strList.join( QChar( 0x2029 ) ) );
-        if( lastEmpty )
-        {
-            textCursor.insertText( QChar( 0x2029 ) );
-        }
-        textCursor.endEditBlock();
-        textEdit->setTextCursor( textCursor );
+    void MainWindow::sortDescending( void )
+    {
+        LineSorter::Options options;
+        options.descending = true;
+        sortLines( options );
     }
 
-    void MainWindow::deleteDuplicate( void )
+    void MainWindow::sortLinesWithOptions( void )
     {
         TextEdit* textEdit = currentEdit();
-        if( !textEdit )
+        if( !textEdit || !textEdit->textCursor().hasSelection() )
         {
             return;
         }
 
-        QTextCursor textCursor = textEdit->textCursor();
-        if( !textCursor.hasSelection() )
+        SortLinesDialog dialog( this );
+        dialog.restoreOptions( m_settings );
+        if( dialog.exec() == QDialog::Accepted )
         {
-            return;
+            dialog.saveOptions( m_settings );
+            sortLines( dialog.options() );
         }
+    }
 
-        QStringList strList = textCursor.selectedText().split( QChar( 0x2029 ) );
-        if( strList.isEmpty() )
-        {
-            return;
-        }
+    void MainWindow::deleteDuplicate( void )
+    {
+        deleteDuplicateLines( LineDeduplicator( LineDeduplicator::KeepFirst ) );
+    }
 
-        bool lastEmpty = false;
-        if( strList.back().isEmpty() )
-        {
-            strList.pop_back();
-            lastEmpty = true;
-        }
+    void MainWindow::deleteAdjacentDuplicate( void )
+    {
+        deleteDuplicateLines( LineDeduplicator( LineDeduplicator::Adjacent ) );
+    }
 
-        QSet<QString> strSet;
-        for( int i = 0; i < strList.size(); ++i )
-        {
-            if( strSet.contains( strList.at( i ) ) )
-            {
-                strList.removeAt( i );
-                --i;
-            }
-            else
-            {
-                strSet.insert( strList.at( i ) );
-            }
-        }
+    void MainWindow::deleteDuplicateKeepLast( void )
+    {
+        deleteDuplicateLines( LineDeduplicator( LineDeduplicator::KeepLast ) );
+    }
 
-        textCursor.beginEditBlock();
-        textCursor.deleteChar();
-        textCursor.insertText( strList.join( QChar( 0x2029 ) ) );
-        if( lastEmpty )
-        {
-            textCursor.insertText( QChar( 0x2029 ) );
-        }
-        textCursor.endEditBlock();
-        textEdit->setTextCursor( textCursor );
+    void MainWindow::countDuplicate( void )
+    {
+        deleteDuplicateLines( LineDeduplicator( LineDeduplicator::KeepFirst, true ) );
     }
 
     void MainWindow::findText( void )
@@ -758,7 +1176,7 @@ namespace mote
             }
         }
 
-        const QList<TextEdit*> edits = TextEdit::findEdits( textDocument );
+        const QList<TextEdit*> edits = m_documentSystem->findEdits( textDocument );
         QVector<int> cursorPositions( edits.size() );
         QVector<int> scrollValues( edits.size() );
         for( int i = 0; i < edits.size(); ++i )
@@ -794,10 +1212,31 @@ namespace mote
 
     void MainWindow::closeEvent( QCloseEvent* event )
     {
-        while( m_tabWidget->count() > 1 )
-        {
-            if( !_closeTab() )
+        // The session is the last window's; start-up restores into one. It
+        // is taken while the tabs are there, and kept only once they have
+        // all closed.
+        bool lastWindow = true;
+        const QWidgetList wins = QApplication::topLevelWidgets();
+        for( int i = 0; i < wins.size(); ++i )
+        {
+            if( ( wins.at( i ) != this ) &&
+                qobject_cast<MainWindow*>( wins.at( i ) ) &&
+                wins.at( i )->isVisible() )
             {
+                lastWindow = false;
+                break;
+            }
+        }
+        const Session session = this->session();
+
+        // Tabs becoming current while closing are not loaded.
+        m_closing = true;
+        while( m_tabWidget->count() > 1 )
+        {
+            if( !_closeTab() )
+            {
+                m_closing = false;
+                onCurrentTabChanged();
                 event->ignore();
                 return;
             }
@@ -805,10 +1244,15 @@ namespace mote
 
         if( !_closeTab() )
         {
+            m_closing = false;
             event->ignore();
             return;
         }
 
+        if( lastWindow )
+        {
+            saveSession( session );
+        }
         saveGeometryAndState();
 
         m_settings->setFindCaseSensitivity(
@@ -828,6 +1272,184 @@ namespace mote
         event->accept();
     }
 
+    // Every view is registered with the document system, which finds the
+    // views of a document or a path without going through the windows.
+    TextEdit* MainWindow::createEdit( TextDocument* textDocument )
+    {
+        TextEdit* textEdit = new TextEdit( textDocument );
+        textEdit->setLineNumberVisible( m_settings->isLineNumberVisible() );
+        m_documentSystem->addEdit( textEdit );
+        return textEdit;
+    }
+
+    // Each tab holds its views in a splitter.
+    int MainWindow::addPage( TextEdit* textEdit )
+    {
+        QSplitter* splitter = new QSplitter;
+        splitter->setChildrenCollapsible( false );
+        splitter->addWidget( textEdit );
+
+        const TextDocument* textDocument = qobject_cast<TextDocument*>( textEdit->document() );
+        return m_tabWidget->addTab( splitter, makeTabTitle( textDocument ) );
+    }
+
+    int MainWindow::pageIndexOf( QWidget* widget )const
+    {
+        for( ; widget; widget = widget->parentWidget() )
+        {
+            const int index = m_tabWidget->indexOf( widget );
+            if( index != -1 )
+            {
+                return index;
+            }
+        }
+        return -1;
+    }
+
+    int MainWindow::placeholderIndexOf( const QString& path )const
+    {
+        if( m_placeholders.isEmpty() )
+        {
+            return -1;
+        }
+
+        const QString canonicalPath = DocumentSystem::canonicalPath( path );
+        for( QHash<QWidget*, Placeholder>::const_iterator itr = m_placeholders.begin();
+             itr != m_placeholders.end();
+             ++itr )
+        {
+            if( itr.value().canonicalPath == canonicalPath )
+            {
+                return m_tabWidget->indexOf( itr.key() );
+            }
+        }
+        return -1;
+    }
+
+    // Replaces a placeholder by a view of its file. A file that cannot be
+    // read leaves an empty document in the tab.
+    void MainWindow::loadPage( const int index )
+    {
+        QSplitter* splitter = qobject_cast<QSplitter*>( m_tabWidget->widget( index ) );
+        if( !splitter || !m_placeholders.contains( splitter ) )
+        {
+            return;
+        }
+
+        const Placeholder placeholder = m_placeholders.take( splitter );
+
+        TextDocument* textDocument = m_documentSystem->createDocument();
+        if( !textDocument->openFile( placeholder.path ) )
+        {
+            statusBar()->showMessage(
+                tr( "Cannot open %1." ).arg( QDir::toNativeSeparators( placeholder.path ) ) );
+        }
+        textDocument->setFont( m_settings->font() );
+
+        TextEdit* textEdit = createEdit( textDocument );
+        splitter->addWidget( textEdit );
+        m_tabWidget->setTabText( index, makeTabTitle( textDocument ) );
+
+        QTextCursor textCursor = textEdit->textCursor();
+        textCursor.setPosition( qBound( 0, placeholder.cursorPosition, textDocument->characterCount() - 1 ) );
+        textEdit->setTextCursor( textCursor );
+        textEdit->verticalScrollBar()->setValue( placeholder.scrollValue );
+        textEdit->setFocus();
+    }
+
+    // A tab long hidden whose file is saved and has no undo history goes
+    // back to a placeholder; otherwise only the layouts of its document
+    // are dropped. Documents also shown by other tabs are left alone.
+    void MainWindow::releasePage( QWidget* page )
+    {
+        const int index = m_tabWidget->indexOf( page );
+        const QList<TextEdit*> edits = editsAt( index );
+        TextEdit* textEdit = editAt( index );
+        TextDocument* textDocument =
+            textEdit ? qobject_cast<TextDocument*>( textEdit->document() ) : NULL;
+        if( !textDocument ||
+            ( m_documentSystem->findEdits( textDocument ).size() != edits.size() ) )
+        {
+            return;
+        }
+
+        if( textDocument->isModified() ||
+            textDocument->isUndoAvailable() ||
+            textDocument->isRedoAvailable() ||
+            textDocument->filePath().isEmpty() )
+        {
+            textDocument->releaseLayouts();
+            return;
+        }
+
+        Placeholder placeholder;
+        placeholder.path = textDocument->filePath();
+        placeholder.canonicalPath = DocumentSystem::canonicalPath( placeholder.path );
+        placeholder.cursorPosition = textEdit->textCursor().position();
+        placeholder.scrollValue = textEdit->verticalScrollBar()->value();
+
+        for( int i = 0; i < edits.size(); ++i )
+        {
+            TextEdit* edit = edits.at( i );
+            m_documentSystem->removeEdit( edit );
+            edit->hide();
+            edit->setParent( NULL );
+            edit->deleteLater();
+        }
+        textDocument->deleteLater();
+
+        // Nested splitters go too; the tab starts over with one view.
+        const QList<QSplitter*> splitters = page->findChildren<QSplitter*>( QString(), Qt::FindDirectChildrenOnly );
+        for( int i = 0; i < splitters.size(); ++i )
+        {
+            delete splitters.at( i );
+        }
+
+        m_currentEdits.remove( page );
+        m_placeholders.insert( page, placeholder );
+    }
+
+    // Opens another view of the current document beside the current one.
+    // Views share the document and its layout; each keeps its own cursor
+    // and scroll position.
+    void MainWindow::splitEdit( const Qt::Orientation orientation )
+    {
+        TextEdit* textEdit = currentEdit();
+        TextDocument* textDocument = currentDocument();
+        QSplitter* splitter = textEdit ? qobject_cast<QSplitter*>( textEdit->parentWidget() ) : NULL;
+        if( !splitter || !textDocument )
+        {
+            return;
+        }
+
+        int index = splitter->indexOf( textEdit );
+        if( ( splitter->count() > 1 ) && ( splitter->orientation() != orientation ) )
+        {
+            QSplitter* innerSplitter = new QSplitter( orientation );
+            innerSplitter->setChildrenCollapsible( false );
+            splitter->insertWidget( index, innerSplitter );
+            innerSplitter->addWidget( textEdit );
+            splitter = innerSplitter;
+            index = 0;
+        }
+        splitter->setOrientation( orientation );
+
+        TextEdit* newEdit = createEdit( textDocument );
+        newEdit->setTabStopWidthBySpace( textEdit->tabStopWidthBySpace() );
+        newEdit->setTextCursor( textEdit->textCursor() );
+        splitter->insertWidget( index + 1, newEdit );
+
+        QList<int> sizes;
+        for( int i = 0; i < splitter->count(); ++i )
+        {
+            sizes += 1;
+        }
+        splitter->setSizes( sizes );
+
+        newEdit->verticalScrollBar()->setValue( textEdit->verticalScrollBar()->value() );
+        activate( newEdit );
+    }
+
     QString MainWindow::makeTabTitle( const TextDocument* textDocument )const
     {
         QString tabTitle = textDocument->fileName();
@@ -873,7 +1495,20 @@ namespace mote
     {
         const int idx = ( index == -1 ) ? m_tabWidget->currentIndex() : index;
 
-        TextEdit* textEdit = qobject_cast<TextEdit*>( m_tabWidget->widget( idx ) );
+        QWidget* page = m_tabWidget->widget( idx );
+        if( m_placeholders.contains( page ) )
+        {
+            if( m_tabWidget->count() > 1 )
+            {
+                m_placeholders.remove( page );
+                m_recentPages.removeAll( page );
+                m_tabWidget->removeTab( idx );
+                page->deleteLater();
+            }
+            return true;
+        }
+
+        TextEdit* textEdit = editAt( idx );
         if( !textEdit )
         {
             Q_ASSERT( 0 );
@@ -887,8 +1522,16 @@ namespace mote
             return false;
         }
 
-        const QList<TextEdit*> edits = TextEdit::findEdits( textDocument );
-        if( textDocument->isModified() && ( edits.size() == 1 ) )
+        // Only the views of this tab may be left to the document.
+        const QList<TextEdit*> edits = m_documentSystem->findEdits( textDocument );
+        const QList<TextEdit*> pageEdits = editsAt( idx );
+        const bool lastEdits = ( edits.size() == pageEdits.size() );
+        if( lastEdits )
+        {
+            // A save waiting for formatting is finished before asking.
+            waitForSave( textDocument );
+        }
+        if( textDocument->isModified() && lastEdits )
         {
             QString fileName = textDocument->fileName();
             if( fileName.isEmpty() )
@@ -906,9 +1549,13 @@ namespace mote
             switch( ret )
             {
             case QMessageBox::Yes:
-                if( !saveFile( textDocument ) )
                 {
-                    return false;
+                    const SaveResult result = saveFile( textDocument );
+                    if( ( result == SaveFailed ) ||
+                        ( ( result == SavePending ) && !waitForSave( textDocument ) ) )
+                    {
+                        return false;
+                    }
                 }
                 break;
             case QMessageBox::Cancel:
@@ -922,10 +1569,16 @@ namespace mote
         if( m_tabWidget->count() > 1 )
         {
             m_tabWidget->removeTab( idx );
+            m_currentEdits.remove( page );
+            m_recentPages.removeAll( page );
 
-            textEdit->deleteLater();
+            for( int i = 0; i < pageEdits.size(); ++i )
+            {
+                m_documentSystem->removeEdit( pageEdits.at( i ) );
+            }
+            page->deleteLater();
 
-            if( edits.size() == 1 )
+            if( lastEdits )
             {
                 textDocument->deleteLater();
             }
@@ -934,6 +1587,98 @@ namespace mote
         return true;
     }
 
+    void MainWindow::sortLines( const LineSorter::Options& options )
+    {
+        TextEdit* textEdit = currentEdit();
+        if( !textEdit )
+        {
+            return;
+        }
+
+        QTextCursor textCursor = textEdit->textCursor();
+        if( !textCursor.hasSelection() )
+        {
+            return;
+        }
+
+        const TextLines lines( selectedLines( textCursor ), '\n' );
+        if( lines.count() == 0 )
+        {
+            return;
+        }
+
+        const LineSorter sorter( options );
+        const QString sortedText = lines.join( sorter.sort( lines ) );
+
+        textCursor.beginEditBlock();
+        textCursor.deleteChar();
+        textCursor.insertText( sortedText );
+        textCursor.endEditBlock();
+        textEdit->setTextCursor( textCursor );
+    }
+
+    void MainWindow::deleteDuplicateLines( const LineDeduplicator& deduplicator )
+    {
+        TextEdit* textEdit = currentEdit();
+        if( !textEdit )
+        {
+            return;
+        }
+
+        QTextCursor textCursor = textEdit->textCursor();
+        if( !textCursor.hasSelection() )
+        {
+            return;
+        }
+
+        const TextLines lines( selectedLines( textCursor ), '\n' );
+        if( lines.count() == 0 )
+        {
+            return;
+        }
+
+        const QString uniqueText = deduplicator.exec( lines );
+
+        textCursor.beginEditBlock();
+        textCursor.deleteChar();
+        textCursor.insertText( uniqueText );
+        textCursor.endEditBlock();
+        textEdit->setTextCursor( textCursor );
+    }
+
+    void MainWindow::showTagJumpDialog( TextEdit* textEdit, const CTags& ctags )
+    {
+        // Keep our own copy: the cache may be refreshed while the dialog runs.
+        const CTags tags = ctags;
+
+        // ctags numbers the lines of the file, not the blocks.
+        const TextDocument* textDocument = qobject_cast<TextDocument*>( textEdit->document() );
+        if( !textDocument )
+        {
+            return;
+        }
+
+        TagJumpDialog* dialog = new TagJumpDialog(
+            tags,
+            textDocument->lineNumber( textEdit->textCursor().block() ) + 1,
+            this );
+        dialog->restoreSize( m_settings );
+        if( dialog->exec() == QDialog::Accepted )
+        {
+            QTextBlock block =
+                textDocument->findBlockByLineNumber( tags.lineNumber( dialog->selectedEntry() ) - 1 );
+            if( block.isValid() )
+            {
+                QTextCursor textCursor = textEdit->textCursor();
+                textCursor.setPosition( block.position() );
+                textEdit->setTextCursor( textCursor );
+                textEdit->centerCursor();
+            }
+        }
+        dialog->saveSize( m_settings );
+        delete dialog;
+    }
+
     void MainWindow::commitFindDialog( void )
     {
         if( m_findDialog )
@@ -997,8 +1742,7 @@ namespace mote
     {
         for( int i = 0; i < m_tabWidget->count(); ++i )
         {
-            TextEdit* textEdit =
-                qobject_cast<TextEdit*>( m_tabWidget->widget( i ) );
+            const TextEdit* textEdit = editAt( i );
             if( !textEdit || ( textEdit->document() != textDocument ) )
             {
                 continue;
@@ -1014,20 +1758,60 @@ namespace mote
 
         for( int i = 0; i < m_tabWidget->count(); ++i )
         {
-            TextEdit* textEdit =
-                qobject_cast<TextEdit*>( m_tabWidget->widget( i ) );
-            if( textEdit )
+            const QList<TextEdit*> edits = editsAt( i );
+            for( int j = 0; j < edits.size(); ++j )
             {
-                textEdit->setLineNumberVisible( onoff );
+                edits.at( j )->setLineNumberVisible( onoff );
             }
         }
     }
 
+    // Loads the tab shown if it is a placeholder and lets the tabs least
+    // recently shown give up their memory.
     void MainWindow::onCurrentTabChanged( void )
     {
+        const int index = m_tabWidget->currentIndex();
+        if( !m_closing && ( index != -1 ) )
+        {
+            loadPage( index );
+
+            QWidget* page = m_tabWidget->widget( index );
+            m_recentPages.removeAll( page );
+            m_recentPages.prepend( page );
+            if( m_recentPages.size() > LoadedPageCount )
+            {
+                releasePage( m_recentPages.at( LoadedPageCount ) );
+            }
+        }
+
+        m_outlineDock->setTextEdit( currentEdit() );
         emit currentDocumentChanged( currentDocument() );
     }
 
+    // Follows the focus between the views of a tab, so that commands act
+    // on the one last used.
+    void MainWindow::onFocusChanged( QWidget* old, QWidget* now )
+    {
+        Q_UNUSED( old );
+
+        TextEdit* textEdit = qobject_cast<TextEdit*>( now );
+        const int index = textEdit ? pageIndexOf( textEdit ) : -1;
+        if( index == -1 )
+        {
+            return;
+        }
+
+        QWidget* page = m_tabWidget->widget( index );
+        if( m_currentEdits.value( page ) != textEdit )
+        {
+            m_currentEdits.insert( page, textEdit );
+            if( index == m_tabWidget->currentIndex() )
+            {
+                m_outlineDock->setTextEdit( textEdit );
+            }
+        }
+    }
+
     void MainWindow::onTabCloseRequested( int index )
     {
         if( m_tabWidget->count() == 1 )
@@ -1043,37 +1827,115 @@ namespace mote
     void MainWindow::tagJump( void )
     {
         TextEdit* textEdit = currentEdit();
-        if( !textEdit )
+        TextDocument* textDocument = currentDocument();
+        if( !textEdit || !textDocument )
         {
             return;
         }
 
-        CTags ctags;
-        if( !ctags.exec( textEdit->document() ) )
+        TagService* tagService = m_documentSystem->tagService();
+        if( tagService->requestTags( textDocument ) )
+        {
+            m_pendingTagJumpEdit = NULL;
+            showTagJumpDialog( textEdit, *tagService->tags( textDocument ) );
+        }
+        else
+        {
+            // Shown from onTagsUpdated() once the worker is done.
+            m_pendingTagJumpEdit = textEdit;
+            statusBar()->showMessage( tr( "Generating tags..." ) );
+        }
+    }
+
+    void MainWindow::onTagsUpdated( TextDocument* textDocument )
+    {
+        if( !m_pendingTagJumpEdit || ( m_pendingTagJumpEdit->document() != textDocument ) )
         {
             return;
         }
 
-        TagJumpDialog* dialog = new TagJumpDialog(
-            ctags,
-            textEdit->textCursor().blockNumber() + 1,
-            this );
-        dialog->restoreSize( m_settings );
-        if( dialog->exec() == QDialog::Accepted )
+        TextEdit* textEdit = m_pendingTagJumpEdit;
+        m_pendingTagJumpEdit = NULL;
+        statusBar()->clearMessage();
+
+        const CTags* ctags = m_documentSystem->tagService()->tags( textDocument );
+        if( ctags && ( textEdit == currentEdit() ) )
         {
-            const CTags::Entry& entry = ctags.entry( dialog->selectedEntry() );
-            QTextBlock block =
-                textEdit->document()->findBlockByNumber( entry.exCmd.toInt() - 1 );
-            if( block.isValid() )
-            {
-                QTextCursor textCursor = textEdit->textCursor();
-                textCursor.setPosition( block.position() );
-                textEdit->setTextCursor( textCursor );
-                textEdit->centerCursor();
-            }
+            showTagJumpDialog( textEdit, *ctags );
+        }
+    }
+
+    void MainWindow::onTagsFailed( TextDocument* textDocument )
+    {
+        if( !m_pendingTagJumpEdit || ( m_pendingTagJumpEdit->document() != textDocument ) )
+        {
+            return;
+        }
+
+        m_pendingTagJumpEdit = NULL;
+        statusBar()->showMessage( tr( "Failed to generate tags." ), 3000 );
+    }
+
+    void MainWindow::onSymbolIndexUpdateStarted( void )
+    {
+        statusBar()->showMessage( tr( "Updating project index..." ) );
+    }
+
+    void MainWindow::onSymbolIndexUpdateFinished( bool ok )
+    {
+        const SymbolIndex* symbolIndex = m_documentSystem->symbolIndex();
+        if( ok )
+        {
+            statusBar()->showMessage(
+                tr( "Project index: %1 symbols in %2 files." )
+                .arg( symbolIndex->symbolCount() )
+                .arg( symbolIndex->fileCount() ),
+                3000 );
+        }
+        else
+        {
+            statusBar()->showMessage( tr( "Failed to update project index." ), 3000 );
+        }
+    }
+
+    void MainWindow::onBatchFormatFinished( void )
+    {
+        statusBar()->clearMessage();
+
+        const BatchFormatter::Statistics statistics = m_batchFormatWatcher.result();
+        QString text = statistics.summary();
+        if( !statistics.errors.isEmpty() )
+        {
+            text += "\n\n";
+            text += statistics.errors.mid( 0, 10 ).join( "\n" );
+        }
+        if( statistics.openFiles.isEmpty() )
+        {
+            QMessageBox::information( this, tr( "Format Files in Directory" ), text );
+        }
+        else
+        {
+            text += "\n\n";
+            text += tr( "%n file(s) open in the editor were not formatted:", "", statistics.openCount );
+            text += '\n';
+            text += statistics.openFiles.mid( 0, 10 ).join( "\n" );
+            QMessageBox::warning( this, tr( "Format Files in Directory" ), text );
+        }
+    }
+
+    void MainWindow::onModifiedLinesFormatted( TextDocument* textDocument )
+    {
+        if( !m_pendingSaves.contains( textDocument ) )
+        {
+            return;
+        }
+
+        statusBar()->clearMessage();
+        const QString path = m_pendingSaves.take( textDocument );
+        if( !writeFile( textDocument, path ) )
+        {
+            QMessageBox::warning( this, tr( "Save" ), tr( "Cannot write %1." ).arg( path ) );
         }
-        dialog->saveSize( m_settings );
-        delete dialog;
     }
 
     void MainWindow::onFindTextAccepted( void )
@@ -1090,21 +1952,151 @@ namespace mote
             return;
         }
 
+        const TextDocument* textDocument = qobject_cast<TextDocument*>( textEdit->document() );
+        if( !textDocument )
+        {
+            return;
+        }
+
         QTextCursor textCursor = textEdit->textCursor();
         bool ok = false;
         const int lineNumber = QInputDialog::getInt(
                                    this,
                                    tr( "Go to Line" ),
                                    tr( "Line number" ),
-                                   textCursor.block().blockNumber() + 1,
+                                   textDocument->lineNumber( textCursor.block() ) + 1,
                                    1,
-                                   textEdit->document()->blockCount(),
+                                   textDocument->lineCount(),
                                    1,
                                    &ok );
         if( ok )
         {
             textCursor.setPosition(
-                textEdit->document()->findBlockByNumber( lineNumber - 1 ).position() );
+                textDocument->findBlockByLineNumber( lineNumber - 1 ).position() );
+            textEdit->setTextCursor( textCursor );
+            textEdit->centerCursor();
+        }
+    }
+
+    void MainWindow::setProjectDirectory( void )
+    {
+        const QString dir = QFileDialog::getExistingDirectory(
+                                this,
+                                tr( "Project Directory" ),
+                                m_settings->projectDirectory() );
+        if( !dir.isEmpty() )
+        {
+            m_settings->setProjectDirectory( dir );
+        }
+    }
+
+    void MainWindow::updateProjectIndex( void )
+    {
+        SymbolIndex* symbolIndex = m_documentSystem->symbolIndex();
+        if( symbolIndex->rootPath().isEmpty() )
+        {
+            setProjectDirectory();
+        }
+        else
+        {
+            symbolIndex->update();
+        }
+    }
+
+    void MainWindow::jumpToDefinition( void )
+    {
+        TextEdit* textEdit = currentEdit();
+        if( !textEdit )
+        {
+            return;
+        }
+
+        QTextCursor textCursor = textEdit->textCursor();
+        if( !textCursor.hasSelection() )
+        {
+            textCursor.select( QTextCursor::WordUnderCursor );
+        }
+        const QString name = textCursor.selectedText().trimmed();
+        if( name.isEmpty() )
+        {
+            return;
+        }
+
+        const SymbolIndex* symbolIndex = m_documentSystem->symbolIndex();
+        if( symbolIndex->rootPath().isEmpty() )
+        {
+            statusBar()->showMessage( tr( "Project directory is not set." ), 3000 );
+            return;
+        }
+
+        const QList<SymbolIndex::Symbol> symbols = symbolIndex->find( name );
+        if( symbols.isEmpty() )
+        {
+            statusBar()->showMessage( tr( "\"%1\" is not found in the project index." ).arg( name ), 3000 );
+            return;
+        }
+
+        int index = 0;
+        if( symbols.size() > 1 )
+        {
+            const QDir root( symbolIndex->rootPath() );
+            QStringList items;
+            for( int i = 0; i < symbols.size(); ++i )
+            {
+                const SymbolIndex::Symbol& symbol = symbols.at( i );
+                QString item = QString( "%1:%2  %3" )
+                               .arg( root.relativeFilePath( symbol.filePath ) )
+                               .arg( symbol.lineNumber )
+                               .arg( symbol.kind );
+                if( !symbol.scope.isEmpty() )
+                {
+                    item += QString( "  %1::%2" ).arg( symbol.scope ).arg( symbol.name );
+                }
+                items += item;
+            }
+
+            bool ok = false;
+            const QString item = QInputDialog::getItem(
+                                     this,
+                                     tr( "Jump to Definition" ),
+                                     name,
+                                     items,
+                                     0,
+                                     false,
+                                     &ok );
+            if( !ok )
+            {
+                return;
+            }
+            index = items.indexOf( item );
+        }
+
+        const SymbolIndex::Symbol& symbol = symbols.at( qMax( index, 0 ) );
+        openFileAtLine( symbol.filePath, symbol.lineNumber );
+    }
+
+    void MainWindow::openFileAtLine( const QString& path, int lineNumber )
+    {
+        openFile( path );
+
+        const QList<TextEdit*> edits = m_documentSystem->findEdits( path );
+        if( edits.isEmpty() )
+        {
+            return;
+        }
+
+        TextEdit* textEdit = edits.front();
+        const TextDocument* textDocument = qobject_cast<TextDocument*>( textEdit->document() );
+        if( !textDocument )
+        {
+            return;
+        }
+
+        const QTextBlock block = textDocument->findBlockByLineNumber( lineNumber - 1 );
+        if( block.isValid() )
+        {
+            QTextCursor textCursor = textEdit->textCursor();
+            textCursor.setPosition( block.position() );
             textEdit->setTextCursor( textCursor );
             textEdit->centerCursor();
         }
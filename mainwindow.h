@@ -1,16 +1,27 @@
 #pragma once
 
 #include <QAction>
+#include <QFutureWatcher>
+#include <QHash>
 #include <QList>
 #include <QMainWindow>
+#include <QPointer>
 #include <QRegExp>
+#include <QStringList>
 #include <QTabWidget>
 #include <QTextDocument>
+#include <QVariant>
+
+#include "batchformatter.h"
+#include "linesorter.h"
 
 namespace mote
 {
+    class CTags;
     class DocumentSystem;
     class FindDialog;
+    class LineDeduplicator;
+    class OutlineDock;
     class Settings;
     class TextDocument;
     class TextEdit;
@@ -19,6 +30,16 @@ namespace mote
     {
         Q_OBJECT
 
+    public:
+        // With format on save the file is written once the modified lines
+        // are formatted; until then the save is pending.
+        enum SaveResult
+        {
+            SaveFailed,
+            Saved,
+            SavePending
+        };
+
     public:
         MainWindow(
             Settings* settings,
@@ -28,12 +49,15 @@ namespace mote
     public:
         TextEdit* currentEdit( void )const;
         TextDocument* currentDocument( void )const;
+        QList<TextEdit*> editsAt( const int index )const;
+        TextEdit* editAt( const int index )const;
         void saveGeometryAndState( void );
         void restoreGeometryAndState( void );
-        QList<TextEdit*> findEdits( TextDocument* textDocument = NULL )const;
-        QList<TextEdit*> findEdits( const QString& path )const;
-        bool saveFile( TextDocument* textDocument );
-        bool saveFileAs( TextDocument* textDocument );
+        void saveSession( void );
+        void restoreSession( void );
+        SaveResult saveFile( TextDocument* textDocument );
+        SaveResult saveFileAs( TextDocument* textDocument );
+        bool waitForSave( TextDocument* textDocument );
         void activate( TextEdit* textEdit );
         void openFile( const QString& path );
 
@@ -42,18 +66,36 @@ namespace mote
         void saveFile( void );
         void saveFileAs( void );
         void changeFont( void );
+        void setFrameTimingsVisible( bool onoff );
+        void saveFrameTimings( void );
         void formatSourceCode( void );
+        void formatWholeSourceCode( void );
+        void reindentLines( void );
+        void formatFilesInDirectory( void );
+        void editFormatterProfiles( void );
         void closeTab( void );
         void createNewWindow( void );
+        void splitHorizontally( void );
+        void splitVertically( void );
+        void closeSplitView( void );
         void createNewDocument( void );
         void jumpToCoBrace( void );
+        void selectAllOccurrences( void );
         void sortAscending( void );
+        void sortDescending( void );
+        void sortLinesWithOptions( void );
         void deleteDuplicate( void );
+        void deleteAdjacentDuplicate( void );
+        void deleteDuplicateKeepLast( void );
+        void countDuplicate( void );
         void findText( void );
         void findNext( void );
         void findPrevious( void );
         void replaceText( void );
         void reload( void );
+        void setProjectDirectory( void );
+        void updateProjectIndex( void );
+        void jumpToDefinition( void );
 
     signals:
         void currentDocumentChanged( TextDocument* textDocument );
@@ -62,9 +104,33 @@ namespace mote
         virtual void closeEvent( QCloseEvent* event );
 
     private:
+        struct Session
+        {
+            QStringList paths;
+            QVariantList cursorPositions;
+            QVariantList scrollValues;
+            int currentIndex;
+        };
+
+    private:
+        Session session( void )const;
+        void saveSession( const Session& session );
+        TextEdit* createEdit( TextDocument* textDocument );
+        int addPage( TextEdit* textEdit );
+        int pageIndexOf( QWidget* widget )const;
+        int placeholderIndexOf( const QString& path )const;
+        void loadPage( const int index );
+        void releasePage( QWidget* page );
+        void splitEdit( const Qt::Orientation orientation );
         QString makeTabTitle( const TextDocument* textDocument )const;
         QString makeWindowTitle( const TextDocument* textDocument )const;
         bool _closeTab( const int index = -1 );
+        void sortLines( const LineSorter::Options& options );
+        void deleteDuplicateLines( const LineDeduplicator& deduplicator );
+        void showTagJumpDialog( TextEdit* textEdit, const CTags& ctags );
+        void openFileAtLine( const QString& path, int lineNumber );
+        SaveResult saveFile( TextDocument* textDocument, const QString& path );
+        bool writeFile( TextDocument* textDocument, const QString& path );
         void commitFindDialog( void );
         void createFindDialog( void );
 
@@ -73,8 +139,15 @@ namespace mote
         void updateTabTitle( TextDocument* textDocument );
         void onLineNumberVisibilityChanged( bool onoff );
         void onCurrentTabChanged( void );
+        void onFocusChanged( QWidget* old, QWidget* now );
         void onTabCloseRequested( int index );
         void tagJump( void );
+        void onTagsUpdated( TextDocument* textDocument );
+        void onTagsFailed( TextDocument* textDocument );
+        void onSymbolIndexUpdateStarted( void );
+        void onSymbolIndexUpdateFinished( bool ok );
+        void onBatchFormatFinished( void );
+        void onModifiedLinesFormatted( TextDocument* textDocument );
         void onFindTextAccepted( void );
         void jumpToLine( void );
 
@@ -82,8 +155,25 @@ namespace mote
         Settings* m_settings;
         DocumentSystem* m_documentSystem;
         QTabWidget* m_tabWidget;
+        QHash< QWidget*, QPointer<TextEdit> > m_currentEdits;
+        // A tab whose file is not loaded yet, or was released while idle.
+        struct Placeholder
+        {
+            QString path;
+            QString canonicalPath;
+            int cursorPosition;
+            int scrollValue;
+        };
+        QHash<QWidget*, Placeholder> m_placeholders;
+        QList<QWidget*> m_recentPages;
+        bool m_closing;
         QAction* m_lineNumberAction;
+        QAction* m_frameTimingsAction;
         FindDialog* m_findDialog;
+        OutlineDock* m_outlineDock;
+        QPointer<TextEdit> m_pendingTagJumpEdit;
+        QHash<TextDocument*, QString> m_pendingSaves;
+        QFutureWatcher<BatchFormatter::Statistics> m_batchFormatWatcher;
         struct
         {
             bool replaceMode;
@@ -5,7 +5,7 @@
 TEMPLATE = app
 TARGET = mote
 INCLUDEPATH += . AStyle/src
-QT += widgets
+QT += widgets concurrent
 
 DEFINES += \
     ASTYLE_LIB \
@@ -13,19 +13,42 @@ DEFINES += \
 
 # Input
 HEADERS += \
+    batchformatter.h \
+    benchmark.h \
+    blockdata.h \
     bomaction.h \
+    completionindex.h \
+    completionmodel.h \
     cppsyntaxhighlighter.h \
     ctags.h \
     documentsystem.h \
     finddialog.h \
+    formatterprofiles.h \
+    formatterprofilesdialog.h \
+    frameprofiler.h \
+    fuzzymatcher.h \
     inputcompletionitemdelegate.h \
+    linededuplicator.h \
+    linediff.h \
+    lineindenter.h \
+    linesorter.h \
     mainwindow.h \
+    multicursor.h \
     newlinecharacteraction.h \
+    outlinedock.h \
     settings.h \
+    smartindenter.h \
+    sortlinesdialog.h \
+    sourceformatter.h \
+    symbolindex.h \
     tagjumpdialog.h \
+    tagservice.h \
+    tagworker.h \
     textcodecaction.h \
     textdocument.h \
-    textedit.h
+    textedit.h \
+    textlines.h \
+    wordindex.h
 
 SOURCES += \
     AStyle/src/ASBeautifier.cpp \
@@ -33,21 +56,44 @@ SOURCES += \
     AStyle/src/ASFormatter.cpp \
     AStyle/src/ASResource.cpp \
     AStyle/src/astyle_main.cpp \
+    batchformatter.cpp \
+    benchmark.cpp \
+    blockdata.cpp \
     bomaction.cpp \
+    completionindex.cpp \
+    completionmodel.cpp \
     cppsyntaxhighlighter.cpp \
     ctags.cpp \
     documentsystem.cpp \
     finddialog.cpp \
     formatsourcecode.cpp \
+    frameprofiler.cpp \
+    formatterprofiles.cpp \
+    formatterprofilesdialog.cpp \
+    fuzzymatcher.cpp \
     inputcompletionitemdelegate.cpp \
+    linededuplicator.cpp \
+    linediff.cpp \
+    lineindenter.cpp \
+    linesorter.cpp \
     main.cpp \
     mainwindow.cpp \
+    multicursor.cpp \
     newlinecharacteraction.cpp \
+    outlinedock.cpp \
     settings.cpp \
+    smartindenter.cpp \
+    sortlinesdialog.cpp \
+    sourceformatter.cpp \
+    symbolindex.cpp \
     tagjumpdialog.cpp \
+    tagservice.cpp \
+    tagworker.cpp \
     textcodecaction.cpp \
     textdocument.cpp \
-    textedit.cpp
+    textedit.cpp \
+    textlines.cpp \
+    wordindex.cpp
 
 TRANSLATIONS += \
     mote_ja.ts
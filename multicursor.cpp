@@ -0,0 +1,282 @@
+#include "multicursor.h"
+
+#include <algorithm>
+
+#include "textdocument.h"
+
+namespace mote
+{
+    namespace
+    {
+        bool lessRange( const MultiCursor::Range& range1, const MultiCursor::Range& range2 )
+        {
+            if( MultiCursor::start( range1 ) != MultiCursor::start( range2 ) )
+            {
+                return MultiCursor::start( range1 ) < MultiCursor::start( range2 );
+            }
+            return MultiCursor::end( range1 ) < MultiCursor::end( range2 );
+        }
+
+        bool lessEnd( const MultiCursor::Range& range, const int position )
+        {
+            return MultiCursor::end( range ) < position;
+        }
+
+        bool isCaret( const MultiCursor::Range& range )
+        {
+            return range.anchor == range.position;
+        }
+
+        // Each range is edited in an edit block of its own, so that the
+        // document reports, and the highlighter and the views redo, only
+        // the edited blocks rather than everything from the first range to
+        // the last. Joining the blocks keeps one undo step.
+        void beginRangeEdit( QTextCursor& cursor, bool& joined )
+        {
+            if( joined )
+            {
+                cursor.joinPreviousEditBlock();
+            }
+            else
+            {
+                cursor.beginEditBlock();
+                joined = true;
+            }
+        }
+    }
+
+    MultiCursor::MultiCursor( void )
+    {
+    }
+
+    bool MultiCursor::isEmpty( void )const
+    {
+        return m_ranges.isEmpty();
+    }
+
+    int MultiCursor::count( void )const
+    {
+        return m_ranges.size();
+    }
+
+    void MultiCursor::clear( void )
+    {
+        m_ranges.clear();
+    }
+
+    const QVector<MultiCursor::Range>& MultiCursor::ranges( void )const
+    {
+        return m_ranges;
+    }
+
+    void MultiCursor::setRanges( const QVector<Range>& ranges )
+    {
+        m_ranges = ranges;
+        normalize();
+    }
+
+    void MultiCursor::add( const int anchor, const int position )
+    {
+        Range range;
+        range.anchor = anchor;
+        range.position = position;
+        m_ranges.insert(
+            std::lower_bound( m_ranges.begin(), m_ranges.end(), range, lessRange ),
+            range );
+        normalize();
+    }
+
+    // The first range ending at or after position. Ranges do not overlap,
+    // so their ends are in order as well as their starts.
+    int MultiCursor::lowerBound( const int position )const
+    {
+        return std::lower_bound( m_ranges.begin(), m_ranges.end(), position, lessEnd ) - m_ranges.begin();
+    }
+
+    // The selected texts, one per line.
+    QString MultiCursor::selectedText( const QTextDocument* document )const
+    {
+        const TextDocument* textDocument = qobject_cast<const TextDocument*>( document );
+        QStringList texts;
+        QTextCursor cursor( const_cast<QTextDocument*>( document ) );
+        for( int i = 0; i < m_ranges.size(); ++i )
+        {
+            const Range& range = m_ranges.at( i );
+            if( isCaret( range ) )
+            {
+                continue;
+            }
+
+            if( textDocument )
+            {
+                texts += textDocument->text( qMin( range.anchor, range.position ), qMax( range.anchor, range.position ) );
+                continue;
+            }
+
+            cursor.setPosition( range.anchor );
+            cursor.setPosition( range.position, QTextCursor::KeepAnchor );
+            texts += cursor.selectedText().replace( QChar::ParagraphSeparator, '\n' );
+        }
+        return texts.join( "\n" );
+    }
+
+    // Replaces every range by text, leaving carets after the insertions.
+    void MultiCursor::insertText( QTextDocument* document, const QString& text )
+    {
+        insert( document, QStringList( text ) );
+    }
+
+    // Replaces each range by the text at its index, as when pasting as
+    // many lines as there are cursors.
+    void MultiCursor::insertTexts( QTextDocument* document, const QStringList& texts )
+    {
+        if( texts.size() == m_ranges.size() )
+        {
+            insert( document, texts );
+        }
+    }
+
+    // Removes the selections, and for carets the character operation moves
+    // over; a caret never deletes into the range next to it.
+    void MultiCursor::deleteCharacters( QTextDocument* document, const QTextCursor::MoveOperation operation )
+    {
+        QTextCursor cursor( document );
+        bool joined = false;
+        int delta = 0;
+        int previousEnd = 0;
+        for( int i = 0; i < m_ranges.size(); ++i )
+        {
+            Range& range = m_ranges[i];
+            int start = MultiCursor::start( range ) + delta;
+            int end = MultiCursor::end( range ) + delta;
+            if( start == end )
+            {
+                cursor.setPosition( start );
+                cursor.movePosition( operation, QTextCursor::KeepAnchor );
+                start = qMax( qMin( cursor.anchor(), cursor.position() ), previousEnd );
+                end = qMax( cursor.anchor(), cursor.position() );
+                if( i + 1 < m_ranges.size() )
+                {
+                    end = qMin( end, MultiCursor::start( m_ranges.at( i + 1 ) ) + delta );
+                }
+                end = qMax( end, start );
+            }
+
+            if( start < end )
+            {
+                beginRangeEdit( cursor, joined );
+                cursor.setPosition( start );
+                cursor.setPosition( end, QTextCursor::KeepAnchor );
+                cursor.removeSelectedText();
+                cursor.endEditBlock();
+                delta -= end - start;
+            }
+            range.anchor = start;
+            range.position = start;
+            previousEnd = start;
+        }
+        normalize();
+    }
+
+    // Moves every range as QTextCursor::movePosition() would; a plain move
+    // left or right first collapses a selection to that side.
+    void MultiCursor::move(
+        const QTextDocument* document,
+        const QTextCursor::MoveOperation operation,
+        const QTextCursor::MoveMode mode )
+    {
+        QTextCursor cursor( const_cast<QTextDocument*>( document ) );
+        for( int i = 0; i < m_ranges.size(); ++i )
+        {
+            Range& range = m_ranges[i];
+            if( ( mode == QTextCursor::MoveAnchor ) && !isCaret( range ) &&
+                ( ( operation == QTextCursor::Left ) || ( operation == QTextCursor::Right ) ) )
+            {
+                const int position = ( operation == QTextCursor::Left ) ? start( range ) : end( range );
+                range.anchor = position;
+                range.position = position;
+                continue;
+            }
+
+            cursor.setPosition( range.anchor );
+            cursor.setPosition( range.position, QTextCursor::KeepAnchor );
+            cursor.movePosition( operation, mode );
+            range.anchor = cursor.anchor();
+            range.position = cursor.position();
+        }
+        normalize();
+    }
+
+    int MultiCursor::start( const Range& range )
+    {
+        return qMin( range.anchor, range.position );
+    }
+
+    int MultiCursor::end( const Range& range )
+    {
+        return qMax( range.anchor, range.position );
+    }
+
+    // A single text goes to every range, otherwise one text per range.
+    void MultiCursor::insert( QTextDocument* document, const QStringList& texts )
+    {
+        QTextCursor cursor( document );
+        bool joined = false;
+        int delta = 0;
+        for( int i = 0; i < m_ranges.size(); ++i )
+        {
+            Range& range = m_ranges[i];
+            const int start = MultiCursor::start( range ) + delta;
+            const int end = MultiCursor::end( range ) + delta;
+            const QString& text = texts.at( ( texts.size() == 1 ) ? 0 : i );
+            cursor.setPosition( start );
+            if( ( start < end ) || !text.isEmpty() )
+            {
+                beginRangeEdit( cursor, joined );
+                cursor.setPosition( end, QTextCursor::KeepAnchor );
+                cursor.insertText( text );
+                cursor.endEditBlock();
+            }
+            delta += cursor.position() - end;
+            range.anchor = cursor.position();
+            range.position = cursor.position();
+        }
+    }
+
+    // Sorts the ranges and merges those that overlap, share a start, or
+    // where a caret touches another range.
+    void MultiCursor::normalize( void )
+    {
+        std::sort( m_ranges.begin(), m_ranges.end(), lessRange );
+
+        int count = 0;
+        for( int i = 0; i < m_ranges.size(); ++i )
+        {
+            const Range range = m_ranges.at( i );
+            if( count > 0 )
+            {
+                Range& last = m_ranges[count - 1];
+                if( ( start( range ) < end( last ) ) ||
+                    ( start( range ) == start( last ) ) ||
+                    ( ( start( range ) == end( last ) ) && ( isCaret( range ) || isCaret( last ) ) ) )
+                {
+                    const int mergedStart = start( last );
+                    const int mergedEnd = qMax( end( last ), end( range ) );
+                    if( last.anchor <= last.position )
+                    {
+                        last.anchor = mergedStart;
+                        last.position = mergedEnd;
+                    }
+                    else
+                    {
+                        last.anchor = mergedEnd;
+                        last.position = mergedStart;
+                    }
+                    continue;
+                }
+            }
+            m_ranges[count++] = range;
+        }
+        m_ranges.resize( count );
+    }
+}
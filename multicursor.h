@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QVector>
+
+namespace mote
+{
+    // A set of carets and selections kept sorted by position and free of
+    // overlaps. An edit visits the ranges once in order, shifting each by
+    // what the edits before it inserted or removed, so N cursors cost one
+    // pass rather than N passes.
+    class MultiCursor
+    {
+    public:
+        struct Range
+        {
+            int anchor;
+            int position;
+        };
+
+    public:
+        MultiCursor( void );
+
+    public:
+        bool isEmpty( void )const;
+        int count( void )const;
+        void clear( void );
+        const QVector<Range>& ranges( void )const;
+        void setRanges( const QVector<Range>& ranges );
+        void add( const int anchor, const int position );
+        int lowerBound( const int position )const;
+
+        QString selectedText( const QTextDocument* document )const;
+        void insertText( QTextDocument* document, const QString& text );
+        void insertTexts( QTextDocument* document, const QStringList& texts );
+        void deleteCharacters( QTextDocument* document, const QTextCursor::MoveOperation operation );
+        void move(
+            const QTextDocument* document,
+            const QTextCursor::MoveOperation operation,
+            const QTextCursor::MoveMode mode );
+
+        static int start( const Range& range );
+        static int end( const Range& range );
+
+    private:
+        void insert( QTextDocument* document, const QStringList& texts );
+        void normalize( void );
+
+    private:
+        QVector<Range> m_ranges;
+    };
+}
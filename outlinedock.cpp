@@ -0,0 +1,466 @@
+#include "outlinedock.h"
+
+#include <QHash>
+#include <QTextBlock>
+
+#include <algorithm>
+#include <climits>
+#include <deque>
+
+#include "ctags.h"
+#include "documentsystem.h"
+#include "tagservice.h"
+#include "textdocument.h"
+#include "textedit.h"
+
+namespace mote
+{
+    struct OutlineDock::Node
+    {
+        QString name;
+        QString kind;
+        QString key;
+        int lineNumber;
+        Node* parent;
+        QList<Node*> children;
+    };
+
+    namespace
+    {
+        const int UpdateDelay = 500;
+        const int KeyRole = Qt::UserRole;
+        const int LineNumberRole = Qt::UserRole + 1;
+
+        bool isAncestor( const QTreeWidgetItem* ancestor, const QTreeWidgetItem* item )
+        {
+            for( item = item->parent(); item; item = item->parent() )
+            {
+                if( item == ancestor )
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        class LineOrder
+        {
+        public:
+            LineOrder( const QVector<int>& lines )
+                : m_lines( lines )
+            {
+            }
+
+            bool operator()( int index1, int index2 )const
+            {
+                return m_lines.at( index1 ) < m_lines.at( index2 );
+            }
+
+        private:
+            const QVector<int>& m_lines;
+        };
+    }
+
+    OutlineDock::OutlineDock( DocumentSystem* documentSystem, QWidget* parent )
+        : QDockWidget( tr( "Outline" ), parent ),
+          m_documentSystem( documentSystem )
+    {
+        setObjectName( "moteOutlineDock" );
+
+        m_tree = new QTreeWidget;
+        m_tree->setHeaderHidden( true );
+        m_tree->setUniformRowHeights( true );
+        setWidget( m_tree );
+
+        m_updateTimer.setSingleShot( true );
+        m_updateTimer.setInterval( UpdateDelay );
+
+        connect( &m_updateTimer, SIGNAL( timeout() ), SLOT( requestTags( void ) ) );
+        connect(
+            documentSystem->tagService(), SIGNAL( tagsUpdated( TextDocument* ) ),
+            SLOT( onTagsUpdated( TextDocument* ) ) );
+        connect(
+            this, SIGNAL( visibilityChanged( bool ) ),
+            SLOT( onVisibilityChanged( bool ) ) );
+        connect(
+            m_tree, SIGNAL( itemActivated( QTreeWidgetItem*, int ) ),
+            SLOT( onItemActivated( QTreeWidgetItem* ) ) );
+    }
+
+    void OutlineDock::setTextEdit( TextEdit* textEdit )
+    {
+        if( textEdit == m_textEdit )
+        {
+            return;
+        }
+
+        if( m_textEdit )
+        {
+            disconnect( m_textEdit, NULL, this, NULL );
+            disconnect( m_textEdit->document(), NULL, this, NULL );
+        }
+
+        m_textEdit = textEdit;
+        m_updateTimer.stop();
+
+        if( !m_textEdit )
+        {
+            m_tree->clear();
+            m_ranges.clear();
+            return;
+        }
+
+        connect(
+            m_textEdit->document(), SIGNAL( contentsChanged() ),
+            SLOT( onContentsChanged( void ) ) );
+        connect(
+            m_textEdit, SIGNAL( cursorPositionChanged() ),
+            SLOT( highlightCurrentSymbol( void ) ) );
+
+        // Show what is cached at once, even if it is a little old.
+        TextDocument* textDocument = qobject_cast<TextDocument*>( m_textEdit->document() );
+        const CTags* ctags = m_documentSystem->tagService()->tags( textDocument );
+        if( ctags )
+        {
+            updateTree( *ctags );
+        }
+        else
+        {
+            m_tree->clear();
+            m_ranges.clear();
+        }
+
+        requestTags();
+    }
+
+    void OutlineDock::updateTree( const CTags& ctags )
+    {
+        const int count = ctags.count();
+
+        // Scopes missing from the tags (e.g. the class of out-of-line
+        // member definitions) get a node of their own. A deque never moves
+        // its elements when appended to, so the Node pointers stay valid.
+        std::deque<Node> nodes;
+        QHash<QString, Node*> qualifiedNames;
+        QVector<Node*> entries( count );
+        QStringList scopes;
+        for( int i = 0; i < count; ++i )
+        {
+            const QString name = ctags.tagName( i );
+            const QString kind = ctags.kind( i );
+            const QString scope = ctags.scope( i );
+
+            nodes.push_back( Node() );
+            Node* node = &nodes.back();
+            node->name = name;
+            node->kind = kind;
+            node->key = kind + '\t' + name;
+            node->lineNumber = ctags.lineNumber( i );
+            node->parent = NULL;
+            entries[i] = node;
+            scopes += scope;
+
+            const QString qualifiedName = scope.isEmpty() ? name : ( scope + "::" + name );
+            if( !qualifiedNames.contains( qualifiedName ) )
+            {
+                qualifiedNames.insert( qualifiedName, node );
+            }
+        }
+
+        QList<Node*> roots;
+        for( int i = 0; i < count; ++i )
+        {
+            Node* node = entries.at( i );
+            const QString& scope = scopes.at( i );
+            if( scope.isEmpty() )
+            {
+                roots += node;
+                continue;
+            }
+
+            Node* parent = qualifiedNames.value( scope );
+            if( !parent )
+            {
+                // Scopes from namespaces are not reported; try the last part.
+                const int separator = scope.lastIndexOf( "::" );
+                if( separator >= 0 )
+                {
+                    parent = qualifiedNames.value( scope.mid( separator + 2 ) );
+                }
+            }
+            if( !parent )
+            {
+                nodes.push_back( Node() );
+                parent = &nodes.back();
+                parent->name = scope;
+                parent->key = QString( '\t' ) + scope;
+                parent->lineNumber = node->lineNumber;
+                parent->parent = NULL;
+                qualifiedNames.insert( scope, parent );
+                roots += parent;
+            }
+
+            bool cyclic = false;
+            for( const Node* ancestor = parent; ancestor; ancestor = ancestor->parent )
+            {
+                if( ancestor == node )
+                {
+                    cyclic = true;
+                    break;
+                }
+            }
+            if( cyclic )
+            {
+                roots += node;
+                continue;
+            }
+
+            node->parent = parent;
+            parent->children += node;
+        }
+
+        updateChildren( m_tree->invisibleRootItem(), roots );
+
+        // Symbol ranges ordered by start line; a symbol ends where the next
+        // one that is not nested in it starts.
+        m_ranges.clear();
+        collectRanges( m_tree->invisibleRootItem(), -1 );
+
+        QVector<int> order( m_ranges.size() );
+        for( int i = 0; i < order.size(); ++i )
+        {
+            order[i] = i;
+        }
+        QVector<int> startLines( m_ranges.size() );
+        for( int i = 0; i < m_ranges.size(); ++i )
+        {
+            startLines[i] = m_ranges.at( i ).startLine;
+        }
+        std::stable_sort( order.begin(), order.end(), LineOrder( startLines ) );
+
+        QVector<int> position( order.size() );
+        QVector<SymbolRange> ranges( order.size() );
+        for( int i = 0; i < order.size(); ++i )
+        {
+            position[order.at( i )] = i;
+        }
+        for( int i = 0; i < order.size(); ++i )
+        {
+            SymbolRange range = m_ranges.at( order.at( i ) );
+            if( range.parent >= 0 )
+            {
+                range.parent = position.at( range.parent );
+            }
+            range.endLine = INT_MAX;
+            ranges[i] = range;
+        }
+
+        QVector<int> stack;
+        for( int i = 0; i < ranges.size(); ++i )
+        {
+            while( !stack.isEmpty() && !isAncestor( ranges.at( stack.last() ).item, ranges.at( i ).item ) )
+            {
+                SymbolRange& range = ranges[stack.last()];
+                range.endLine = qMax( range.startLine, ranges.at( i ).startLine - 1 );
+                stack.pop_back();
+            }
+            stack += i;
+        }
+        m_ranges = ranges;
+
+        highlightCurrentSymbol();
+    }
+
+    void OutlineDock::updateChildren( QTreeWidgetItem* parent, const QList<Node*>& nodes )
+    {
+        // Reuse the items of symbols that are still there, so that the
+        // expansion and scroll state survive the refresh.
+        QHash<QString, QList<QTreeWidgetItem*> > existing;
+        for( int i = 0; i < parent->childCount(); ++i )
+        {
+            QTreeWidgetItem* item = parent->child( i );
+            existing[item->data( 0, KeyRole ).toString()] += item;
+        }
+
+        for( int i = 0; i < nodes.size(); ++i )
+        {
+            const Node* node = nodes.at( i );
+
+            QTreeWidgetItem* item = NULL;
+            QHash<QString, QList<QTreeWidgetItem*> >::iterator itr = existing.find( node->key );
+            if( ( itr != existing.end() ) && !itr->isEmpty() )
+            {
+                item = itr->takeFirst();
+                const int index = parent->indexOfChild( item );
+                if( index != i )
+                {
+                    parent->takeChild( index );
+                    parent->insertChild( i, item );
+                }
+            }
+            else
+            {
+                item = new QTreeWidgetItem;
+                item->setText( 0, node->name );
+                item->setData( 0, KeyRole, node->key );
+                parent->insertChild( i, item );
+                item->setExpanded( true );
+            }
+
+            if( item->data( 0, LineNumberRole ).toInt() != node->lineNumber )
+            {
+                item->setData( 0, LineNumberRole, node->lineNumber );
+                item->setToolTip(
+                    0,
+                    node->kind.isEmpty() ?
+                    node->name :
+                    QString( "%1 (%2) : %3" ).arg( node->name ).arg( node->kind ).arg( node->lineNumber ) );
+            }
+
+            updateChildren( item, node->children );
+        }
+
+        while( parent->childCount() > nodes.size() )
+        {
+            delete parent->takeChild( nodes.size() );
+        }
+    }
+
+    void OutlineDock::collectRanges( QTreeWidgetItem* item, int parent )
+    {
+        for( int i = 0; i < item->childCount(); ++i )
+        {
+            QTreeWidgetItem* child = item->child( i );
+
+            SymbolRange range;
+            range.startLine = child->data( 0, LineNumberRole ).toInt();
+            range.endLine = INT_MAX;
+            range.parent = parent;
+            range.item = child;
+            m_ranges += range;
+
+            collectRanges( child, m_ranges.size() - 1 );
+        }
+    }
+
+    void OutlineDock::requestTags( void )
+    {
+        if( !m_textEdit || !isVisible() )
+        {
+            return;
+        }
+
+        TextDocument* textDocument = qobject_cast<TextDocument*>( m_textEdit->document() );
+        TagService* tagService = m_documentSystem->tagService();
+        if( tagService->requestTags( textDocument ) )
+        {
+            updateTree( *tagService->tags( textDocument ) );
+        }
+    }
+
+    void OutlineDock::onContentsChanged( void )
+    {
+        m_updateTimer.start();
+    }
+
+    void OutlineDock::onTagsUpdated( TextDocument* textDocument )
+    {
+        if( !m_textEdit || ( m_textEdit->document() != textDocument ) )
+        {
+            return;
+        }
+
+        const CTags* ctags = m_documentSystem->tagService()->tags( textDocument );
+        if( ctags )
+        {
+            updateTree( *ctags );
+        }
+    }
+
+    void OutlineDock::onVisibilityChanged( bool visible )
+    {
+        if( visible )
+        {
+            requestTags();
+        }
+    }
+
+    void OutlineDock::onItemActivated( QTreeWidgetItem* item )
+    {
+        if( !m_textEdit || !item )
+        {
+            return;
+        }
+
+        const TextDocument* textDocument = qobject_cast<TextDocument*>( m_textEdit->document() );
+        if( !textDocument )
+        {
+            return;
+        }
+
+        const QTextBlock block =
+            textDocument->findBlockByLineNumber( item->data( 0, LineNumberRole ).toInt() - 1 );
+        if( block.isValid() )
+        {
+            QTextCursor textCursor = m_textEdit->textCursor();
+            textCursor.setPosition( block.position() );
+            m_textEdit->setTextCursor( textCursor );
+            m_textEdit->centerCursor();
+            m_textEdit->setFocus();
+        }
+    }
+
+    void OutlineDock::highlightCurrentSymbol( void )
+    {
+        if( !m_textEdit || m_ranges.isEmpty() )
+        {
+            return;
+        }
+
+        const TextDocument* textDocument = qobject_cast<TextDocument*>( m_textEdit->document() );
+        if( !textDocument )
+        {
+            return;
+        }
+
+        const int line = textDocument->lineNumber( m_textEdit->textCursor().block() ) + 1;
+
+        // Last symbol starting at or before the line, then out through its
+        // parents until one of them contains the line.
+        int first = 0;
+        int count = m_ranges.size();
+        while( count > 0 )
+        {
+            const int step = count / 2;
+            if( m_ranges.at( first + step ).startLine <= line )
+            {
+                first += step + 1;
+                count -= step + 1;
+            }
+            else
+            {
+                count = step;
+            }
+        }
+
+        int index = first - 1;
+        while( ( index >= 0 ) && ( m_ranges.at( index ).endLine < line ) )
+        {
+            index = m_ranges.at( index ).parent;
+        }
+
+        if( index >= 0 )
+        {
+            QTreeWidgetItem* item = m_ranges.at( index ).item;
+            if( m_tree->currentItem() != item )
+            {
+                m_tree->setCurrentItem( item );
+                m_tree->scrollToItem( item );
+            }
+        }
+        else
+        {
+            m_tree->clearSelection();
+        }
+    }
+}
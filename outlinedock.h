@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QDockWidget>
+#include <QPointer>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVector>
+
+namespace mote
+{
+    class CTags;
+    class DocumentSystem;
+    class TextDocument;
+    class TextEdit;
+
+    class OutlineDock : public QDockWidget
+    {
+        Q_OBJECT
+
+    public:
+        OutlineDock( DocumentSystem* documentSystem, QWidget* parent = 0 );
+
+    public:
+        void setTextEdit( TextEdit* textEdit );
+
+    private:
+        struct Node;
+        struct SymbolRange
+        {
+            int startLine;
+            int endLine;
+            int parent;
+            QTreeWidgetItem* item;
+        };
+
+        void updateTree( const CTags& ctags );
+        void updateChildren( QTreeWidgetItem* parent, const QList<Node*>& nodes );
+        void collectRanges( QTreeWidgetItem* item, int parent );
+
+    private slots:
+        void requestTags( void );
+        void onContentsChanged( void );
+        void onTagsUpdated( TextDocument* textDocument );
+        void onVisibilityChanged( bool visible );
+        void onItemActivated( QTreeWidgetItem* item );
+        void highlightCurrentSymbol( void );
+
+    private:
+        DocumentSystem* m_documentSystem;
+        QPointer<TextEdit> m_textEdit;
+        QTreeWidget* m_tree;
+        QTimer m_updateTimer;
+        QVector<SymbolRange> m_ranges;
+    };
+}
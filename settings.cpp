@@ -90,6 +90,73 @@ namespace mote
         }
     }
 
+    QString Settings::projectDirectory( void )const
+    {
+        return value( "projectDirectory" ).toString();
+    }
+
+    bool Settings::formatOnSave( void )const
+    {
+        const QVariant formatOnSave = value( "formatOnSave" );
+        if( formatOnSave.isValid() )
+        {
+            return formatOnSave.toBool();
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    bool Settings::completeProjectSymbols( void )const
+    {
+        const QVariant completeProjectSymbols = value( "completeProjectSymbols" );
+        if( completeProjectSymbols.isValid() )
+        {
+            return completeProjectSymbols.toBool();
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    LineSorter::Key Settings::sortLinesKey( void )const
+    {
+        const QVariant sortLinesKey = value( "sortLinesKey" );
+        if( sortLinesKey.isValid() )
+        {
+            return ( LineSorter::Key )sortLinesKey.toInt();
+        }
+        else
+        {
+            return LineSorter::Options().key;
+        }
+    }
+
+    bool Settings::sortLinesDescending( void )const
+    {
+        const QVariant sortLinesDescending = value( "sortLinesDescending" );
+        if( sortLinesDescending.isValid() )
+        {
+            return sortLinesDescending.toBool();
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    int Settings::sortLinesColumn( void )const
+    {
+        return value( "sortLinesColumn" ).toInt();
+    }
+
+    QString Settings::sortLinesRegularExpression( void )const
+    {
+        return value( "sortLinesRegularExpression" ).toString();
+    }
+
     void Settings::setLineNumberVisible( bool onoff )
     {
         const bool prevOnoff = isLineNumberVisible();
@@ -126,4 +193,70 @@ namespace mote
     {
         setValue( "findHighlightAllOccurrences", onoff );
     }
+
+    void Settings::setProjectDirectory( const QString& path )
+    {
+        if( path != projectDirectory() )
+        {
+            setValue( "projectDirectory", path );
+            emit projectDirectoryChanged( path );
+        }
+    }
+
+    void Settings::setFormatOnSave( bool onoff )
+    {
+        const bool prevOnoff = formatOnSave();
+        if( ( prevOnoff && !onoff ) || ( !prevOnoff && onoff ) )
+        {
+            setValue( "formatOnSave", onoff );
+            emit formatOnSaveChanged( onoff );
+        }
+    }
+
+    void Settings::setCompleteProjectSymbols( bool onoff )
+    {
+        const bool prevOnoff = completeProjectSymbols();
+        if( ( prevOnoff && !onoff ) || ( !prevOnoff && onoff ) )
+        {
+            setValue( "completeProjectSymbols", onoff );
+            emit completeProjectSymbolsChanged( onoff );
+        }
+    }
+
+    void Settings::setSortLinesKey( LineSorter::Key key )
+    {
+        if( key != sortLinesKey() )
+        {
+            setValue( "sortLinesKey", ( int )key );
+            emit sortLinesKeyChanged( key );
+        }
+    }
+
+    void Settings::setSortLinesDescending( bool onoff )
+    {
+        const bool prevOnoff = sortLinesDescending();
+        if( ( prevOnoff && !onoff ) || ( !prevOnoff && onoff ) )
+        {
+            setValue( "sortLinesDescending", onoff );
+            emit sortLinesDescendingChanged( onoff );
+        }
+    }
+
+    void Settings::setSortLinesColumn( int column )
+    {
+        if( column != sortLinesColumn() )
+        {
+            setValue( "sortLinesColumn", column );
+            emit sortLinesColumnChanged( column );
+        }
+    }
+
+    void Settings::setSortLinesRegularExpression( const QString& pattern )
+    {
+        if( pattern != sortLinesRegularExpression() )
+        {
+            setValue( "sortLinesRegularExpression", pattern );
+            emit sortLinesRegularExpressionChanged( pattern );
+        }
+    }
 }
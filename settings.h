@@ -3,6 +3,8 @@
 #include <QFont>
 #include <QSettings>
 
+#include "linesorter.h"
+
 namespace mote
 {
     class Settings : public QSettings
@@ -19,6 +21,13 @@ namespace mote
         bool findWholeWords( void )const;
         bool isFindRegularExpressionEnabled( void )const;
         bool findHighlightAllOccurrences( void )const;
+        QString projectDirectory( void )const;
+        bool formatOnSave( void )const;
+        bool completeProjectSymbols( void )const;
+        LineSorter::Key sortLinesKey( void )const;
+        bool sortLinesDescending( void )const;
+        int sortLinesColumn( void )const;
+        QString sortLinesRegularExpression( void )const;
 
     public slots:
         void setLineNumberVisible( bool onoff );
@@ -27,9 +36,23 @@ namespace mote
         void setFindWholeWords( const bool onoff );
         void setFindRegularExpressionEnabled( const bool onoff );
         void setFindHighlightAllOccurrences( const bool onoff );
+        void setProjectDirectory( const QString& path );
+        void setFormatOnSave( bool onoff );
+        void setCompleteProjectSymbols( bool onoff );
+        void setSortLinesKey( LineSorter::Key key );
+        void setSortLinesDescending( bool onoff );
+        void setSortLinesColumn( int column );
+        void setSortLinesRegularExpression( const QString& pattern );
 
     signals:
         void lineNumberVisibilityChanged( bool onoff );
         void fontChanged( const QFont& font );
+        void projectDirectoryChanged( const QString& path );
+        void formatOnSaveChanged( bool onoff );
+        void completeProjectSymbolsChanged( bool onoff );
+        void sortLinesKeyChanged( LineSorter::Key key );
+        void sortLinesDescendingChanged( bool onoff );
+        void sortLinesColumnChanged( int column );
+        void sortLinesRegularExpressionChanged( const QString& pattern );
     };
 }
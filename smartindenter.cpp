@@ -0,0 +1,218 @@
+#include "smartindenter.h"
+
+#include "blockdata.h"
+#include "textdocument.h"
+
+namespace mote
+{
+    namespace
+    {
+        int leadingLength( const QString& text )
+        {
+            int length = 0;
+            while( ( length < text.length() ) &&
+                   ( ( text.at( length ) == ' ' ) || ( text.at( length ) == '\t' ) ) )
+            {
+                ++length;
+            }
+            return length;
+        }
+
+        // The first character other than a space or a tab.
+        QChar firstCharacter( const QString& text )
+        {
+            const int length = leadingLength( text );
+            return ( length < text.length() ) ? text.at( length ) : QChar();
+        }
+    }
+
+    SmartIndenter::SmartIndenter( const TextDocument* document, const int indentWidth )
+        : m_document( document ),
+          m_indentWidth( indentWidth ),
+          m_firstOverride( 0 )
+    {
+    }
+
+    // Whether the highlighter has described block, i.e. whether its
+    // document is C++.
+    bool SmartIndenter::isAvailable( const QTextBlock& block )
+    {
+        const BlockData* data = BlockData::find( block );
+        return data && data->syntax().valid;
+    }
+
+    // The leading whitespace block should have after the blocks before it.
+    QString SmartIndenter::indentation( const QTextBlock& block )const
+    {
+        QTextBlock previous = block.previous();
+        if( !previous.isValid() )
+        {
+            return QString();
+        }
+        if( !isAvailable( previous ) )
+        {
+            return leadingText( previous );
+        }
+
+        const BlockData* data = BlockData::find( previous );
+        if( data->syntax().endsInComment )
+        {
+            const QString text = previous.text().trimmed();
+            if( text.startsWith( "/*" ) )
+            {
+                return leadingText( previous ) + " * ";
+            }
+            else if( text.startsWith( "*" ) )
+            {
+                return leadingText( previous ) + "* ";
+            }
+            return leadingText( previous );
+        }
+
+        // Blank lines say nothing about nesting.
+        previous = m_document->lastNonBlankBlock( previous );
+        if( !previous.isValid() )
+        {
+            return QString();
+        }
+        data = BlockData::find( previous );
+
+        const QVector<BlockData::Paren> parens = m_document->openParens( previous );
+        if( !parens.isEmpty() )
+        {
+            const BlockData::Paren& paren = parens.last();
+            const QTextBlock parenBlock = m_document->findBlockByNumber( paren.blockNumber );
+            if( paren.column < 0 )
+            {
+                return leadingText( parenBlock ) + QString( m_indentWidth, ' ' );
+            }
+            return QString( visualColumn( parenBlock, paren.column ), ' ' );
+        }
+
+        // A statement running over several lines counts from its first.
+        const QVector<BlockData::Paren> startParens = m_document->openParens( previous.previous() );
+        QString indent =
+            leadingText(
+                startParens.isEmpty() ? previous : m_document->findBlockByNumber( startParens.first().blockNumber ) );
+
+        if( data && data->syntax().valid &&
+            ( data->syntax().braceDelta + data->syntax().leadingCloseCount > 0 ) )
+        {
+            indent += QString( m_indentWidth, ' ' );
+        }
+        if( firstCharacter( block.text() ) == '}' )
+        {
+            indent = dedent( indent );
+        }
+        return indent;
+    }
+
+    // The lines from first to last with their indentation redone, joined
+    // as TextDocument::text() joins them. Each line is indented after the
+    // new text of the ones before it. Lines inside block comments,
+    // preprocessor lines and the continuation blocks of long lines are
+    // left as they are.
+    QString SmartIndenter::reindent( const QTextBlock& first, const QTextBlock& last )
+    {
+        m_firstOverride = first.blockNumber();
+        m_overrides.clear();
+
+        QString result;
+        for( QTextBlock block = first; block.isValid(); block = block.next() )
+        {
+            const QString text = block.text();
+            if( ( block != first ) && TextDocument::isContinuation( block ) )
+            {
+                m_overrides += QString();
+                result += text;
+                if( block == last )
+                {
+                    break;
+                }
+                continue;
+            }
+
+            const int length = leadingLength( text );
+
+            const BlockData* previousData = BlockData::find( block.previous() );
+            QString indent;
+            if( ( previousData && previousData->syntax().endsInComment ) || ( firstCharacter( text ) == '#' ) )
+            {
+                indent = text.left( length );
+            }
+            else if( length < text.length() )
+            {
+                indent = indentation( block );
+            }
+            m_overrides += indent;
+
+            if( block != first )
+            {
+                result += '\n';
+            }
+            result += indent;
+            result.append( text.constData() + length, text.length() - length );
+
+            if( block == last )
+            {
+                break;
+            }
+        }
+
+        m_overrides.clear();
+        return result;
+    }
+
+    // The indentation of the line block belongs to.
+    QString SmartIndenter::leadingText( QTextBlock block )const
+    {
+        while( TextDocument::isContinuation( block ) )
+        {
+            block = block.previous();
+        }
+
+        const int index = block.blockNumber() - m_firstOverride;
+        if( ( index >= 0 ) && ( index < m_overrides.size() ) )
+        {
+            return m_overrides.at( index );
+        }
+
+        const QString text = block.text();
+        return text.left( leadingLength( text ) );
+    }
+
+    // The display column of column in block, tabs expanded, after any new
+    // indentation given to block.
+    int SmartIndenter::visualColumn( const QTextBlock& block, const int column )const
+    {
+        const QString text = block.text();
+        const QString indent = leadingText( block );
+        const int length = leadingLength( text );
+
+        int width = 0;
+        for( int i = 0; i < indent.length(); ++i )
+        {
+            width = ( indent.at( i ) == '\t' ) ? ( width / m_indentWidth + 1 ) * m_indentWidth : width + 1;
+        }
+        for( int i = length; ( i < column ) && ( i < text.length() ); ++i )
+        {
+            width = ( text.at( i ) == '\t' ) ? ( width / m_indentWidth + 1 ) * m_indentWidth : width + 1;
+        }
+        return width;
+    }
+
+    QString SmartIndenter::dedent( const QString& indent )const
+    {
+        if( indent.endsWith( '\t' ) )
+        {
+            return indent.left( indent.length() - 1 );
+        }
+
+        int length = indent.length();
+        while( ( length > 0 ) && ( indent.length() - length < m_indentWidth ) && ( indent.at( length - 1 ) == ' ' ) )
+        {
+            --length;
+        }
+        return indent.left( length );
+    }
+}
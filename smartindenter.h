@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QString>
+#include <QTextBlock>
+#include <QVector>
+
+namespace mote
+{
+    class TextDocument;
+
+    // C++ indentation from what the highlighter recorded of each block: a
+    // level more after an opening brace, a level less for a line starting
+    // with a closing one, alignment inside open parentheses and star
+    // continuation inside block comments. Nothing before the previous
+    // line is read again. Blocks the highlighter has not seen keep the
+    // indentation of the line before.
+    class SmartIndenter
+    {
+    public:
+        SmartIndenter( const TextDocument* document, const int indentWidth );
+
+    public:
+        static bool isAvailable( const QTextBlock& block );
+
+        QString indentation( const QTextBlock& block )const;
+        QString reindent( const QTextBlock& first, const QTextBlock& last );
+
+    private:
+        QString leadingText( QTextBlock block )const;
+        int visualColumn( const QTextBlock& block, const int column )const;
+        QString dedent( const QString& indent )const;
+
+    private:
+        const TextDocument* m_document;
+        int m_indentWidth;
+        int m_firstOverride;
+        QVector<QString> m_overrides;
+    };
+}
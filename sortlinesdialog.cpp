@@ -0,0 +1,104 @@
+#include "sortlinesdialog.h"
+
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QMessageBox>
+#include <QVBoxLayout>
+
+#include "settings.h"
+
+namespace mote
+{
+    SortLinesDialog::SortLinesDialog( QWidget* parent )
+        : QDialog( parent )
+    {
+        setWindowTitle( tr( "Sort Lines" ) );
+
+        m_keyComboBox = new QComboBox;
+        m_keyComboBox->addItem( tr( "Lexical" ), LineSorter::Lexical );
+        m_keyComboBox->addItem( tr( "Case insensitive" ), LineSorter::CaseInsensitive );
+        m_keyComboBox->addItem( tr( "Numeric" ), LineSorter::Numeric );
+        m_keyComboBox->addItem( tr( "Natural" ), LineSorter::Natural );
+        m_keyComboBox->addItem( tr( "Locale" ), LineSorter::LocaleAware );
+
+        m_descending = new QCheckBox( tr( "Descending" ) );
+
+        m_columnSpinBox = new QSpinBox;
+        m_columnSpinBox->setRange( 1, 99999 );
+
+        m_regularExpressionEdit = new QLineEdit;
+        m_regularExpressionEdit->setPlaceholderText( tr( "Sort by the first capture group" ) );
+
+        QDialogButtonBox* buttonBox =
+            new QDialogButtonBox( QDialogButtonBox::Ok | QDialogButtonBox::Cancel );
+
+        connect( buttonBox, SIGNAL( accepted() ), SLOT( accept() ) );
+        connect( buttonBox, SIGNAL( rejected() ), SLOT( reject() ) );
+
+        QFormLayout* formLayout = new QFormLayout;
+        formLayout->setFieldGrowthPolicy( QFormLayout::AllNonFixedFieldsGrow );
+        formLayout->addRow( tr( "Key:" ), m_keyComboBox );
+        formLayout->addRow( tr( "Column:" ), m_columnSpinBox );
+        formLayout->addRow( tr( "Regular expression:" ), m_regularExpressionEdit );
+
+        QVBoxLayout* layout = new QVBoxLayout;
+        layout->addLayout( formLayout );
+        layout->addWidget( m_descending );
+        layout->addStretch();
+        layout->addWidget( buttonBox );
+        setLayout( layout );
+    }
+
+    void SortLinesDialog::accept()
+    {
+        const QRegularExpression regExp( m_regularExpressionEdit->text() );
+        if( !regExp.isValid() )
+        {
+            QMessageBox::warning(
+                this,
+                windowTitle(),
+                tr( "Invalid regular expression: %1" ).arg( regExp.errorString() ) );
+            return;
+        }
+
+        QDialog::accept();
+    }
+
+    LineSorter::Options SortLinesDialog::options( void )const
+    {
+        LineSorter::Options options;
+        options.key = ( LineSorter::Key )m_keyComboBox->itemData( m_keyComboBox->currentIndex() ).toInt();
+        options.descending = m_descending->isChecked();
+        options.column = m_columnSpinBox->value() - 1;
+        options.regularExpression.setPattern( m_regularExpressionEdit->text() );
+        return options;
+    }
+
+    void SortLinesDialog::setOptions( const LineSorter::Options& options )
+    {
+        const int index = m_keyComboBox->findData( options.key );
+        m_keyComboBox->setCurrentIndex( ( index >= 0 ) ? index : 0 );
+        m_descending->setChecked( options.descending );
+        m_columnSpinBox->setValue( options.column + 1 );
+        m_regularExpressionEdit->setText( options.regularExpression.pattern() );
+    }
+
+    void SortLinesDialog::saveOptions( Settings* settings )const
+    {
+        const LineSorter::Options options = this->options();
+        settings->setSortLinesKey( options.key );
+        settings->setSortLinesDescending( options.descending );
+        settings->setSortLinesColumn( options.column );
+        settings->setSortLinesRegularExpression( options.regularExpression.pattern() );
+    }
+
+    void SortLinesDialog::restoreOptions( Settings* settings )
+    {
+        LineSorter::Options options;
+        options.key = settings->sortLinesKey();
+        options.descending = settings->sortLinesDescending();
+        options.column = settings->sortLinesColumn();
+        options.regularExpression.setPattern( settings->sortLinesRegularExpression() );
+        setOptions( options );
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDialog>
+#include <QLineEdit>
+#include <QSpinBox>
+
+#include "linesorter.h"
+
+namespace mote
+{
+    class Settings;
+
+    class SortLinesDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        SortLinesDialog( QWidget* parent = 0 );
+
+    public:
+        virtual void accept();
+
+    public:
+        LineSorter::Options options( void )const;
+        void setOptions( const LineSorter::Options& options );
+
+        void saveOptions( Settings* settings )const;
+        void restoreOptions( Settings* settings );
+
+    private:
+        QComboBox* m_keyComboBox;
+        QCheckBox* m_descending;
+        QSpinBox* m_columnSpinBox;
+        QLineEdit* m_regularExpressionEdit;
+    };
+}
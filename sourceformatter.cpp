@@ -0,0 +1,234 @@
+#include "sourceformatter.h"
+
+#include <QCoreApplication>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+
+#include "linediff.h"
+
+#ifdef Q_OS_WIN
+#define STDCALL __stdcall
+#else
+#define STDCALL
+#endif
+
+extern "C"
+{
+    char* STDCALL AStyleMain(
+        const char* textIn,
+        const char* options,
+        void( STDCALL *errorHandler )( int, char* ),
+        char*( STDCALL *memoryAlloc )( unsigned long ) );
+
+}
+
+namespace mote
+{
+    // Artistic Style keeps static tables that it sets up and reads without
+    // locking, so AStyleMain is not reentrant. Calls are serialised; the
+    // error messages its plain callback receives belong to the call
+    // holding the lock.
+    Q_GLOBAL_STATIC( QMutex, astyleMutex )
+    Q_GLOBAL_STATIC( QString, errorMessages )
+
+    static void STDCALL errorHandler( int /*errorNumber*/, char* errorMessage )
+    {
+        QString& messages = *errorMessages();
+        if( !messages.isEmpty() )
+        {
+            messages += '\n';
+        }
+        messages += QString::fromLocal8Bit( errorMessage );
+    }
+
+    static char* STDCALL memoryAlloc( unsigned long memoryNeeded )
+    {
+        return new char[memoryNeeded];
+    }
+
+    static int calcIndent( const int tab_num, const QString& text )
+    {
+        if( tab_num == 0 )
+        {
+            return 0;
+        }
+
+        int column = 0;
+        for( int i = 0; i < text.length() ; ++i )
+        {
+            const QChar ch = text[i];
+            if ( ch == ' ' )
+            {
+                ++column;
+            }
+            else if ( ch == '\t' )
+            {
+                column = ( ( column / tab_num ) + 1 ) * tab_num;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        return column / tab_num;
+    }
+
+    SourceFormatter::SourceFormatter( const int indentWidth )
+        : m_indentWidth( indentWidth ),
+          m_options( defaultOptions( indentWidth ).toUtf8() )
+    {
+    }
+
+    // AStyleMain takes the options as text on every call and there is no
+    // way to hand it pre-parsed ones; the encoded string is built once and
+    // shared by all copies instead.
+    SourceFormatter::SourceFormatter( const QString& options, const int indentWidth )
+        : m_indentWidth( indentWidth ),
+          m_options( options.toUtf8() )
+    {
+    }
+
+    int SourceFormatter::indentWidth( void )const
+    {
+        return m_indentWidth;
+    }
+
+    QByteArray SourceFormatter::options( void )const
+    {
+        return m_options;
+    }
+
+    bool SourceFormatter::format( const QString& text, QString& formattedText )const
+    {
+        QByteArray textOut;
+        if( !format( text.toUtf8(), textOut ) )
+        {
+            return false;
+        }
+        formattedText = QString::fromUtf8( textOut );
+
+        // A selection from the middle of a file keeps its indentation.
+        const int indent = calcIndent( m_indentWidth, text );
+        if( indent > 0 )
+        {
+            const QStringList lines = formattedText.split( '\n' );
+            formattedText.clear();
+            for( int i = 0; i < lines.size(); ++i )
+            {
+                const QString& line = lines.at( i );
+                if( !line.isEmpty() )
+                {
+                    formattedText += QString( indent * m_indentWidth, ' ' );
+                    formattedText += line;
+                }
+                if( i < lines.size() - 1 )
+                {
+                    formattedText += '\n';
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool SourceFormatter::format(
+        const QByteArray& text,
+        QByteArray& formattedText,
+        QString* errorMessage )const
+    {
+        // AStyleMain reads a C string and would stop at the first NUL,
+        // returning the text up to it as if it were all.
+        if( text.contains( '\0' ) )
+        {
+            if( errorMessage )
+            {
+                *errorMessage =
+                    QCoreApplication::translate( "SourceFormatter", "Contains a NUL character; not formatted." );
+            }
+            return false;
+        }
+
+        QMutexLocker locker( astyleMutex() );
+        QString& messages = *errorMessages();
+        messages.clear();
+
+        char* textOut = AStyleMain(
+                            text.constData(),
+                            m_options.constData(),
+                            errorHandler,
+                            memoryAlloc );
+        if( errorMessage )
+        {
+            *errorMessage = messages;
+        }
+        if( !textOut )
+        {
+            return false;
+        }
+        formattedText = QByteArray( textOut );
+        delete[] textOut;
+        textOut = NULL;
+
+        return messages.isEmpty();
+    }
+
+    SourceFormatter::Result SourceFormatter::formatEdits( const QString& text )const
+    {
+        Result result;
+
+        QString formattedText;
+        if( format( text, formattedText ) )
+        {
+            result.edits = diff( text, formattedText );
+            result.ok = true;
+        }
+
+        return result;
+    }
+
+    QString SourceFormatter::defaultOptions( const int indentWidth )
+    {
+        QString option = "mode=c indent-namespaces pad-oper pad-paren-in convert-tabs style=break indent-cases min-conditional-indent=0 max-instatement-indent=70";
+        option += QString( " indent=spaces=%1" ).arg( indentWidth );
+        return option;
+    }
+
+    QVector<SourceFormatter::Edit> SourceFormatter::diff( const QString& oldText, const QString& newText )
+    {
+        const QStringList oldLines = LineDiff::splitLines( oldText );
+        const QStringList newLines = LineDiff::splitLines( newText );
+        const QVector<LineDiff::Hunk> hunks = LineDiff().exec( oldLines, newLines );
+
+        QVector<Edit> edits;
+        edits.reserve( hunks.size() );
+
+        int position = 0;
+        int line = 0;
+        for( int i = 0; i < hunks.size(); ++i )
+        {
+            const LineDiff::Hunk& hunk = hunks.at( i );
+            for( ; line < hunk.oldStart; ++line )
+            {
+                position += oldLines.at( line ).size();
+            }
+
+            Edit edit;
+            edit.position = position;
+            edit.length = 0;
+            for( ; line < hunk.oldStart + hunk.oldCount; ++line )
+            {
+                edit.length += oldLines.at( line ).size();
+            }
+            position += edit.length;
+            for( int j = hunk.newStart; j < hunk.newStart + hunk.newCount; ++j )
+            {
+                edit.text += newLines.at( j );
+            }
+            edits += edit;
+        }
+
+        return edits;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+namespace mote
+{
+    class SourceFormatter
+    {
+    public:
+        // Replace length characters at position (in the unformatted text).
+        struct Edit
+        {
+            int position;
+            int length;
+            QString text;
+        };
+
+        struct Result
+        {
+            Result( void )
+                : ok( false )
+            {
+            }
+
+            bool ok;
+            QVector<Edit> edits;
+        };
+
+    public:
+        SourceFormatter( const int indentWidth = 4 );
+        SourceFormatter( const QString& options, const int indentWidth );
+
+    public:
+        int indentWidth( void )const;
+        QByteArray options( void )const;
+
+        bool format( const QString& text, QString& formattedText )const;
+        bool format(
+            const QByteArray& text,
+            QByteArray& formattedText,
+            QString* errorMessage = NULL )const;
+        Result formatEdits( const QString& text )const;
+
+        static QString defaultOptions( const int indentWidth );
+        static QVector<Edit> diff( const QString& oldText, const QString& newText );
+
+    private:
+        int m_indentWidth;
+        QByteArray m_options;
+    };
+}
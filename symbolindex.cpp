@@ -0,0 +1,946 @@
+#include "symbolindex.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QVector>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cstring>
+
+#include "ctags.h"
+
+namespace mote
+{
+    namespace
+    {
+        // Index file layout (native byte order, it is a local cache):
+        //
+        //   Header
+        //   FileRecord   x fileCount
+        //   SymbolRecord x symbolCount  (sorted by UTF-8 name)
+        //   string pool  x poolSize
+        //
+        // All records are fixed size so that the file can be used directly
+        // through a memory mapping and searched without being loaded.
+        const char IndexMagic[8] = { 'M', 'O', 'T', 'E', 'I', 'D', 'X', '1' };
+        const quint32 IndexVersion = 1;
+        const int FilesPerBatch = 256;
+
+        struct Header
+        {
+            char magic[8];
+            quint32 version;
+            quint32 fileCount;
+            quint32 symbolCount;
+            quint32 poolSize;
+        };
+
+        struct FileRecord
+        {
+            qint64 modified;
+            quint32 pathOffset;
+            quint32 pathLength;
+        };
+
+        struct SymbolRecord
+        {
+            quint32 nameOffset;
+            quint32 nameLength;
+            quint32 fileIndex;
+            quint32 lineNumber;
+            quint32 kindOffset;
+            quint32 kindLength;
+            quint32 scopeOffset;
+            quint32 scopeLength;
+        };
+
+        int compareBytes( const char* data1, int size1, const char* data2, int size2 )
+        {
+            const int ret = memcmp( data1, data2, qMin( size1, size2 ) );
+            if( ret != 0 )
+            {
+                return ret;
+            }
+            return size1 - size2;
+        }
+
+        // The header is checked on construction, which is cheap enough for
+        // every lookup; the records are checked by validate(), once for
+        // each file mapped.
+        class IndexView
+        {
+        public:
+            IndexView( const uchar* data, qint64 size )
+                : m_header( NULL ),
+                  m_files( NULL ),
+                  m_symbols( NULL ),
+                  m_pool( NULL )
+            {
+                if( !data || ( size < qint64( sizeof( Header ) ) ) )
+                {
+                    return;
+                }
+
+                const Header* header = reinterpret_cast<const Header*>( data );
+                if( ( memcmp( header->magic, IndexMagic, sizeof( IndexMagic ) ) != 0 ) ||
+                    ( header->version != IndexVersion ) )
+                {
+                    return;
+                }
+
+                const qint64 required =
+                    qint64( sizeof( Header ) ) +
+                    qint64( sizeof( FileRecord ) ) * header->fileCount +
+                    qint64( sizeof( SymbolRecord ) ) * header->symbolCount +
+                    header->poolSize;
+                if( size < required )
+                {
+                    return;
+                }
+
+                m_header = header;
+                m_files = reinterpret_cast<const FileRecord*>( data + sizeof( Header ) );
+                m_symbols = reinterpret_cast<const SymbolRecord*>( m_files + header->fileCount );
+                m_pool = reinterpret_cast<const char*>( m_symbols + header->symbolCount );
+            }
+
+        public:
+            bool isValid( void )const
+            {
+                return m_header != NULL;
+            }
+
+            // Whether every file index and string in the records lies
+            // within the file, so that a truncated or corrupt cache cannot
+            // be read out of bounds.
+            bool validate( void )const
+            {
+                if( !m_header )
+                {
+                    return false;
+                }
+
+                for( quint32 i = 0; i < m_header->fileCount; ++i )
+                {
+                    const FileRecord& record = m_files[i];
+                    if( !isString( record.pathOffset, record.pathLength ) )
+                    {
+                        return false;
+                    }
+                }
+
+                for( quint32 i = 0; i < m_header->symbolCount; ++i )
+                {
+                    const SymbolRecord& record = m_symbols[i];
+                    if( ( record.fileIndex >= m_header->fileCount ) ||
+                        !isString( record.nameOffset, record.nameLength ) ||
+                        !isString( record.kindOffset, record.kindLength ) ||
+                        !isString( record.scopeOffset, record.scopeLength ) )
+                    {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+            int fileCount( void )const
+            {
+                return m_header ? m_header->fileCount : 0;
+            }
+
+            int symbolCount( void )const
+            {
+                return m_header ? m_header->symbolCount : 0;
+            }
+
+            int poolSize( void )const
+            {
+                return m_header ? m_header->poolSize : 0;
+            }
+
+            const FileRecord& file( int i )const
+            {
+                return m_files[i];
+            }
+
+            const SymbolRecord& symbol( int i )const
+            {
+                return m_symbols[i];
+            }
+
+            const char* string( quint32 offset )const
+            {
+                return m_pool + offset;
+            }
+
+            int lowerBound( const QByteArray& name )const
+            {
+                int first = 0;
+                int count = symbolCount();
+                while( count > 0 )
+                {
+                    const int step = count / 2;
+                    const SymbolRecord& record = m_symbols[first + step];
+                    if( compareBytes(
+                            string( record.nameOffset ), record.nameLength,
+                            name.constData(), name.size() ) < 0 )
+                    {
+                        first += step + 1;
+                        count -= step + 1;
+                    }
+                    else
+                    {
+                        count = step;
+                    }
+                }
+                return first;
+            }
+
+        private:
+            bool isString( quint32 offset, quint32 length )const
+            {
+                return ( quint64( offset ) + length ) <= m_header->poolSize;
+            }
+
+        private:
+            const Header* m_header;
+            const FileRecord* m_files;
+            const SymbolRecord* m_symbols;
+            const char* m_pool;
+        };
+
+        struct PendingSymbol
+        {
+            QByteArray name;
+            int fileIndex;
+            int lineNumber;
+            QByteArray kind;
+            QByteArray scope;
+        };
+
+        bool lessSymbol( const PendingSymbol& symbol1, const PendingSymbol& symbol2 )
+        {
+            const int ret = compareBytes(
+                                symbol1.name.constData(), symbol1.name.size(),
+                                symbol2.name.constData(), symbol2.name.size() );
+            if( ret != 0 )
+            {
+                return ret < 0;
+            }
+            if( symbol1.fileIndex != symbol2.fileIndex )
+            {
+                return symbol1.fileIndex < symbol2.fileIndex;
+            }
+            return symbol1.lineNumber < symbol2.lineNumber;
+        }
+
+        // Orders records as lessSymbol() orders the symbols they are made of.
+        class LessRecord
+        {
+        public:
+            LessRecord( const char* pool )
+                : m_pool( pool )
+            {
+            }
+
+            bool operator()( const SymbolRecord& record1, const SymbolRecord& record2 )const
+            {
+                const int ret = compareBytes(
+                                    m_pool + record1.nameOffset, record1.nameLength,
+                                    m_pool + record2.nameOffset, record2.nameLength );
+                if( ret != 0 )
+                {
+                    return ret < 0;
+                }
+                if( record1.fileIndex != record2.fileIndex )
+                {
+                    return record1.fileIndex < record2.fileIndex;
+                }
+                return record1.lineNumber < record2.lineNumber;
+            }
+
+        private:
+            const char* m_pool;
+        };
+
+        // Strings are shared between records. A pool may start from the
+        // data of an existing one; only strings inserted since are shared.
+        class StringPool
+        {
+        public:
+            StringPool( const QByteArray& data = QByteArray() )
+                : m_data( data )
+            {
+            }
+
+        public:
+            quint32 insert( const QByteArray& string )
+            {
+                QHash<QByteArray, quint32>::const_iterator itr = m_offsets.find( string );
+                if( itr != m_offsets.end() )
+                {
+                    return itr.value();
+                }
+
+                const quint32 offset = m_data.size();
+                m_data += string;
+                m_offsets.insert( string, offset );
+                return offset;
+            }
+
+            const QByteArray& data( void )const
+            {
+                return m_data;
+            }
+
+        private:
+            QByteArray m_data;
+            QHash<QByteArray, quint32> m_offsets;
+        };
+
+        struct TagBatch
+        {
+            QStringList paths;
+            CTags tags;
+            bool ok;
+        };
+
+        class BatchTagger
+        {
+        public:
+            BatchTagger( const QString& rootPath )
+                : m_rootPath( rootPath )
+            {
+            }
+
+            void operator()( TagBatch& batch )const
+            {
+                batch.ok = batch.tags.exec( batch.paths, m_rootPath );
+            }
+
+        private:
+            QString m_rootPath;
+        };
+
+        // Written beside the live index, which may still be mapped; the GUI
+        // thread swaps the files in onBuildFinished().
+        bool writeIndex(
+            const QString& path,
+            const QVector<FileRecord>& fileRecords,
+            const QVector<SymbolRecord>& symbolRecords,
+            const QByteArray& pool )
+        {
+            Header header;
+            memcpy( header.magic, IndexMagic, sizeof( IndexMagic ) );
+            header.version = IndexVersion;
+            header.fileCount = fileRecords.size();
+            header.symbolCount = symbolRecords.size();
+            header.poolSize = pool.size();
+
+            QDir().mkpath( QFileInfo( path ).absolutePath() );
+            QSaveFile file( path );
+            if( !file.open( QIODevice::WriteOnly ) )
+            {
+                return false;
+            }
+            file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+            file.write(
+                reinterpret_cast<const char*>( fileRecords.constData() ),
+                sizeof( FileRecord ) * fileRecords.size() );
+            file.write(
+                reinterpret_cast<const char*>( symbolRecords.constData() ),
+                sizeof( SymbolRecord ) * symbolRecords.size() );
+            file.write( pool );
+            return file.commit();
+        }
+
+        // Each name once, in index order. Made on the worker thread: a
+        // large project has a million of them.
+        QStringList symbolNames( const QVector<SymbolRecord>& symbolRecords, const QByteArray& pool )
+        {
+            QStringList names;
+            const char* previousName = NULL;
+            int previousLength = 0;
+            for( int i = 0; i < symbolRecords.size(); ++i )
+            {
+                const SymbolRecord& record = symbolRecords.at( i );
+                const char* name = pool.constData() + record.nameOffset;
+                if( ( previousName != NULL ) &&
+                    ( compareBytes( previousName, previousLength, name, record.nameLength ) == 0 ) )
+                {
+                    continue;
+                }
+
+                names += QString::fromUtf8( name, record.nameLength );
+                previousName = name;
+                previousLength = record.nameLength;
+            }
+            return names;
+        }
+
+        QStringList sourceNameFilters( void )
+        {
+            QStringList filters;
+            filters += "*.c";
+            filters += "*.cc";
+            filters += "*.cpp";
+            filters += "*.cxx";
+            filters += "*.h";
+            filters += "*.hh";
+            filters += "*.hpp";
+            filters += "*.hxx";
+            filters += "*.inl";
+            filters += "*.m";
+            filters += "*.mm";
+            filters += "*.cs";
+            filters += "*.java";
+            filters += "*.js";
+            filters += "*.py";
+            return filters;
+        }
+    }
+
+    SymbolIndex::SymbolIndex( QObject* parent )
+        : QObject( parent ),
+          m_data( NULL ),
+          m_size( 0 ),
+          m_updatePending( false )
+    {
+        connect( &m_watcher, SIGNAL( finished() ), SLOT( onBuildFinished( void ) ) );
+    }
+
+    SymbolIndex::~SymbolIndex()
+    {
+        m_watcher.waitForFinished();
+        closeIndex();
+    }
+
+    QString SymbolIndex::rootPath( void )const
+    {
+        return m_rootPath;
+    }
+
+    void SymbolIndex::setRootPath( const QString& rootPath )
+    {
+        const QString path = rootPath.isEmpty() ? QString() : QDir( rootPath ).absolutePath();
+        if( path == m_rootPath )
+        {
+            return;
+        }
+
+        closeIndex();
+        m_rootPath = path;
+        m_pendingFiles.clear();
+        if( !m_rootPath.isEmpty() )
+        {
+            // The previous index is usable right away; refresh it behind.
+            openIndex();
+            update();
+        }
+    }
+
+    bool SymbolIndex::isUpdating( void )const
+    {
+        return m_watcher.isRunning();
+    }
+
+    int SymbolIndex::fileCount( void )const
+    {
+        return IndexView( m_data, m_size ).fileCount();
+    }
+
+    int SymbolIndex::symbolCount( void )const
+    {
+        return IndexView( m_data, m_size ).symbolCount();
+    }
+
+    QList<SymbolIndex::Symbol> SymbolIndex::find( const QString& name )const
+    {
+        QList<Symbol> symbols;
+
+        const IndexView index( m_data, m_size );
+        if( !index.isValid() || name.isEmpty() )
+        {
+            return symbols;
+        }
+
+        const QDir root( m_rootPath );
+        const QByteArray key = name.toUtf8();
+        for( int i = index.lowerBound( key ); i < index.symbolCount(); ++i )
+        {
+            const SymbolRecord& record = index.symbol( i );
+            if( compareBytes(
+                    index.string( record.nameOffset ), record.nameLength,
+                    key.constData(), key.size() ) != 0 )
+            {
+                break;
+            }
+
+            const FileRecord& file = index.file( record.fileIndex );
+
+            Symbol symbol;
+            symbol.name = name;
+            symbol.filePath = root.filePath(
+                                  QString::fromUtf8( index.string( file.pathOffset ), file.pathLength ) );
+            symbol.lineNumber = record.lineNumber;
+            symbol.kind = QString::fromUtf8( index.string( record.kindOffset ), record.kindLength );
+            symbol.scope = QString::fromUtf8( index.string( record.scopeOffset ), record.scopeLength );
+            symbols += symbol;
+        }
+
+        return symbols;
+    }
+
+    // Known once an update has finished; the index opened from the cache
+    // meanwhile is not read through on the GUI thread for them.
+    QStringList SymbolIndex::names( void )const
+    {
+        return m_names;
+    }
+
+    void SymbolIndex::update( void )
+    {
+        if( m_rootPath.isEmpty() )
+        {
+            return;
+        }
+
+        m_updatePending = true;
+        startBuild();
+    }
+
+    void SymbolIndex::updateFile( const QString& path )
+    {
+        if( m_rootPath.isEmpty() || !QDir::match( sourceNameFilters(), QFileInfo( path ).fileName() ) )
+        {
+            return;
+        }
+
+        const QString relativePath = QDir( m_rootPath ).relativeFilePath( QFileInfo( path ).absoluteFilePath() );
+        if( !relativePath.startsWith( ".." ) && !QDir::isAbsolutePath( relativePath ) )
+        {
+            if( !m_pendingFiles.contains( relativePath ) )
+            {
+                m_pendingFiles += relativePath;
+            }
+            startBuild();
+        }
+    }
+
+    // Starts what is pending unless a build is running; onBuildFinished()
+    // comes back here. A full update takes in the files saved meanwhile.
+    void SymbolIndex::startBuild( void )
+    {
+        if( m_watcher.isRunning() )
+        {
+            return;
+        }
+
+        const QString indexPath = indexFilePath( m_rootPath );
+        if( m_updatePending )
+        {
+            m_updatePending = false;
+            m_pendingFiles.clear();
+            m_watcher.setFuture( QtConcurrent::run( &SymbolIndex::build, m_rootPath, indexPath ) );
+        }
+        else if( !m_pendingFiles.isEmpty() )
+        {
+            m_watcher.setFuture(
+                QtConcurrent::run( &SymbolIndex::updateFiles, m_rootPath, indexPath, m_pendingFiles ) );
+            m_pendingFiles.clear();
+        }
+        else
+        {
+            return;
+        }
+        emit updateStarted();
+    }
+
+    QString SymbolIndex::indexFilePath( const QString& rootPath )
+    {
+        const QByteArray hash =
+            QCryptographicHash::hash( rootPath.toUtf8(), QCryptographicHash::Sha1 ).toHex();
+        const QDir cacheDir(
+            QDir( QStandardPaths::writableLocation( QStandardPaths::CacheLocation ) ).filePath( "symbols" ) );
+        return cacheDir.filePath( QString::fromLatin1( hash ) + ".idx" );
+    }
+
+    SymbolIndex::BuildResult SymbolIndex::build( const QString& rootPath, const QString& indexPath )
+    {
+        BuildResult result;
+        result.rootPath = rootPath;
+
+        const QDir root( rootPath );
+
+        // Hidden directories (.git etc.) are skipped by QDirIterator itself.
+        QStringList paths;
+        QVector<qint64> modified;
+        QHash<QString, int> fileIndexes;
+        QDirIterator dirItr( rootPath, sourceNameFilters(), QDir::Files, QDirIterator::Subdirectories );
+        while( dirItr.hasNext() )
+        {
+            dirItr.next();
+            const QFileInfo info = dirItr.fileInfo();
+            const QString path = root.relativeFilePath( info.filePath() );
+            fileIndexes.insert( path, paths.size() );
+            paths += path;
+            modified += info.lastModified().toMSecsSinceEpoch();
+        }
+        result.fileCount = paths.size();
+
+        // Keep the symbols of unchanged files from the previous index.
+        QVector<PendingSymbol> symbols;
+        QVector<bool> upToDate( paths.size(), false );
+        {
+            QFile oldFile( indexPath );
+            const uchar* oldData = NULL;
+            if( oldFile.open( QIODevice::ReadOnly ) )
+            {
+                oldData = oldFile.map( 0, oldFile.size() );
+            }
+
+            // A cache that does not check out is ignored and rebuilt whole.
+            IndexView oldIndex( oldData, oldData ? oldFile.size() : 0 );
+            if( !oldIndex.validate() )
+            {
+                oldIndex = IndexView( NULL, 0 );
+            }
+            QVector<int> oldToNew( oldIndex.fileCount(), -1 );
+            for( int i = 0; i < oldIndex.fileCount(); ++i )
+            {
+                const FileRecord& file = oldIndex.file( i );
+                const int fileIndex =
+                    fileIndexes.value(
+                        QString::fromUtf8( oldIndex.string( file.pathOffset ), file.pathLength ), -1 );
+                if( ( fileIndex >= 0 ) && ( modified.at( fileIndex ) == file.modified ) )
+                {
+                    oldToNew[i] = fileIndex;
+                    upToDate[fileIndex] = true;
+                }
+            }
+
+            for( int i = 0; i < oldIndex.symbolCount(); ++i )
+            {
+                const SymbolRecord& record = oldIndex.symbol( i );
+                const int fileIndex = oldToNew.at( record.fileIndex );
+                if( fileIndex < 0 )
+                {
+                    continue;
+                }
+
+                PendingSymbol symbol;
+                symbol.name = QByteArray( oldIndex.string( record.nameOffset ), record.nameLength );
+                symbol.fileIndex = fileIndex;
+                symbol.lineNumber = record.lineNumber;
+                symbol.kind = QByteArray( oldIndex.string( record.kindOffset ), record.kindLength );
+                symbol.scope = QByteArray( oldIndex.string( record.scopeOffset ), record.scopeLength );
+                symbols += symbol;
+            }
+        }
+
+        // Run ctags over the new and modified files, several batches at once.
+        QVector<TagBatch> batches;
+        for( int i = 0; i < paths.size(); ++i )
+        {
+            if( upToDate.at( i ) )
+            {
+                continue;
+            }
+
+            if( batches.isEmpty() || ( batches.last().paths.size() >= FilesPerBatch ) )
+            {
+                batches += TagBatch();
+                batches.last().ok = false;
+            }
+            batches.last().paths += paths.at( i );
+            ++result.taggedFileCount;
+        }
+        QtConcurrent::blockingMap( batches, BatchTagger( rootPath ) );
+
+        bool tagged = batches.isEmpty();
+        for( int i = 0; i < batches.size(); ++i )
+        {
+            const TagBatch& batch = batches.at( i );
+            if( !batch.ok )
+            {
+                continue;
+            }
+            tagged = true;
+
+            const CTags& tags = batch.tags;
+            for( int j = 0; j < tags.count(); ++j )
+            {
+                const int fileIndex = fileIndexes.value( QDir::fromNativeSeparators( tags.fileName( j ) ), -1 );
+                if( fileIndex < 0 )
+                {
+                    continue;
+                }
+
+                PendingSymbol symbol;
+                symbol.name = tags.tagName( j ).toUtf8();
+                symbol.fileIndex = fileIndex;
+                symbol.lineNumber = tags.lineNumber( j );
+                symbol.kind = tags.kind( j ).toUtf8();
+                symbol.scope = tags.scope( j ).toUtf8();
+                symbols += symbol;
+            }
+        }
+        if( !tagged )
+        {
+            // ctags is not available; keep the previous index.
+            return result;
+        }
+
+        std::sort( symbols.begin(), symbols.end(), lessSymbol );
+
+        StringPool pool;
+        QVector<FileRecord> fileRecords( paths.size() );
+        for( int i = 0; i < paths.size(); ++i )
+        {
+            const QByteArray path = paths.at( i ).toUtf8();
+            FileRecord& record = fileRecords[i];
+            record.modified = modified.at( i );
+            record.pathOffset = pool.insert( path );
+            record.pathLength = path.size();
+        }
+
+        QVector<SymbolRecord> symbolRecords( symbols.size() );
+        for( int i = 0; i < symbols.size(); ++i )
+        {
+            const PendingSymbol& symbol = symbols.at( i );
+            SymbolRecord& record = symbolRecords[i];
+            record.nameOffset = pool.insert( symbol.name );
+            record.nameLength = symbol.name.size();
+            record.fileIndex = symbol.fileIndex;
+            record.lineNumber = symbol.lineNumber;
+            record.kindOffset = pool.insert( symbol.kind );
+            record.kindLength = symbol.kind.size();
+            record.scopeOffset = pool.insert( symbol.scope );
+            record.scopeLength = symbol.scope.size();
+        }
+
+        const QString newIndexPath = indexPath + ".new";
+        if( !writeIndex( newIndexPath, fileRecords, symbolRecords, pool.data() ) )
+        {
+            return result;
+        }
+
+        result.indexPath = newIndexPath;
+        result.symbolCount = symbols.size();
+        result.names = symbolNames( symbolRecords, pool.data() );
+        result.ok = true;
+        return result;
+    }
+
+    // Re-tags only paths, relative to the root, and merges their symbols
+    // into the current index: the other records are copied in order and
+    // the new ones merged in. Strings of the symbols replaced stay in the
+    // pool until the next full build.
+    SymbolIndex::BuildResult SymbolIndex::updateFiles(
+        const QString& rootPath,
+        const QString& indexPath,
+        const QStringList& paths )
+    {
+        BuildResult result;
+        result.rootPath = rootPath;
+
+        QFile oldFile( indexPath );
+        const uchar* oldData = NULL;
+        if( oldFile.open( QIODevice::ReadOnly ) )
+        {
+            oldData = oldFile.map( 0, oldFile.size() );
+        }
+        const IndexView oldIndex( oldData, oldData ? oldFile.size() : 0 );
+        if( !oldIndex.validate() )
+        {
+            // Nothing to merge into.
+            return build( rootPath, indexPath );
+        }
+
+        QVector<FileRecord> fileRecords( oldIndex.fileCount() );
+        for( int i = 0; i < fileRecords.size(); ++i )
+        {
+            fileRecords[i] = oldIndex.file( i );
+        }
+        StringPool pool( QByteArray( oldIndex.string( 0 ), oldIndex.poolSize() ) );
+
+        const QDir root( rootPath );
+        QVector<bool> replaced( fileRecords.size(), false );
+        QHash<QString, int> fileIndexes;
+        for( int i = 0; i < paths.size(); ++i )
+        {
+            const QByteArray path = paths.at( i ).toUtf8();
+            int fileIndex = -1;
+            for( int j = 0; j < oldIndex.fileCount(); ++j )
+            {
+                const FileRecord& record = oldIndex.file( j );
+                if( compareBytes(
+                        oldIndex.string( record.pathOffset ), record.pathLength,
+                        path.constData(), path.size() ) == 0 )
+                {
+                    fileIndex = j;
+                    break;
+                }
+            }
+            if( fileIndex < 0 )
+            {
+                FileRecord record;
+                record.pathOffset = pool.insert( path );
+                record.pathLength = path.size();
+                fileIndex = fileRecords.size();
+                fileRecords += record;
+                replaced += false;
+            }
+
+            fileRecords[fileIndex].modified =
+                QFileInfo( root.filePath( paths.at( i ) ) ).lastModified().toMSecsSinceEpoch();
+            replaced[fileIndex] = true;
+            fileIndexes.insert( paths.at( i ), fileIndex );
+        }
+
+        CTags tags;
+        if( !tags.exec( paths, rootPath ) )
+        {
+            // ctags is not available; keep the previous index.
+            return result;
+        }
+
+        QVector<SymbolRecord> newRecords;
+        newRecords.reserve( tags.count() );
+        for( int i = 0; i < tags.count(); ++i )
+        {
+            const int fileIndex = fileIndexes.value( QDir::fromNativeSeparators( tags.fileName( i ) ), -1 );
+            if( fileIndex < 0 )
+            {
+                continue;
+            }
+
+            const QByteArray name = tags.tagName( i ).toUtf8();
+            const QByteArray kind = tags.kind( i ).toUtf8();
+            const QByteArray scope = tags.scope( i ).toUtf8();
+
+            SymbolRecord record;
+            record.nameOffset = pool.insert( name );
+            record.nameLength = name.size();
+            record.fileIndex = fileIndex;
+            record.lineNumber = tags.lineNumber( i );
+            record.kindOffset = pool.insert( kind );
+            record.kindLength = kind.size();
+            record.scopeOffset = pool.insert( scope );
+            record.scopeLength = scope.size();
+            newRecords += record;
+        }
+
+        const LessRecord lessRecord( pool.data().constData() );
+        std::sort( newRecords.begin(), newRecords.end(), lessRecord );
+
+        QVector<SymbolRecord> symbolRecords;
+        symbolRecords.reserve( oldIndex.symbolCount() + newRecords.size() );
+        int next = 0;
+        for( int i = 0; i < oldIndex.symbolCount(); ++i )
+        {
+            const SymbolRecord& record = oldIndex.symbol( i );
+            if( replaced.at( record.fileIndex ) )
+            {
+                continue;
+            }
+
+            while( ( next < newRecords.size() ) && lessRecord( newRecords.at( next ), record ) )
+            {
+                symbolRecords += newRecords.at( next++ );
+            }
+            symbolRecords += record;
+        }
+        for( ; next < newRecords.size(); ++next )
+        {
+            symbolRecords += newRecords.at( next );
+        }
+
+        const QString newIndexPath = indexPath + ".new";
+        if( !writeIndex( newIndexPath, fileRecords, symbolRecords, pool.data() ) )
+        {
+            return result;
+        }
+
+        result.indexPath = newIndexPath;
+        result.fileCount = fileRecords.size();
+        result.taggedFileCount = paths.size();
+        result.symbolCount = symbolRecords.size();
+        result.names = symbolNames( symbolRecords, pool.data() );
+        result.ok = true;
+        return result;
+    }
+
+    bool SymbolIndex::openIndex( void )
+    {
+        closeIndex();
+
+        m_file.setFileName( indexFilePath( m_rootPath ) );
+        if( !m_file.open( QIODevice::ReadOnly ) )
+        {
+            return false;
+        }
+
+        m_size = m_file.size();
+        m_data = m_file.map( 0, m_size );
+        if( !m_data || !IndexView( m_data, m_size ).validate() )
+        {
+            // Rebuilt by the update that follows opening.
+            closeIndex();
+            return false;
+        }
+
+        return true;
+    }
+
+    void SymbolIndex::closeIndex( void )
+    {
+        if( m_data )
+        {
+            m_file.unmap( const_cast<uchar*>( m_data ) );
+            m_data = NULL;
+        }
+        m_size = 0;
+        m_file.close();
+        m_names.clear();
+    }
+
+    void SymbolIndex::onBuildFinished( void )
+    {
+        const BuildResult result = m_watcher.result();
+
+        if( result.rootPath != m_rootPath )
+        {
+            // The project was switched while building.
+            if( result.ok )
+            {
+                QFile::remove( result.indexPath );
+            }
+            update();
+            return;
+        }
+
+        if( result.ok )
+        {
+            const QString indexPath = indexFilePath( m_rootPath );
+            closeIndex();
+            QFile::remove( indexPath );
+            QFile::rename( result.indexPath, indexPath );
+            openIndex();
+            m_names = result.names;
+        }
+
+        emit updateFinished( result.ok );
+
+        startBuild();
+    }
+}
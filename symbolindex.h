@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QFile>
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+namespace mote
+{
+    class SymbolIndex : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        struct Symbol
+        {
+            QString name;
+            QString filePath;
+            int lineNumber;
+            QString kind;
+            QString scope;
+        };
+
+    public:
+        SymbolIndex( QObject* parent = 0 );
+        virtual ~SymbolIndex();
+
+    public:
+        QString rootPath( void )const;
+        bool isUpdating( void )const;
+        int fileCount( void )const;
+        int symbolCount( void )const;
+        QList<Symbol> find( const QString& name )const;
+        QStringList names( void )const;
+
+    public slots:
+        void setRootPath( const QString& rootPath );
+        void update( void );
+        void updateFile( const QString& path );
+
+    signals:
+        void updateStarted( void );
+        void updateFinished( bool ok );
+
+    private:
+        struct BuildResult
+        {
+            BuildResult( void )
+                : ok( false ),
+                  fileCount( 0 ),
+                  taggedFileCount( 0 ),
+                  symbolCount( 0 )
+            {
+            }
+
+            QString rootPath;
+            QString indexPath;
+            bool ok;
+            int fileCount;
+            int taggedFileCount;
+            int symbolCount;
+            QStringList names;
+        };
+
+        static QString indexFilePath( const QString& rootPath );
+        static BuildResult build( const QString& rootPath, const QString& indexPath );
+        static BuildResult updateFiles(
+            const QString& rootPath,
+            const QString& indexPath,
+            const QStringList& paths );
+
+        void startBuild( void );
+
+        bool openIndex( void );
+        void closeIndex( void );
+
+    private slots:
+        void onBuildFinished( void );
+
+    private:
+        QString m_rootPath;
+        QFile m_file;
+        const uchar* m_data;
+        qint64 m_size;
+        QStringList m_names;
+        bool m_updatePending;
+        QStringList m_pendingFiles;
+        QFutureWatcher<BuildResult> m_watcher;
+    };
+}
@@ -1,65 +1,181 @@
 #include "tagjumpdialog.h"
 
+#include <QAbstractTableModel>
+#include <QApplication>
 #include <QDialogButtonBox>
-#include <QTreeWidget>
-#include <QTreeWidgetItem>
+#include <QFontMetrics>
+#include <QHeaderView>
+#include <QKeyEvent>
 #include <QVBoxLayout>
+#include <QtConcurrent>
 
-#include "ctags.h"
+#include <algorithm>
+
+#include "fuzzymatcher.h"
 #include "settings.h"
 
 namespace mote
 {
+    // Rows refer to the tag storage by index; nothing is copied per tag and
+    // only the visible rows are ever decoded.
+    class TagModel : public QAbstractTableModel
+    {
+    public:
+        TagModel( const CTags& ctags, QObject* parent = 0 )
+            : QAbstractTableModel( parent ),
+              m_ctags( ctags )
+        {
+        }
+
+    public:
+        virtual int rowCount( const QModelIndex& parent = QModelIndex() )const
+        {
+            return parent.isValid() ? 0 : m_rows.size();
+        }
+
+        virtual int columnCount( const QModelIndex& parent = QModelIndex() )const
+        {
+            return parent.isValid() ? 0 : 4;
+        }
+
+        virtual QVariant data( const QModelIndex& index, int role = Qt::DisplayRole )const
+        {
+            if( !index.isValid() || ( role != Qt::DisplayRole ) )
+            {
+                return QVariant();
+            }
+
+            const int entry = m_rows.at( index.row() );
+            switch( index.column() )
+            {
+            case 0:
+                return m_ctags.tagName( entry );
+            case 1:
+                return m_ctags.scope( entry );
+            case 2:
+                return m_ctags.kind( entry );
+            case 3:
+                return m_ctags.lineNumber( entry );
+            default:
+                return QVariant();
+            }
+        }
+
+        virtual QVariant headerData( int section, Qt::Orientation orientation, int role = Qt::DisplayRole )const
+        {
+            if( ( orientation != Qt::Horizontal ) || ( role != Qt::DisplayRole ) )
+            {
+                return QVariant();
+            }
+
+            switch( section )
+            {
+            case 0:
+                return TagJumpDialog::tr( "Tag Name" );
+            case 1:
+                return TagJumpDialog::tr( "Scope" );
+            case 2:
+                return TagJumpDialog::tr( "Kind" );
+            case 3:
+                return TagJumpDialog::tr( "Line Numer" );
+            default:
+                return QVariant();
+            }
+        }
+
+    public:
+        int entry( int row )const
+        {
+            return m_rows.at( row );
+        }
+
+        void setRows( const QVector<int>& rows )
+        {
+            beginResetModel();
+            m_rows = rows;
+            endResetModel();
+        }
+
+    private:
+        CTags m_ctags;
+        QVector<int> m_rows;
+    };
+
+    namespace
+    {
+        struct ScoredEntry
+        {
+            int score;
+            int entry;
+        };
+
+        bool higherScore( const ScoredEntry& entry1, const ScoredEntry& entry2 )
+        {
+            return entry1.score > entry2.score;
+        }
+    }
+
     TagJumpDialog::TagJumpDialog(
         const CTags& ctags,
         const int lineNumber,
         QWidget* parent )
         : QDialog( parent ),
+          m_ctags( ctags ),
           m_selectedEntry( -1 )
     {
         setWindowTitle( tr( "Tag Jump" ) );
 
-        m_tree = new QTreeWidget;
-        m_tree->setRootIsDecorated( false );
-        m_tree->setColumnCount( 4 );
-        m_tree->setHeaderLabels(
-            QStringList() << tr( "Tag Name" ) << tr( "Scope" ) << tr( "Kind" ) << tr( "Line Numer" ) );
-
-        QTreeWidgetItem* currentItem = NULL;
-        for( int i = 0; i < ctags.count(); ++i )
-        {
-            const CTags::Entry& entry = ctags.entry( i );
-            QTreeWidgetItem* item = new QTreeWidgetItem( m_tree );
-            item->setText( 0, entry.tagName );
-            item->setData( 0, Qt::UserRole, i );
-            item->setText( 1, entry.scope() );
-            item->setText( 2, entry.kind() );
-            item->setText( 3, entry.exCmd );
-            if( !currentItem || ( entry.exCmd.toInt() <= lineNumber ) )
+        m_filterEdit = new QLineEdit;
+        m_filterEdit->installEventFilter( this );
+
+        m_model = new TagModel( ctags, this );
+        QVector<int> rows( ctags.count() );
+        int currentRow = -1;
+        for( int i = 0; i < rows.size(); ++i )
+        {
+            rows[i] = i;
+            if( ( currentRow < 0 ) || ( ctags.lineNumber( i ) <= lineNumber ) )
             {
-                currentItem = item;
+                currentRow = i;
             }
         }
-        m_tree->resizeColumnToContents( 0 );
-        m_tree->resizeColumnToContents( 1 );
-        m_tree->resizeColumnToContents( 2 );
-        if( currentItem )
+        m_model->setRows( rows );
+
+        // Fixed column widths: measuring the contents would touch every row.
+        m_view = new QTreeView;
+        m_view->setRootIsDecorated( false );
+        m_view->setUniformRowHeights( true );
+        m_view->setAllColumnsShowFocus( true );
+        m_view->setModel( m_model );
+        const int charWidth = m_view->fontMetrics().averageCharWidth();
+        m_view->header()->resizeSection( 0, charWidth * 32 );
+        m_view->header()->resizeSection( 1, charWidth * 24 );
+        m_view->header()->resizeSection( 2, charWidth * 12 );
+        if( currentRow >= 0 )
         {
-            m_tree->setCurrentItem( currentItem );
+            m_view->setCurrentIndex( m_model->index( currentRow, 0 ) );
+            m_view->scrollTo( m_view->currentIndex(), QAbstractItemView::PositionAtCenter );
         }
 
         QDialogButtonBox* buttonBox =
             new QDialogButtonBox( QDialogButtonBox::Ok | QDialogButtonBox::Cancel );
 
         connect(
-            m_tree, SIGNAL( itemDoubleClicked( QTreeWidgetItem*, int ) ),
+            m_view, SIGNAL( doubleClicked( const QModelIndex& ) ),
             SLOT( accept() ) );
+        connect(
+            m_filterEdit, SIGNAL( textChanged( const QString& ) ),
+            SLOT( startFilter( void ) ) );
+        connect(
+            &m_filterWatcher, SIGNAL( finished() ),
+            SLOT( onFilterFinished( void ) ) );
 
         connect( buttonBox, SIGNAL( accepted() ), SLOT( accept() ) );
         connect( buttonBox, SIGNAL( rejected() ), SLOT( reject() ) );
 
         QVBoxLayout* layout = new QVBoxLayout;
-        layout->addWidget( m_tree );
+        layout->addWidget( m_filterEdit );
+        layout->addWidget( m_view );
         layout->addWidget( buttonBox );
 
         setLayout( layout );
@@ -72,17 +188,39 @@ namespace mote
 
     void TagJumpDialog::accept()
     {
-        const QTreeWidgetItem* item = m_tree->currentItem();
-        if( !item )
+        const QModelIndex index = m_view->currentIndex();
+        if( !index.isValid() )
         {
             return;
         }
 
-        m_selectedEntry = item->data( 0, Qt::UserRole ).toInt();
+        m_selectedEntry = m_model->entry( index.row() );
 
         QDialog::accept();
     }
 
+    bool TagJumpDialog::eventFilter( QObject* watched, QEvent* event )
+    {
+        // Let the cursor keys move through the list while typing a filter.
+        if( ( watched == m_filterEdit ) && ( event->type() == QEvent::KeyPress ) )
+        {
+            const QKeyEvent* keyEvent = static_cast<QKeyEvent*>( event );
+            switch( keyEvent->key() )
+            {
+            case Qt::Key_Up:
+            case Qt::Key_Down:
+            case Qt::Key_PageUp:
+            case Qt::Key_PageDown:
+                QApplication::sendEvent( m_view, event );
+                return true;
+            default:
+                break;
+            }
+        }
+
+        return QDialog::eventFilter( watched, event );
+    }
+
     void TagJumpDialog::saveSize( Settings* settings )const
     {
         settings->setValue( "tagJumpDialogWidth", width() );
@@ -104,4 +242,70 @@ namespace mote
     {
         return m_selectedEntry;
     }
+
+    QVector<int> TagJumpDialog::filterTags( const CTags& ctags, const QString& pattern )
+    {
+        const FuzzyMatcher matcher( pattern );
+        const int count = ctags.count();
+
+        QVector<ScoredEntry> matches;
+        matches.reserve( count );
+        for( int i = 0; i < count; ++i )
+        {
+            ScoredEntry match;
+            if( matcher.match( ctags.tagName( i ), &match.score ) )
+            {
+                match.entry = i;
+                matches += match;
+            }
+        }
+
+        // Ties keep the file order.
+        std::stable_sort( matches.begin(), matches.end(), higherScore );
+
+        QVector<int> rows( matches.size() );
+        for( int i = 0; i < matches.size(); ++i )
+        {
+            rows[i] = matches.at( i ).entry;
+        }
+        return rows;
+    }
+
+    void TagJumpDialog::startFilter( void )
+    {
+        if( m_filterWatcher.isRunning() )
+        {
+            // Picked up again by onFilterFinished().
+            return;
+        }
+
+        m_filterPattern = m_filterEdit->text();
+        if( m_filterPattern.isEmpty() )
+        {
+            QVector<int> rows( m_ctags.count() );
+            for( int i = 0; i < rows.size(); ++i )
+            {
+                rows[i] = i;
+            }
+            m_model->setRows( rows );
+            m_view->setCurrentIndex( m_model->index( 0, 0 ) );
+            return;
+        }
+
+        m_filterWatcher.setFuture(
+            QtConcurrent::run( &TagJumpDialog::filterTags, m_ctags, m_filterPattern ) );
+    }
+
+    void TagJumpDialog::onFilterFinished( void )
+    {
+        if( m_filterPattern != m_filterEdit->text() )
+        {
+            // The text was edited while filtering; the result is stale.
+            startFilter();
+            return;
+        }
+
+        m_model->setRows( m_filterWatcher.result() );
+        m_view->setCurrentIndex( m_model->index( 0, 0 ) );
+    }
 }
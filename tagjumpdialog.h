@@ -1,12 +1,17 @@
 #pragma once
 
 #include <QDialog>
-#include <QTreeWidget>
+#include <QFutureWatcher>
+#include <QLineEdit>
+#include <QTreeView>
+#include <QVector>
+
+#include "ctags.h"
 
 namespace mote
 {
-    class CTags;
     class Settings;
+    class TagModel;
 
     class TagJumpDialog : public QDialog
     {
@@ -21,15 +26,28 @@ namespace mote
     public:
         virtual QSize sizeHint()const;
         virtual void accept();
+        virtual bool eventFilter( QObject* watched, QEvent* event );
 
     public:
         void saveSize( Settings* settings )const;
         void restoreSize( Settings* settings );
         int selectedEntry( void )const;
 
+    private:
+        static QVector<int> filterTags( const CTags& ctags, const QString& pattern );
+
+    private slots:
+        void startFilter( void );
+        void onFilterFinished( void );
+
     private:
         QSize m_preferredSize;
-        QTreeWidget* m_tree;
+        CTags m_ctags;
+        TagModel* m_model;
+        QTreeView* m_view;
+        QLineEdit* m_filterEdit;
+        QFutureWatcher< QVector<int> > m_filterWatcher;
+        QString m_filterPattern;
         int m_selectedEntry;
     };
 }
@@ -0,0 +1,155 @@
+#include "tagservice.h"
+
+#include "tagworker.h"
+#include "textdocument.h"
+
+namespace mote
+{
+    TagService::TagService( QObject* parent )
+        : QObject( parent ),
+          m_worker( NULL ),
+          m_nextRequestId( 0 )
+    {
+        qRegisterMetaType<CTags>( "mote::CTags" );
+
+        // One worker thread owns the (possibly long-running) ctags process,
+        // so requests are served in order and never block the GUI.
+        m_worker = new TagWorker;
+        m_worker->moveToThread( &m_thread );
+        connect(
+            &m_thread, SIGNAL( finished() ),
+            m_worker, SLOT( deleteLater() ) );
+        connect(
+            this, SIGNAL( generateRequested( int, const QString&, const QByteArray& ) ),
+            m_worker, SLOT( generate( int, const QString&, const QByteArray& ) ) );
+        connect(
+            m_worker, SIGNAL( finished( int, bool, const mote::CTags& ) ),
+            SLOT( onGenerated( int, bool, const mote::CTags& ) ) );
+        m_thread.start();
+    }
+
+    TagService::~TagService()
+    {
+        m_thread.quit();
+        m_thread.wait();
+    }
+
+    const CTags* TagService::tags( TextDocument* textDocument )const
+    {
+        QHash<QObject*, CacheEntry>::const_iterator itr = m_cache.find( textDocument );
+        if( ( itr == m_cache.end() ) || !itr->valid )
+        {
+            return NULL;
+        }
+
+        return &itr->tags;
+    }
+
+    bool TagService::isUpToDate( TextDocument* textDocument )const
+    {
+        QHash<QObject*, CacheEntry>::const_iterator itr = m_cache.find( textDocument );
+        if( ( itr == m_cache.end() ) || !itr->valid )
+        {
+            return false;
+        }
+
+        return ( itr->revision == textDocument->editRevision() ) && ( itr->fileName == textDocument->fileName() );
+    }
+
+    bool TagService::requestTags( TextDocument* textDocument )
+    {
+        if( !textDocument )
+        {
+            return false;
+        }
+
+        const QString fileName = textDocument->fileName();
+        const int revision = textDocument->editRevision();
+
+        if( !m_cache.contains( textDocument ) )
+        {
+            connect(
+                textDocument, SIGNAL( destroyed( QObject* ) ),
+                SLOT( onDocumentDestroyed( QObject* ) ) );
+        }
+
+        CacheEntry& entry = m_cache[textDocument];
+        if( entry.valid && ( entry.revision == revision ) && ( entry.fileName == fileName ) )
+        {
+            return true;
+        }
+
+        if( ( entry.pendingRevision == revision ) && ( entry.pendingFileName == fileName ) )
+        {
+            // Same content is already being tagged.
+            return false;
+        }
+
+        Request request;
+        request.document = textDocument;
+        request.revision = revision;
+        request.fileName = fileName;
+
+        const int requestId = m_nextRequestId++;
+        m_requests.insert( requestId, request );
+        entry.pendingRevision = revision;
+        entry.pendingFileName = fileName;
+
+        emit generateRequested( requestId, fileName, textDocument->plainText().toUtf8() );
+
+        return false;
+    }
+
+    void TagService::onGenerated( int requestId, bool ok, const mote::CTags& tags )
+    {
+        const Request request = m_requests.take( requestId );
+        if( !request.document )
+        {
+            return;
+        }
+
+        TextDocument* textDocument = request.document;
+        QHash<QObject*, CacheEntry>::iterator itr = m_cache.find( textDocument );
+        if( itr == m_cache.end() )
+        {
+            return;
+        }
+
+        const bool newerPending =
+            ( itr->pendingRevision != request.revision ) || ( itr->pendingFileName != request.fileName );
+        if( !newerPending )
+        {
+            itr->pendingRevision = -1;
+            itr->pendingFileName.clear();
+        }
+
+        // Tags of text edited since are dropped. Unless a newer request is
+        // on its way, the current text is tagged instead.
+        if( ( request.revision != textDocument->editRevision() ) || ( request.fileName != textDocument->fileName() ) )
+        {
+            if( !newerPending )
+            {
+                requestTags( textDocument );
+            }
+            return;
+        }
+
+        if( ok )
+        {
+            itr->revision = request.revision;
+            itr->fileName = request.fileName;
+            itr->tags = tags;
+            itr->valid = true;
+            emit tagsUpdated( textDocument );
+        }
+        else
+        {
+            emit tagsFailed( textDocument );
+        }
+    }
+
+    void TagService::onDocumentDestroyed( QObject* object )
+    {
+        m_cache.remove( object );
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QThread>
+
+#include "ctags.h"
+
+namespace mote
+{
+    class TagWorker;
+    class TextDocument;
+
+    class TagService : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        TagService( QObject* parent = 0 );
+        virtual ~TagService();
+
+    public:
+        const CTags* tags( TextDocument* textDocument )const;
+        bool isUpToDate( TextDocument* textDocument )const;
+        bool requestTags( TextDocument* textDocument );
+
+    signals:
+        void tagsUpdated( TextDocument* textDocument );
+        void tagsFailed( TextDocument* textDocument );
+        void generateRequested( int requestId, const QString& fileName, const QByteArray& content );
+
+    private slots:
+        void onGenerated( int requestId, bool ok, const mote::CTags& tags );
+        void onDocumentDestroyed( QObject* object );
+
+    private:
+        // Contents are told apart by the edit revision of the document,
+        // together with the file name that selects the language.
+        struct CacheEntry
+        {
+            CacheEntry( void )
+                : revision( -1 ),
+                  pendingRevision( -1 ),
+                  valid( false )
+            {
+            }
+
+            int revision;
+            QString fileName;
+            int pendingRevision;
+            QString pendingFileName;
+            bool valid;
+            CTags tags;
+        };
+
+        struct Request
+        {
+            QPointer<TextDocument> document;
+            int revision;
+            QString fileName;
+        };
+
+        QThread m_thread;
+        TagWorker* m_worker;
+        int m_nextRequestId;
+        QHash<int, Request> m_requests;
+        QHash<QObject*, CacheEntry> m_cache;
+    };
+}
@@ -0,0 +1,173 @@
+#include "tagworker.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+
+namespace mote
+{
+    static const int InteractiveTimeout = 30000;
+
+    TagWorker::TagWorker( QObject* parent )
+        : QObject( parent ),
+          m_interactiveSupport( InteractiveUnknown ),
+          m_process( NULL )
+    {
+    }
+
+    TagWorker::~TagWorker()
+    {
+        stopInteractive();
+    }
+
+    void TagWorker::generate( int requestId, const QString& fileName, const QByteArray& content )
+    {
+        const QString name = fileName.isEmpty() ? QString( "temp.cpp" ) : fileName;
+
+        CTags tags;
+        bool ok = generateInteractive( name, content, tags );
+        if( !ok )
+        {
+            tags = CTags();
+            ok = tags.exec( name, content );
+        }
+
+        emit finished( requestId, ok, tags );
+    }
+
+    bool TagWorker::isInteractiveSupported( void )
+    {
+        if( m_interactiveSupport == InteractiveUnknown )
+        {
+            // Only Universal Ctags built with libjansson has the interactive
+            // mode. Exuberant Ctags fails on --list-features.
+            bool supported = false;
+            QProcess process;
+            process.start( CTags::findCTags(), QStringList() << "--list-features" );
+            if( process.waitForFinished( InteractiveTimeout ) &&
+                ( process.exitStatus() == QProcess::NormalExit ) &&
+                ( process.exitCode() == 0 ) )
+            {
+                const QByteArray features = process.readAllStandardOutput();
+                supported = features.contains( "interactive" ) && features.contains( "json" );
+            }
+            m_interactiveSupport = supported ? InteractiveSupported : InteractiveUnsupported;
+        }
+
+        return m_interactiveSupport == InteractiveSupported;
+    }
+
+    bool TagWorker::startInteractive( void )
+    {
+        stopInteractive();
+
+        QStringList args;
+        args += "--_interactive";
+        args += "--fields=+nK";
+
+        m_process = new QProcess( this );
+        m_process->setStandardErrorFile( QProcess::nullDevice() );
+        m_process->start( CTags::findCTags(), args );
+        if( !m_process->waitForStarted( InteractiveTimeout ) )
+        {
+            stopInteractive();
+            return false;
+        }
+
+        // {"_type": "program", "name": "Universal Ctags", ...}
+        QByteArray line;
+        if( !readJsonLine( line ) ||
+            ( QJsonDocument::fromJson( line ).object().value( "_type" ).toString() != "program" ) )
+        {
+            stopInteractive();
+            return false;
+        }
+
+        return true;
+    }
+
+    void TagWorker::stopInteractive( void )
+    {
+        if( m_process )
+        {
+            m_process->kill();
+            m_process->waitForFinished();
+            delete m_process;
+            m_process = NULL;
+        }
+    }
+
+    bool TagWorker::readJsonLine( QByteArray& line )
+    {
+        while( !m_process->canReadLine() )
+        {
+            if( ( m_process->state() != QProcess::Running ) ||
+                !m_process->waitForReadyRead( InteractiveTimeout ) )
+            {
+                return false;
+            }
+        }
+
+        line = m_process->readLine();
+        return true;
+    }
+
+    bool TagWorker::generateInteractive( const QString& fileName, const QByteArray& content, CTags& tags )
+    {
+        if( !isInteractiveSupported() )
+        {
+            return false;
+        }
+
+        if( !m_process || ( m_process->state() != QProcess::Running ) )
+        {
+            if( !startInteractive() )
+            {
+                m_interactiveSupport = InteractiveUnsupported;
+                return false;
+            }
+        }
+
+        QJsonObject command;
+        command.insert( "command", QString( "generate-tags" ) );
+        command.insert( "filename", fileName );
+        command.insert( "size", content.size() );
+        m_process->write( QJsonDocument( command ).toJson( QJsonDocument::Compact ) );
+        m_process->write( "\n" );
+        m_process->write( content );
+
+        while( true )
+        {
+            QByteArray line;
+            if( !readJsonLine( line ) )
+            {
+                stopInteractive();
+                return false;
+            }
+
+            const QJsonObject object = QJsonDocument::fromJson( line ).object();
+            const QString type = object.value( "_type" ).toString();
+            if( type == "tag" )
+            {
+                const QString scopeKind = object.value( "scopeKind" ).toString();
+                tags.append(
+                    object.value( "name" ).toString(),
+                    object.value( "path" ).toString(),
+                    object.value( "line" ).toInt(),
+                    object.value( "kind" ).toString(),
+                    CTags::isScopeKind( scopeKind.toUtf8() ) ?
+                    object.value( "scope" ).toString() : QString() );
+            }
+            else if( type == "completed" )
+            {
+                return true;
+            }
+            else if( type == "error" )
+            {
+                // The stream may be out of sync now; start over next time.
+                stopInteractive();
+                return false;
+            }
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QProcess>
+
+#include "ctags.h"
+
+namespace mote
+{
+    class TagWorker : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        TagWorker( QObject* parent = 0 );
+        virtual ~TagWorker();
+
+    public slots:
+        void generate( int requestId, const QString& fileName, const QByteArray& content );
+
+    signals:
+        void finished( int requestId, bool ok, const mote::CTags& tags );
+
+    private:
+        bool isInteractiveSupported( void );
+        bool startInteractive( void );
+        void stopInteractive( void );
+        bool readJsonLine( QByteArray& line );
+        bool generateInteractive( const QString& fileName, const QByteArray& content, CTags& tags );
+
+    private:
+        enum InteractiveSupport
+        {
+            InteractiveUnknown,
+            InteractiveSupported,
+            InteractiveUnsupported
+        };
+
+        InteractiveSupport m_interactiveSupport;
+        QProcess* m_process;
+    };
+}
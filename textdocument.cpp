@@ -4,13 +4,407 @@
 #include <QPlainTextDocumentLayout>
 #include <QRegExp>
 #include <QTextBlock>
+#include <QTextBlockFormat>
+#include <QTextOption>
 #include <QTextStream>
 #include <QUrl>
+#include <QtConcurrent>
 
+#include <algorithm>
+
+#include "blockdata.h"
 #include "cppsyntaxhighlighter.h"
+#include "formatterprofiles.h"
 
 namespace mote
 {
+    namespace
+    {
+        // Edits far apart are kept as separate ranges up to this count;
+        // beyond it they are folded into one.
+        const int MaxModifiedRangeCount = 256;
+
+        // A scope is looked for this many lines around an edit at most;
+        // past that only the edited lines themselves are formatted.
+        const int MaxScopeLineCount = 1000;
+        const int MaxScopeHeadLineCount = 8;
+
+        // Lines longer than this are cut into blocks of LongLineBlockLength
+        // characters, each laid out on its own, and joined again on save.
+        const int LongLineThreshold = 16384;
+        const int LongLineBlockLength = 1024;
+
+        // Continuation blocks carry an id of their own in their block
+        // format, which undo restores along with the block. A block made
+        // by a new line typed in a continuation inherits the id of the
+        // block it was split from, which tells it apart as a line of its
+        // own.
+        const int ContinuationProperty = QTextFormat::UserProperty + 1;
+
+        struct LineRange
+        {
+            int first;
+            int last;
+        };
+
+        bool lessLineRange( const LineRange& range1, const LineRange& range2 )
+        {
+            return range1.first < range2.first;
+        }
+
+        bool lessPosition( const QTextCursor& cursor1, const QTextCursor& cursor2 )
+        {
+            return cursor1.selectionStart() < cursor2.selectionStart();
+        }
+
+        // Runs on a worker thread; AStyle only sees copies of the text.
+        QList<SourceFormatter::Result> formatTexts( const SourceFormatter& formatter, const QStringList& texts )
+        {
+            QList<SourceFormatter::Result> results;
+            for( int i = 0; i < texts.size(); ++i )
+            {
+                results += formatter.formatEdits( texts.at( i ) );
+            }
+            return results;
+        }
+
+        bool isSourceFile( const QString& filePath )
+        {
+            return filePath.endsWith( ".cpp" ) ||
+                   filePath.endsWith( ".cc" ) ||
+                   filePath.endsWith( ".c" ) ||
+                   filePath.endsWith( ".h" ) ||
+                   filePath.endsWith( ".hpp" ) ||
+                   filePath.endsWith( ".inl" );
+        }
+
+        // The braces of a line outside of literals and comments. Block
+        // comments spanning several lines are not followed.
+        QString bracesOf( const QString& text )
+        {
+            QString braces;
+            QChar quote;
+            for( int i = 0; i < text.length(); ++i )
+            {
+                const QChar ch = text.at( i );
+                if( !quote.isNull() )
+                {
+                    if( ch == '\\' )
+                    {
+                        ++i;
+                    }
+                    else if( ch == quote )
+                    {
+                        quote = QChar();
+                    }
+                }
+                else if( ( ch == '"' ) || ( ch == '\'' ) )
+                {
+                    quote = ch;
+                }
+                else if( ( ch == '/' ) && ( i + 1 < text.length() ) && ( text.at( i + 1 ) == '/' ) )
+                {
+                    break;
+                }
+                else if( ( ch == '/' ) && ( i + 1 < text.length() ) && ( text.at( i + 1 ) == '*' ) )
+                {
+                    const int end = text.indexOf( "*/", i + 2 );
+                    if( end < 0 )
+                    {
+                        break;
+                    }
+                    i = end + 1;
+                }
+                else if( ( ch == '{' ) || ( ch == '}' ) )
+                {
+                    braces += ch;
+                }
+            }
+            return braces;
+        }
+
+        // With style=break the declaration of a scope sits on the lines
+        // above its opening brace.
+        QTextBlock scopeHead( const QTextBlock& block )
+        {
+            QTextBlock head = block;
+            if( !block.text().trimmed().startsWith( '{' ) )
+            {
+                return head;
+            }
+
+            for( int i = 0; i < MaxScopeHeadLineCount; ++i )
+            {
+                const QTextBlock previous = head.previous();
+                if( !previous.isValid() )
+                {
+                    break;
+                }
+
+                const QString text = previous.text().trimmed();
+                if( text.isEmpty() ||
+                    text.startsWith( '#' ) ||
+                    text.startsWith( "//" ) ||
+                    text.endsWith( "*/" ) ||
+                    text.endsWith( ';' ) ||
+                    text.endsWith( '{' ) ||
+                    text.endsWith( '}' ) ||
+                    ( text.endsWith( ':' ) && !text.endsWith( "::" ) ) )
+                {
+                    break;
+                }
+                head = previous;
+            }
+            return head;
+        }
+
+        // Finds a string or a regular expression in the text of one line
+        // as QTextDocument::find() does in the text of one block.
+        class LineSearch
+        {
+        public:
+            LineSearch( const QString& text, const QTextDocument::FindFlags flags )
+                : m_text( text ),
+                  m_regExp( false ),
+                  m_flags( flags )
+            {
+            }
+
+            LineSearch( const QRegExp& expr, const QTextDocument::FindFlags flags )
+                : m_expr( expr ),
+                  m_regExp( true ),
+                  m_flags( flags )
+            {
+                m_expr.setCaseSensitivity(
+                    ( flags & QTextDocument::FindCaseSensitively ) ? Qt::CaseSensitive : Qt::CaseInsensitive );
+            }
+
+        public:
+            bool isBackward( void )const
+            {
+                return m_flags & QTextDocument::FindBackward;
+            }
+
+            // The first match starting at offset or after it, or the last
+            // one starting at offset or before it; -1 if there is none.
+            int indexIn( const QString& line, int offset, int* length )const
+            {
+                const Qt::CaseSensitivity cs =
+                    ( m_flags & QTextDocument::FindCaseSensitively ) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+                while( ( offset >= 0 ) && ( offset <= line.length() ) )
+                {
+                    int index;
+                    if( m_regExp )
+                    {
+                        index = isBackward() ? m_expr.lastIndexIn( line, offset ) : m_expr.indexIn( line, offset );
+                        *length = m_expr.matchedLength();
+                    }
+                    else
+                    {
+                        index = isBackward() ? line.lastIndexOf( m_text, offset, cs ) : line.indexOf( m_text, offset, cs );
+                        *length = m_text.length();
+                    }
+                    if( index < 0 )
+                    {
+                        return -1;
+                    }
+
+                    const int end = index + *length;
+                    if( !( m_flags & QTextDocument::FindWholeWords ) ||
+                        ( ( ( index == 0 ) || !line.at( index - 1 ).isLetterOrNumber() ) &&
+                          ( ( end == line.length() ) || !line.at( end ).isLetterOrNumber() ) ) )
+                    {
+                        return index;
+                    }
+                    offset = isBackward() ? index - 1 : index + 1;
+                }
+                return -1;
+            }
+
+        private:
+            QString m_text;
+            mutable QRegExp m_expr;
+            bool m_regExp;
+            QTextDocument::FindFlags m_flags;
+        };
+
+        // Searches line by line, a line being a block together with its
+        // continuation blocks, so that matches across the cuts are found.
+        QTextCursor findInLines( const QTextDocument* document, const LineSearch& search, const QTextCursor& cursor )
+        {
+            int position = 0;
+            if( !cursor.isNull() )
+            {
+                position = search.isBackward() ? cursor.selectionStart() : cursor.selectionEnd();
+            }
+
+            QTextBlock block = document->findBlock( position );
+            while( TextDocument::isContinuation( block ) )
+            {
+                block = block.previous();
+            }
+
+            bool first = true;
+            while( block.isValid() )
+            {
+                QString line;
+                QVector<int> offsets;
+                QVector<int> positions;
+                QTextBlock last = block;
+                for( QTextBlock it = block;
+                     it.isValid() && ( ( it == block ) || TextDocument::isContinuation( it ) );
+                     it = it.next() )
+                {
+                    offsets += line.length();
+                    positions += it.position();
+                    line += it.text();
+                    last = it;
+                }
+
+                int offset = search.isBackward() ? line.length() : 0;
+                if( first )
+                {
+                    const int index =
+                        std::upper_bound( positions.begin(), positions.end(), position ) - positions.begin() - 1;
+                    offset = offsets.at( index ) + position - positions.at( index );
+                    if( search.isBackward() )
+                    {
+                        --offset;
+                    }
+                    first = false;
+                }
+
+                int length = 0;
+                const int index = search.indexIn( line, offset, &length );
+                if( index >= 0 )
+                {
+                    const int ends[2] = { index, index + length };
+                    int found[2];
+                    for( int i = 0; i < 2; ++i )
+                    {
+                        const int k = std::upper_bound( offsets.begin(), offsets.end(), ends[i] ) - offsets.begin() - 1;
+                        found[i] = positions.at( k ) + ends[i] - offsets.at( k );
+                    }
+
+                    QTextCursor textCursor( const_cast<QTextDocument*>( document ) );
+                    textCursor.setPosition( found[0] );
+                    textCursor.setPosition( found[1], QTextCursor::KeepAnchor );
+                    return textCursor;
+                }
+
+                if( search.isBackward() )
+                {
+                    block = block.previous();
+                    while( TextDocument::isContinuation( block ) )
+                    {
+                        block = block.previous();
+                    }
+                }
+                else
+                {
+                    block = last.next();
+                }
+            }
+            return QTextCursor();
+        }
+
+        // Nothing but spaces and tabs, as the indenter sees it.
+        bool isBlank( const QString& text )
+        {
+            for( int i = 0; i < text.length(); ++i )
+            {
+                if( ( text.at( i ) != ' ' ) && ( text.at( i ) != '\t' ) )
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool isNamespaceScope( const QTextBlock& head, const QTextBlock& block )
+        {
+            static const QRegExp keyword( "\\b(namespace|extern)\\b" );
+
+            QString text;
+            for( QTextBlock it = head; it.isValid(); it = it.next() )
+            {
+                text += it.text();
+                text += ' ';
+                if( it == block )
+                {
+                    break;
+                }
+            }
+            return keyword.indexIn( text ) >= 0;
+        }
+
+        // The outermost scope around a line short of a namespace, that is
+        // the function or class the line belongs to. AStyle needs nothing
+        // outside of it to indent it correctly.
+        bool findScope( const QTextDocument* document, const int line, LineRange& range )
+        {
+            QTextBlock scopeBlock;
+            int scopeBrace = -1;
+
+            int depth = 0;
+            QTextBlock block = document->findBlockByNumber( line );
+            for( int count = 0; block.isValid() && ( count < MaxScopeLineCount ); ++count )
+            {
+                const QString braces = bracesOf( block.text() );
+                for( int i = braces.length() - 1; i >= 0; --i )
+                {
+                    if( braces.at( i ) == '}' )
+                    {
+                        ++depth;
+                    }
+                    else if( depth > 0 )
+                    {
+                        --depth;
+                    }
+                    else if( isNamespaceScope( scopeHead( block ), block ) )
+                    {
+                        block = QTextBlock();
+                        break;
+                    }
+                    else
+                    {
+                        scopeBlock = block;
+                        scopeBrace = i;
+                    }
+                }
+                if( block.isValid() )
+                {
+                    block = block.previous();
+                }
+            }
+            if( !scopeBlock.isValid() )
+            {
+                return false;
+            }
+
+            depth = 0;
+            block = scopeBlock;
+            int brace = scopeBrace;
+            for( int count = 0; block.isValid() && ( count < MaxScopeLineCount ); ++count )
+            {
+                const QString braces = bracesOf( block.text() );
+                for( ; brace < braces.length(); ++brace )
+                {
+                    depth += ( braces.at( brace ) == '{' ) ? 1 : -1;
+                    if( depth == 0 )
+                    {
+                        range.first = scopeHead( scopeBlock ).blockNumber();
+                        range.last = block.blockNumber();
+                        return true;
+                    }
+                }
+                block = block.next();
+                brace = 0;
+            }
+            return false;
+        }
+    }
+
     TextDocument::TextDocument( QObject* parent )
         : QTextDocument( parent ),
           m_readOnly( false ),
@@ -21,13 +415,40 @@ namespace mote
 #else
           m_newlineChar( "\n" ),
 #endif
-          m_syntaxHighlighter( NULL )
+          m_syntaxHighlighter( NULL ),
+          m_editRevision( 0 ),
+          m_formatterProfiles( NULL ),
+          m_sourceFormatterRevision( -1 ),
+          m_formatRevision( -1 ),
+          m_formatPending( false ),
+          m_longLineMode( false ),
+          m_continuationBlocksValid( false ),
+          m_continuationBlockCount( 0 ),
+          m_completionIndex( NULL ),
+          m_openParensValidCount( 0 )
     {
         setDocumentLayout( new QPlainTextDocumentLayout( this ) );
 
+        // The views never wrap lines; agreeing on it up front keeps
+        // attaching one from invalidating the layout of every block.
+        QTextOption textOption = defaultTextOption();
+        textOption.setWrapMode( QTextOption::NoWrap );
+        setDefaultTextOption( textOption );
+
         connect(
             this, SIGNAL( filePathChanged( TextDocument* ) ),
             SLOT( onFilePathChanged( void ) ) );
+        connect(
+            this, SIGNAL( contentsChange( int, int, int ) ),
+            SLOT( onContentsChange( int, int, int ) ) );
+        connect(
+            &m_formatWatcher, SIGNAL( finished() ),
+            SLOT( onFormatModifiedLinesFinished( void ) ) );
+    }
+
+    TextDocument::~TextDocument()
+    {
+        m_wordIndex.clear( this );
     }
 
     QString TextDocument::filePath( void )const
@@ -84,8 +505,9 @@ namespace mote
         }
         else
         {
-            setPlainText( codec->toUnicode( m_data ) );
+            setContents( codec->toUnicode( m_data ) );
             setModified( false );
+            m_modifiedRanges.clear();
             m_textCodec = codec;
         }
 
@@ -107,6 +529,414 @@ namespace mote
         }
     }
 
+    int TextDocument::editRevision( void )const
+    {
+        return m_editRevision;
+    }
+
+    void TextDocument::setFormatterProfiles( const FormatterProfiles* profiles )
+    {
+        m_formatterProfiles = profiles;
+        m_sourceFormatterRevision = -1;
+    }
+
+    SourceFormatter TextDocument::sourceFormatter( const int indentWidth )const
+    {
+        if( !m_formatterProfiles )
+        {
+            return SourceFormatter( indentWidth );
+        }
+
+        // Resolved again only when the file moves, the profiles change, or
+        // the style file that applies is made, edited or removed.
+        const QString styleFile = m_formatterProfiles->styleFile( filePath() );
+        const QDateTime styleFileModified =
+            styleFile.isEmpty() ? QDateTime() : QFileInfo( styleFile ).lastModified();
+        if( ( m_sourceFormatterRevision != m_formatterProfiles->revision() ) ||
+            ( m_sourceFormatter.indentWidth() != indentWidth ) ||
+            ( m_sourceFormatterStyleFile != styleFile ) ||
+            ( m_sourceFormatterStyleFileModified != styleFileModified ) )
+        {
+            m_sourceFormatter = m_formatterProfiles->formatter( filePath(), indentWidth );
+            m_sourceFormatterRevision = m_formatterProfiles->revision();
+            m_sourceFormatterStyleFile = styleFile;
+            m_sourceFormatterStyleFileModified = styleFileModified;
+        }
+        return m_sourceFormatter;
+    }
+
+    bool TextDocument::isLongLineMode( void )const
+    {
+        return m_longLineMode;
+    }
+
+    int TextDocument::lineCount( void )const
+    {
+        updateContinuationBlocks();
+        return blockCount() - m_continuationBlocks.size();
+    }
+
+    // The line of the file a block belongs to, counted from zero.
+    int TextDocument::lineNumber( const QTextBlock& block )const
+    {
+        updateContinuationBlocks();
+        const int blockNumber = block.blockNumber();
+        const int count =
+            std::upper_bound( m_continuationBlocks.begin(), m_continuationBlocks.end(), blockNumber ) -
+            m_continuationBlocks.begin();
+        return blockNumber - count;
+    }
+
+    QTextBlock TextDocument::findBlockByLineNumber( const int lineNumber )const
+    {
+        updateContinuationBlocks();
+
+        // Blocks before the line's first block holding no continuation of
+        // their own number lineNumber; find the first block past them.
+        int low = 0;
+        int high = m_continuationBlocks.size();
+        while( low < high )
+        {
+            const int middle = ( low + high ) / 2;
+            if( m_continuationBlocks.at( middle ) - middle <= lineNumber )
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        return findBlockByNumber( lineNumber + low );
+    }
+
+    bool TextDocument::isContinuation( const QTextBlock& block )
+    {
+        const QTextBlock previous = block.previous();
+        if( !previous.isValid() )
+        {
+            return false;
+        }
+
+        const int id = block.blockFormat().intProperty( ContinuationProperty );
+        return ( id != 0 ) && ( id != previous.blockFormat().intProperty( ContinuationProperty ) );
+    }
+
+    QString TextDocument::plainText( void )const
+    {
+        return text( 0, characterCount() - 1 );
+    }
+
+    // The text between two positions as the file holds it: lines end in
+    // '\n' and continuation blocks are joined to the line they continue.
+    QString TextDocument::text( const int start, const int end )const
+    {
+        QString str;
+        for( QTextBlock block = findBlock( start ); block.isValid() && ( block.position() <= end ); )
+        {
+            const int position = block.position();
+            const int from = qMax( start, position ) - position;
+            const int to = qMin( end, position + block.length() - 1 ) - position;
+            str += block.text().mid( from, to - from );
+
+            block = block.next();
+            if( block.isValid() && ( block.position() <= end ) && !isContinuation( block ) )
+            {
+                str += '\n';
+            }
+        }
+        return str;
+    }
+
+    // The position offset characters of text() past position.
+    int TextDocument::advance( const int position, const int offset )const
+    {
+        if( !m_longLineMode )
+        {
+            return position + offset;
+        }
+
+        int current = position;
+        int remaining = offset;
+        for( QTextBlock block = findBlock( position ); block.isValid(); )
+        {
+            const int room = block.position() + block.length() - 1 - current;
+            if( remaining <= room )
+            {
+                break;
+            }
+            remaining -= room;
+
+            block = block.next();
+            if( !block.isValid() )
+            {
+                current += room;
+                remaining = 0;
+                break;
+            }
+            if( !isContinuation( block ) )
+            {
+                --remaining;
+            }
+            current = block.position();
+        }
+        return current + remaining;
+    }
+
+    // QTextDocument::find() searches block by block and would miss what
+    // spans the cut between a block and its continuation.
+    QTextCursor TextDocument::findText(
+        const QString& text,
+        const QTextCursor& cursor,
+        const QTextDocument::FindFlags flags )const
+    {
+        if( !m_longLineMode )
+        {
+            return find( text, cursor, flags );
+        }
+        return findInLines( this, LineSearch( text, flags ), cursor );
+    }
+
+    QTextCursor TextDocument::findText(
+        const QRegExp& expr,
+        const QTextCursor& cursor,
+        const QTextDocument::FindFlags flags )const
+    {
+        if( !m_longLineMode )
+        {
+            return find( expr, cursor, flags );
+        }
+        return findInLines( this, LineSearch( expr, flags ), cursor );
+    }
+
+    bool TextDocument::hasWordIndex( void )const
+    {
+        return m_wordIndex.isBuilt();
+    }
+
+    // Built on first use; from then on kept up to date edit by edit.
+    WordIndex* TextDocument::wordIndex( void )
+    {
+        if( !m_wordIndex.isBuilt() )
+        {
+            m_wordIndex.build( this );
+        }
+        return &m_wordIndex;
+    }
+
+    void TextDocument::setCompletionIndex( CompletionIndex* completionIndex )
+    {
+        m_completionIndex = completionIndex;
+    }
+
+    CompletionIndex* TextDocument::completionIndex( void )const
+    {
+        return m_completionIndex;
+    }
+
+    // The parentheses open at the end of block, carried from block to block
+    // through what the highlighter recorded.
+    QVector<BlockData::Paren> TextDocument::openParens( const QTextBlock& block )const
+    {
+        if( !block.isValid() )
+        {
+            return QVector<BlockData::Paren>();
+        }
+
+        propagateBlocks( block );
+        const BlockData* data = BlockData::find( block );
+        return data ? data->openParens() : QVector<BlockData::Paren>();
+    }
+
+    // The last block up to block that is not blank, or an invalid block.
+    QTextBlock TextDocument::lastNonBlankBlock( const QTextBlock& block )const
+    {
+        if( !block.isValid() )
+        {
+            return QTextBlock();
+        }
+
+        propagateBlocks( block );
+        const BlockData* data = BlockData::find( block );
+        return ( data && ( data->lastNonBlank() >= 0 ) ) ? findBlockByNumber( data->lastNonBlank() ) : QTextBlock();
+    }
+
+    // Carries the open parentheses and the last non-blank block from block
+    // to block as far as block. Results are kept in the blocks up to the
+    // first one edited since, so asking about the lines being typed costs
+    // a block or two. The first query walks from the start of the document
+    // and gives every block up to it its data; that cost is amortised over
+    // the queries after it, which go on from where it stopped.
+    void TextDocument::propagateBlocks( const QTextBlock& block )const
+    {
+        const int blockNumber = block.blockNumber();
+        if( blockNumber < m_openParensValidCount )
+        {
+            return;
+        }
+
+        QVector<BlockData::Paren> parens;
+        int lastNonBlank = -1;
+        QTextBlock current = begin();
+        if( m_openParensValidCount > 0 )
+        {
+            const QTextBlock last = findBlockByNumber( m_openParensValidCount - 1 );
+            const BlockData* data = BlockData::find( last );
+            if( data )
+            {
+                parens = data->openParens();
+                lastNonBlank = data->lastNonBlank();
+            }
+            current = last.next();
+        }
+
+        for( ; current.isValid(); current = current.next() )
+        {
+            const BlockData* data = BlockData::find( current );
+            if( data && data->syntax().valid )
+            {
+                const BlockData::Syntax& syntax = data->syntax();
+                parens.resize( qMax( parens.size() - syntax.parenCloseCount, 0 ) );
+                for( int i = 0; i < syntax.parenColumns.size(); ++i )
+                {
+                    BlockData::Paren paren;
+                    paren.blockNumber = current.blockNumber();
+                    paren.column = syntax.parenColumns.at( i );
+                    parens += paren;
+                }
+            }
+            if( !isBlank( current.text() ) )
+            {
+                lastNonBlank = current.blockNumber();
+            }
+
+            BlockData* currentData = BlockData::get( current );
+            currentData->setOpenParens( parens );
+            currentData->setLastNonBlank( lastNonBlank );
+
+            if( current == block )
+            {
+                break;
+            }
+        }
+        m_openParensValidCount = blockNumber + 1;
+    }
+
+    // Drops what is kept only for drawing: the line layouts and markers of
+    // every block. They are made again for the blocks painted next.
+    void TextDocument::releaseLayouts( void )
+    {
+        for( QTextBlock block = begin(); block.isValid(); block = block.next() )
+        {
+            block.clearLayout();
+            BlockData* data = BlockData::find( block );
+            if( data )
+            {
+                data->invalidate();
+            }
+        }
+    }
+
+    bool TextDocument::hasModifiedRanges( void )const
+    {
+        return !m_modifiedRanges.isEmpty();
+    }
+
+    // Formats the modified lines on a worker thread. Returns false if
+    // there is nothing to format; otherwise modifiedLinesFormatted() is
+    // emitted once the result has been applied, or dropped because the
+    // text has been edited meanwhile.
+    bool TextDocument::startFormatModifiedLines( const int indentWidth )
+    {
+        if( m_formatPending )
+        {
+            return true;
+        }
+        if( m_modifiedRanges.isEmpty() || !isSourceFile( filePath() ) )
+        {
+            return false;
+        }
+
+        // Each edit is widened to its enclosing scope; only those go to
+        // AStyle, so the cost follows the size of the edits. An edit in a
+        // scope already found is not looked at again.
+        QList<QTextCursor> modifiedRanges = m_modifiedRanges;
+        std::sort( modifiedRanges.begin(), modifiedRanges.end(), lessPosition );
+        QVector<LineRange> ranges;
+        for( int i = 0; i < modifiedRanges.size(); ++i )
+        {
+            const QTextCursor& modifiedRange = modifiedRanges.at( i );
+            LineRange range;
+            range.first = findBlock( modifiedRange.selectionStart() ).blockNumber();
+            range.last = findBlock( modifiedRange.selectionEnd() ).blockNumber();
+            if( !ranges.isEmpty() && ( range.last <= ranges.last().last ) )
+            {
+                continue;
+            }
+
+            // The scope of the first line often holds the last one too.
+            bool covered = false;
+            LineRange scope;
+            if( findScope( this, range.first, scope ) )
+            {
+                covered = scope.last >= range.last;
+                range.first = qMin( range.first, scope.first );
+                range.last = qMax( range.last, scope.last );
+            }
+            if( !covered && findScope( this, range.last, scope ) )
+            {
+                range.first = qMin( range.first, scope.first );
+                range.last = qMax( range.last, scope.last );
+            }
+            ranges += range;
+        }
+
+        std::sort( ranges.begin(), ranges.end(), lessLineRange );
+        QVector<LineRange> mergedRanges;
+        for( int i = 0; i < ranges.size(); ++i )
+        {
+            if( !mergedRanges.isEmpty() && ( ranges.at( i ).first <= mergedRanges.last().last + 1 ) )
+            {
+                mergedRanges.last().last = qMax( mergedRanges.last().last, ranges.at( i ).last );
+            }
+            else
+            {
+                mergedRanges += ranges.at( i );
+            }
+        }
+
+        QStringList texts;
+        m_formatStarts.clear();
+        for( int i = 0; i < mergedRanges.size(); ++i )
+        {
+            const QTextBlock firstBlock = findBlockByNumber( mergedRanges.at( i ).first );
+            const QTextBlock lastBlock = findBlockByNumber( mergedRanges.at( i ).last );
+            const int start = firstBlock.position();
+            m_formatStarts += start;
+            texts += text( start, lastBlock.position() + lastBlock.length() - 1 );
+        }
+
+        m_formatRevision = m_editRevision;
+        m_formatPending = true;
+        m_formatWatcher.setFuture( QtConcurrent::run( &formatTexts, sourceFormatter( indentWidth ), texts ) );
+        return true;
+    }
+
+    bool TextDocument::isFormattingModifiedLines( void )const
+    {
+        return m_formatPending;
+    }
+
+    // For when the document is about to go away.
+    void TextDocument::waitForFormatModifiedLines( void )
+    {
+        if( m_formatPending )
+        {
+            m_formatWatcher.waitForFinished();
+            onFormatModifiedLinesFinished();
+        }
+    }
+
     bool TextDocument::openFile( const QString& path )
     {
         bool readOnly = false;
@@ -150,9 +980,10 @@ namespace mote
         setMetaInformation( QTextDocument::DocumentUrl, QUrl::fromLocalFile( path ).toString() );
         m_generateBOM = bomExists;
 
-        setPlainText( str );
+        setContents( str );
         setModified( false );
         clearUndoRedoStacks();
+        m_modifiedRanges.clear();
 
         emit textCodecChanged( this );
         if( filePath() != oldFilePath )
@@ -167,23 +998,10 @@ namespace mote
 
     bool TextDocument::saveFile( const QString& path )
     {
-        QString str;
-        QTextBlock block = begin();
-        if( block.isValid() )
+        QString str = plainText();
+        if( m_newlineChar != "\n" )
         {
-            while( true )
-            {
-                str += block.text();
-                block = block.next();
-                if( block.isValid() )
-                {
-                    str += m_newlineChar;
-                }
-                else
-                {
-                    break;
-                }
-            }
+            str.replace( '\n', m_newlineChar );
         }
 
         const QByteArray data = m_textCodec->fromUnicode( str );
@@ -210,6 +1028,7 @@ namespace mote
         }
 
         setModified( false );
+        m_modifiedRanges.clear();
 
         return true;
     }
@@ -342,20 +1161,304 @@ namespace mote
         }
     }
 
+    void TextDocument::addModifiedRange( int start, int end )
+    {
+        end = qMin( end, characterCount() - 1 );
+
+        // Cursors move along with later edits, so the ranges stay right
+        // until the next save.
+        for( int i = 0; i < m_modifiedRanges.size(); ++i )
+        {
+            QTextCursor& range = m_modifiedRanges[i];
+            if( ( range.selectionStart() <= end ) && ( start <= range.selectionEnd() ) )
+            {
+                const int rangeEnd = qMax( end, range.selectionEnd() );
+                range.setPosition( qMin( start, range.selectionStart() ) );
+                range.setPosition( rangeEnd, QTextCursor::KeepAnchor );
+                return;
+            }
+        }
+
+        if( m_modifiedRanges.size() >= MaxModifiedRangeCount )
+        {
+            for( int i = 0; i < m_modifiedRanges.size(); ++i )
+            {
+                start = qMin( start, m_modifiedRanges.at( i ).selectionStart() );
+                end = qMax( end, m_modifiedRanges.at( i ).selectionEnd() );
+            }
+            m_modifiedRanges.clear();
+        }
+
+        QTextCursor range( this );
+        range.setPosition( start );
+        range.setPosition( end, QTextCursor::KeepAnchor );
+        m_modifiedRanges += range;
+    }
+
+    void TextDocument::setContents( const QString& str )
+    {
+        QString text;
+        QVector<int> continuations;
+        int lineCount = 0;
+        int start = 0;
+        while( start <= str.length() )
+        {
+            int end = str.indexOf( '\n', start );
+            if( end < 0 )
+            {
+                end = str.length();
+            }
+
+            int contentEnd = end;
+            if( ( contentEnd > start ) && ( str.at( contentEnd - 1 ) == '\r' ) )
+            {
+                --contentEnd;
+            }
+
+            if( contentEnd - start > LongLineThreshold )
+            {
+                if( continuations.isEmpty() )
+                {
+                    text.reserve( str.length() + str.length() / LongLineBlockLength + 1 );
+                    text += str.leftRef( start );
+                }
+
+                int position = start;
+                while( contentEnd - position > LongLineBlockLength )
+                {
+                    int next = position + LongLineBlockLength;
+                    if( str.at( next - 1 ).isHighSurrogate() )
+                    {
+                        --next;
+                    }
+                    text += str.midRef( position, next - position );
+                    text += '\n';
+                    continuations += ++lineCount;
+                    position = next;
+                }
+                text += str.midRef( position, qMin( end + 1, str.length() ) - position );
+            }
+            else if( !continuations.isEmpty() )
+            {
+                text += str.midRef( start, qMin( end + 1, str.length() ) - start );
+            }
+
+            ++lineCount;
+            start = end + 1;
+        }
+
+        m_longLineMode = !continuations.isEmpty();
+        m_continuationBlocksValid = false;
+        setPlainText( m_longLineMode ? text : str );
+        if( !m_longLineMode )
+        {
+            return;
+        }
+
+        // Marking the blocks is part of loading, not an edit to undo.
+        const bool undoRedoEnabled = isUndoRedoEnabled();
+        setUndoRedoEnabled( false );
+        QTextCursor cursor( this );
+        cursor.beginEditBlock();
+        int index = 0;
+        for( QTextBlock block = begin(); block.isValid() && ( index < continuations.size() ); block = block.next() )
+        {
+            if( block.blockNumber() == continuations.at( index ) )
+            {
+                QTextBlockFormat format;
+                format.setProperty( ContinuationProperty, ++index );
+                cursor.setPosition( block.position() );
+                cursor.setBlockFormat( format );
+            }
+        }
+        cursor.endEditBlock();
+        setUndoRedoEnabled( undoRedoEnabled );
+    }
+
+    void TextDocument::updateContinuationBlocks( void )const
+    {
+        if( m_continuationBlocksValid )
+        {
+            return;
+        }
+
+        // Made once after loading; edits keep it up to date from then on.
+        // Without long lines there is nothing to look for.
+        m_continuationBlocks.clear();
+        if( m_longLineMode )
+        {
+            for( QTextBlock block = begin(); block.isValid(); block = block.next() )
+            {
+                if( isContinuation( block ) )
+                {
+                    m_continuationBlocks += block.blockNumber();
+                }
+            }
+        }
+        m_continuationBlockCount = blockCount();
+        m_continuationBlocksValid = true;
+    }
+
+    // Only the blocks of an edit and the one after it, which continues the
+    // last of them or not, are looked at again; the blocks after those
+    // keep their flags and move by the number of blocks added.
+    void TextDocument::moveContinuationBlocks( const int position, const int charsAdded )
+    {
+        if( !m_continuationBlocksValid )
+        {
+            return;
+        }
+
+        const int first = findBlock( position ).blockNumber();
+        const int last = qMin( findBlock( position + charsAdded ).blockNumber() + 1, blockCount() - 1 );
+        const int delta = blockCount() - m_continuationBlockCount;
+        m_continuationBlockCount = blockCount();
+
+        QVector<int> blocks;
+        QTextBlock block = findBlockByNumber( first );
+        for( int number = first; block.isValid() && ( number <= last ); ++number )
+        {
+            if( isContinuation( block ) )
+            {
+                blocks += number;
+            }
+            block = block.next();
+        }
+
+        const int index =
+            std::lower_bound( m_continuationBlocks.begin(), m_continuationBlocks.end(), first ) -
+            m_continuationBlocks.begin();
+        const int end =
+            std::upper_bound( m_continuationBlocks.begin(), m_continuationBlocks.end(), last - delta ) -
+            m_continuationBlocks.begin();
+        m_continuationBlocks.remove( index, end - index );
+        for( int i = index; i < m_continuationBlocks.size(); ++i )
+        {
+            m_continuationBlocks[i] += delta;
+        }
+        for( int i = 0; i < blocks.size(); ++i )
+        {
+            m_continuationBlocks.insert( index + i, blocks.at( i ) );
+        }
+    }
+
+    // Drops the caches of the edited blocks and of the block before them,
+    // whose line end marker depends on what follows it.
+    void TextDocument::updateBlocks( const int position, const int charsAdded )
+    {
+        const QTextBlock firstBlock = findBlock( position );
+        BlockData* previousData = BlockData::find( firstBlock.previous() );
+        if( previousData )
+        {
+            previousData->invalidate();
+        }
+
+        const QTextBlock lastBlock = findBlock( position + charsAdded );
+        for( QTextBlock block = firstBlock; block.isValid(); block = block.next() )
+        {
+            BlockData* data = BlockData::find( block );
+            if( data )
+            {
+                data->invalidate();
+            }
+            if( m_wordIndex.isBuilt() )
+            {
+                m_wordIndex.updateBlock( block );
+            }
+            if( block == lastBlock )
+            {
+                break;
+            }
+        }
+    }
+
+    void TextDocument::onFormatModifiedLinesFinished( void )
+    {
+        // waitForFormatModifiedLines() may have taken the result already.
+        if( !m_formatPending )
+        {
+            return;
+        }
+        m_formatPending = false;
+
+        const QList<SourceFormatter::Result> results = m_formatWatcher.result();
+        if( ( m_editRevision == m_formatRevision ) && ( results.size() == m_formatStarts.size() ) )
+        {
+            // Back to front, so that the ranges not yet formatted stay put.
+            QTextCursor textCursor( this );
+            textCursor.beginEditBlock();
+            for( int i = results.size() - 1; i >= 0; --i )
+            {
+                const SourceFormatter::Result& result = results.at( i );
+                if( !result.ok )
+                {
+                    continue;
+                }
+
+                const int start = m_formatStarts.at( i );
+                for( int j = result.edits.size() - 1; j >= 0; --j )
+                {
+                    const SourceFormatter::Edit& edit = result.edits.at( j );
+                    textCursor.setPosition( advance( start, edit.position ) );
+                    textCursor.setPosition( advance( start, edit.position + edit.length ), QTextCursor::KeepAnchor );
+                    textCursor.insertText( edit.text );
+                }
+            }
+            textCursor.endEditBlock();
+        }
+
+        emit modifiedLinesFormatted( this );
+    }
+
     void TextDocument::onFilePathChanged( void )
     {
-        delete m_syntaxHighlighter;
-        m_syntaxHighlighter = NULL;
+        m_sourceFormatterRevision = -1;
+        m_openParensValidCount = 0;
+
+        // What the old highlighter recorded would keep smart indenting on
+        // for a file that is no longer C++.
+        if( m_syntaxHighlighter )
+        {
+            delete m_syntaxHighlighter;
+            m_syntaxHighlighter = NULL;
+
+            for( QTextBlock block = begin(); block.isValid(); block = block.next() )
+            {
+                BlockData* data = BlockData::find( block );
+                if( data )
+                {
+                    data->setSyntax( BlockData::Syntax() );
+                }
+            }
+        }
 
-        const QString filePath = this->filePath();
-        if( filePath.endsWith( ".cpp" ) ||
-            filePath.endsWith( ".cc" ) ||
-            filePath.endsWith( ".c" ) ||
-            filePath.endsWith( ".h" ) ||
-            filePath.endsWith( ".hpp" ) ||
-            filePath.endsWith( ".inl" ) )
+        if( isSourceFile( filePath() ) )
         {
             m_syntaxHighlighter = new CppSyntaxHighlighter( this );
         }
     }
+
+    void TextDocument::onContentsChange( int position, int charsRemoved, int charsAdded )
+    {
+        // Snapshots taken for background work compare this to notice edits.
+        const bool changed = ( charsRemoved > 0 ) || ( charsAdded > 0 );
+        if( changed )
+        {
+            ++m_editRevision;
+        }
+
+        if( m_longLineMode )
+        {
+            moveContinuationBlocks( position, charsAdded );
+        }
+
+        m_openParensValidCount = qMin( m_openParensValidCount, findBlock( position ).blockNumber() );
+
+        // Per-block caches describe the old text of the changed blocks.
+        if( changed )
+        {
+            addModifiedRange( position, position + charsAdded );
+        }
+        updateBlocks( position, charsAdded );
+    }
 }
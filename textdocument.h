@@ -1,13 +1,25 @@
 #pragma once
 
 #include <QByteArray>
+#include <QDateTime>
 #include <QFile>
+#include <QFutureWatcher>
+#include <QList>
 #include <QSyntaxHighlighter>
 #include <QTextCodec>
+#include <QTextCursor>
 #include <QTextDocument>
+#include <QVector>
+
+#include "blockdata.h"
+#include "sourceformatter.h"
+#include "wordindex.h"
 
 namespace mote
 {
+    class CompletionIndex;
+    class FormatterProfiles;
+
     class TextDocument : public QTextDocument
     {
         Q_OBJECT
@@ -17,6 +29,7 @@ namespace mote
 
     public:
         TextDocument( QObject* parent = 0 );
+        virtual ~TextDocument();
 
     public:
         QString filePath( void )const;
@@ -34,6 +47,43 @@ namespace mote
         bool generateByteOrderMark( void )const;
         void setGenerateByteOrderMark( const bool onoff );
 
+        int editRevision( void )const;
+
+        void setFormatterProfiles( const FormatterProfiles* profiles );
+        SourceFormatter sourceFormatter( const int indentWidth )const;
+
+        bool isLongLineMode( void )const;
+        int lineCount( void )const;
+        int lineNumber( const QTextBlock& block )const;
+        QTextBlock findBlockByLineNumber( const int lineNumber )const;
+        static bool isContinuation( const QTextBlock& block );
+
+        QString plainText( void )const;
+        QString text( const int start, const int end )const;
+        int advance( const int position, const int offset )const;
+        QTextCursor findText(
+            const QString& text,
+            const QTextCursor& cursor,
+            const QTextDocument::FindFlags flags = 0 )const;
+        QTextCursor findText(
+            const QRegExp& expr,
+            const QTextCursor& cursor,
+            const QTextDocument::FindFlags flags = 0 )const;
+
+        bool hasWordIndex( void )const;
+        WordIndex* wordIndex( void );
+        void setCompletionIndex( CompletionIndex* completionIndex );
+        CompletionIndex* completionIndex( void )const;
+
+        QVector<BlockData::Paren> openParens( const QTextBlock& block )const;
+        QTextBlock lastNonBlankBlock( const QTextBlock& block )const;
+        void releaseLayouts( void );
+
+        bool hasModifiedRanges( void )const;
+        bool startFormatModifiedLines( const int indentWidth );
+        bool isFormattingModifiedLines( void )const;
+        void waitForFormatModifiedLines( void );
+
     public:
         bool openFile( const QString& path );
         bool saveFile( const QString& path );
@@ -45,6 +95,7 @@ namespace mote
         void newlineCharacterChanged( TextDocument* textDocument );
         void textCodecChanged( TextDocument* textDocument );
         void generateByteOrderMarkChanged( TextDocument* textDocument );
+        void modifiedLinesFormatted( TextDocument* textDocument );
 
     private:
         QTextCodec* detectCodec(
@@ -52,9 +103,17 @@ namespace mote
             QByteArray& bom )const;
         QString detectNewlineCharacter( const QString& str )const;
         void writeBOM( QFile& file )const;
+        void addModifiedRange( int start, int end );
+        void setContents( const QString& str );
+        void updateContinuationBlocks( void )const;
+        void moveContinuationBlocks( const int position, const int charsAdded );
+        void updateBlocks( const int position, const int charsAdded );
+        void propagateBlocks( const QTextBlock& block )const;
 
     private slots:
         void onFilePathChanged( void );
+        void onContentsChange( int position, int charsRemoved, int charsAdded );
+        void onFormatModifiedLinesFinished( void );
 
     private:
         QByteArray m_data;
@@ -63,5 +122,23 @@ namespace mote
         QTextCodec* m_textCodec;
         QString m_newlineChar;
         QSyntaxHighlighter* m_syntaxHighlighter;
+        int m_editRevision;
+        const FormatterProfiles* m_formatterProfiles;
+        mutable SourceFormatter m_sourceFormatter;
+        mutable int m_sourceFormatterRevision;
+        mutable QString m_sourceFormatterStyleFile;
+        mutable QDateTime m_sourceFormatterStyleFileModified;
+        QList<QTextCursor> m_modifiedRanges;
+        QFutureWatcher< QList<SourceFormatter::Result> > m_formatWatcher;
+        QVector<int> m_formatStarts;
+        int m_formatRevision;
+        bool m_formatPending;
+        bool m_longLineMode;
+        mutable QVector<int> m_continuationBlocks;
+        mutable bool m_continuationBlocksValid;
+        mutable int m_continuationBlockCount;
+        WordIndex m_wordIndex;
+        CompletionIndex* m_completionIndex;
+        mutable int m_openParensValidCount;
     };
 }
@@ -1,46 +1,144 @@
 #include "textedit.h"
 
+#include <QAbstractTextDocumentLayout>
 #include <QApplication>
+#include <QClipboard>
 #include <QDragEnterEvent>
 #include <QDragMoveEvent>
 #include <QDropEvent>
 #include <QFontMetrics>
-#include <QMap>
 #include <QMimeData>
 #include <QMouseEvent>
 #include <QPainter>
+#include <QPaintEvent>
 #include <QRegExp>
+#include <QStringList>
 #include <QTextBlock>
 #include <QTextLayout>
 #include <QTextLine>
 #include <QUrl>
 #include <QVector>
 
+#include "completionindex.h"
+#include "completionmodel.h"
+#include "frameprofiler.h"
+#include "fuzzymatcher.h"
 #include "inputcompletionitemdelegate.h"
+#include "lineindenter.h"
 #include "mainwindow.h"
+#include "smartindenter.h"
 #include "textdocument.h"
+#include "textlines.h"
 
 namespace mote
 {
+    namespace
+    {
+        // Cached marker positions depend on the font and the tab stops as
+        // well as on the text; changing either in any view bumps this.
+        int markerLayoutGeneration = 0;
+
+        // How often the frame timings overlay shows new numbers, in
+        // milliseconds.
+        const int FrameTimingsInterval = 500;
+
+        // The position in block nearest to x, in layout coordinates.
+        int columnAt( const QTextBlock& block, const qreal x )
+        {
+            // Lays the block out if it has not been shown yet.
+            block.document()->documentLayout()->blockBoundingRect( block );
+            const QTextLine line = block.layout()->lineAt( 0 );
+            return line.isValid() ? line.xToCursor( x ) : 0;
+        }
+
+        // Applies the lines of newText over those of oldText, starting at
+        // position, one line at a time and only as far as they differ from
+        // the front. Replacing the blocks of a long line as a whole would
+        // lose where it is cut.
+        void replaceLineFronts(
+            TextDocument* textDocument,
+            const int position,
+            const QString& oldText,
+            const QString& newText )
+        {
+            const QStringList oldLines = oldText.split( '\n' );
+            const QStringList newLines = newText.split( '\n' );
+            const int count = qMin( oldLines.size(), newLines.size() );
+
+            QVector<int> lineStarts;
+            for( QTextBlock block = textDocument->findBlock( position );
+                 block.isValid() && ( lineStarts.size() < count );
+                 block = block.next() )
+            {
+                if( lineStarts.isEmpty() || !TextDocument::isContinuation( block ) )
+                {
+                    lineStarts += block.position();
+                }
+            }
+
+            // Back to front, so that the positions of the earlier lines
+            // stay valid.
+            QTextCursor textCursor( textDocument );
+            textCursor.beginEditBlock();
+            for( int i = lineStarts.size() - 1; i >= 0; --i )
+            {
+                const QString& oldLine = oldLines.at( i );
+                const QString& newLine = newLines.at( i );
+                int suffix = 0;
+                while( ( suffix < oldLine.length() ) && ( suffix < newLine.length() ) &&
+                       ( oldLine.at( oldLine.length() - 1 - suffix ) == newLine.at( newLine.length() - 1 - suffix ) ) )
+                {
+                    ++suffix;
+                }
+                if( ( suffix == oldLine.length() ) && ( suffix == newLine.length() ) )
+                {
+                    continue;
+                }
+
+                textCursor.setPosition( lineStarts.at( i ) );
+                textCursor.setPosition(
+                    textDocument->advance( lineStarts.at( i ), oldLine.length() - suffix ),
+                    QTextCursor::KeepAnchor );
+                textCursor.insertText( newLine.left( newLine.length() - suffix ) );
+            }
+            textCursor.endEditBlock();
+        }
+    }
+
     TextEdit::TextEdit( TextDocument* document, QWidget* parent )
         : QPlainTextEdit( parent ),
           m_lineNumberVisible( false ),
           m_lineNumberWidth( 0 ),
           m_lineNumberPixelWidth( 0 ),
           m_lineNumberWidget( NULL ),
+          m_digitWidth( 0 ),
+          m_digitAscent( 0 ),
+          m_guideLineX( 0 ),
           m_tabStopWidthBySpace( 4 ),
           m_rowSelectionBasePos( 0 ),
-          m_inputCompletionList( NULL )
+          m_rectangleAnchor( -1 ),
+          m_rectangleAnchorX( 0 ),
+          m_editingCursors( false ),
+          m_inputCompletionList( NULL ),
+          m_inputCompletionModel( NULL ),
+          m_inputCompletionDelegate( NULL ),
+          m_formatStart( 0 ),
+          m_formatRevision( 0 ),
+          m_formatRetryCount( 0 ),
+          m_formatRestart( false ),
+          m_frameTimingsWidget( NULL )
     {
         m_coBracePos[0] = -1;
         m_coBracePos[1] = -1;
 
+        // Set before the document: changing a shared document's wrap mode
+        // would throw away the layout of every block for all its views.
+        setLineWrapMode( QPlainTextEdit::NoWrap );
         setDocument( document );
         connect(
             document,
             SIGNAL( fontChanged( void ) ), SLOT( onFontChanged( void ) ) );
 
-        setLineWrapMode( QPlainTextEdit::NoWrap );
         setCursorWidth( 2 );
 
         updateTabStopWidthBySpace();
@@ -55,15 +153,29 @@ namespace mote
         connect(
             this, SIGNAL( textChanged() ),
             SLOT( onTextChanged() ) );
+        connect(
+            &m_formatWatcher, SIGNAL( finished() ),
+            SLOT( onFormattingFinished( void ) ) );
+
+        m_frameTimingsTimer.setInterval( FrameTimingsInterval );
+        connect(
+            &m_frameTimingsTimer, SIGNAL( timeout() ),
+            SLOT( updateFrameTimings( void ) ) );
     }
 
     bool TextEdit::eventFilter( QObject* watched, QEvent* event )
     {
+        if( ( watched == m_frameTimingsWidget ) && ( event->type() == QEvent::Paint ) )
+        {
+            drawFrameTimings();
+            return true;
+        }
+
         if( watched == m_lineNumberWidget )
         {
             if( event->type() == QEvent::Paint )
             {
-                drawLineNumber();
+                drawLineNumber( static_cast<QPaintEvent*>( event )->rect() );
                 return true;
             }
             else if( event->type() == QEvent::MouseButtonPress )
@@ -179,9 +291,9 @@ namespace mote
                 {
                     m_lineNumberWidget = new QWidget( this );
                     m_lineNumberWidget->installEventFilter( this );
-                    m_lineNumberWidget->connect(
+                    connect(
                         this, SIGNAL( updateRequest( const QRect&, int ) ),
-                        SLOT( update() ) );
+                        SLOT( onUpdateRequest( const QRect&, int ) ) );
                 }
                 updateViewportMargins();
                 updateLineNumberWidgetGeometry();
@@ -217,36 +329,6 @@ namespace mote
         }
     }
 
-    QList<TextEdit*> TextEdit::findEdits( TextDocument* textDocument )
-    {
-        QList<TextEdit*> edits;
-        const QWidgetList wins = QApplication::topLevelWidgets();
-        for( int i = 0; i < wins.size(); ++i )
-        {
-            const MainWindow* win = qobject_cast<MainWindow*>( wins.at( i ) );
-            if( win )
-            {
-                edits.append( win->findEdits( textDocument ) );
-            }
-        }
-        return edits;
-    }
-
-    QList<TextEdit*> TextEdit::findEdits( const QString& path )
-    {
-        QList<TextEdit*> edits;
-        const QWidgetList wins = QApplication::topLevelWidgets();
-        for( int i = 0; i < wins.size(); ++i )
-        {
-            const MainWindow* win = qobject_cast<MainWindow*>( wins.at( i ) );
-            if( win )
-            {
-                edits.append( win->findEdits( path ) );
-            }
-        }
-        return edits;
-    }
-
     void TextEdit::resizeEvent( QResizeEvent* event )
     {
         if( m_lineNumberWidget )
@@ -267,6 +349,51 @@ namespace mote
         }
     }
 
+    // Puts a cursor on every occurrence of the selection, or of the word
+    // under the cursor.
+    void TextEdit::selectAllOccurrences( void )
+    {
+        QTextCursor textCursor = this->textCursor();
+        QTextDocument::FindFlags flags = QTextDocument::FindCaseSensitively;
+        if( !textCursor.hasSelection() )
+        {
+            textCursor.select( QTextCursor::WordUnderCursor );
+            flags |= QTextDocument::FindWholeWords;
+        }
+
+        const TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+        if( !textDocument )
+        {
+            return;
+        }
+
+        const QString text = textDocument->text( textCursor.selectionStart(), textCursor.selectionEnd() );
+        if( text.isEmpty() || text.contains( '\n' ) )
+        {
+            return;
+        }
+
+        QVector<MultiCursor::Range> ranges;
+        QTextCursor found( document() );
+        for( ;; )
+        {
+            found = textDocument->findText( text, found, flags );
+            if( found.isNull() )
+            {
+                break;
+            }
+
+            MultiCursor::Range range;
+            range.anchor = found.anchor();
+            range.position = found.position();
+            ranges += range;
+        }
+
+        m_cursors.setRanges( ranges );
+        setTextCursor( textCursor );
+        viewport()->update();
+    }
+
     void TextEdit::findNext( const QString& text, const QTextDocument::FindFlags flags )
     {
         QTextCursor textCursor = _findNext( text, flags );
@@ -373,20 +500,48 @@ namespace mote
 
     void TextEdit::paintEvent( QPaintEvent* event )
     {
-        QPlainTextEdit::paintEvent( event );
+        {
+            FrameProfiler::Scope frameScope( FrameProfiler::FramePhase );
 
-        drawEOF();
-        drawNewlineCharacter();
-        drawTabCharacter();
-        drawGuideLine();
+            {
+                FrameProfiler::Scope textScope( FrameProfiler::TextPhase );
+                QPlainTextEdit::paintEvent( event );
+            }
+
+            drawMarkers( event->rect() );
+
+            if( !m_cursors.isEmpty() )
+            {
+                drawCursors( event->rect() );
+            }
+        }
+
+        if( FrameProfiler::instance()->isEnabled() && !m_frameTimingsTimer.isActive() )
+        {
+            m_frameTimingsTimer.start();
+        }
     }
 
     void TextEdit::keyPressEvent( QKeyEvent* event )
     {
+        if( !m_cursors.isEmpty() )
+        {
+            if( editCursors( event ) )
+            {
+                event->accept();
+                return;
+            }
+            clearCursors();
+        }
+
         if( event->key() == Qt::Key_Escape )
         {
             QTextCursor cursor = textCursor();
-            if( cursor.hasSelection() )
+            if( isFormatting() )
+            {
+                cancelFormatting();
+            }
+            else if( cursor.hasSelection() )
             {
                 cursor.setPosition( cursor.anchor() );
                 setTextCursor( cursor );
@@ -481,6 +636,10 @@ namespace mote
                  ( event->text() == ">" ) )
         {
             QPlainTextEdit::keyPressEvent( event );
+            if( event->text() == "}" )
+            {
+                reindentTypedLine();
+            }
             m_coBracePos[0] = textCursor().position() - 1;
             updateCoBracePos();
             updateExtraSelections();
@@ -488,32 +647,26 @@ namespace mote
         else if( ( event->key() == Qt::Key_Up ) &&
                  isInputCompletionVisible() )
         {
-            if( m_inputCompletionList->currentRow() > 0 )
-            {
-                m_inputCompletionList->setCurrentRow( m_inputCompletionList->currentRow() - 1 );
-            }
+            setInputCompletionRow( m_inputCompletionList->currentIndex().row() - 1 );
 
             event->accept();
         }
         else if( ( event->key() == Qt::Key_Down ) &&
                  isInputCompletionVisible() )
         {
-            if( m_inputCompletionList->currentRow() + 1 < m_inputCompletionList->count() )
-            {
-                m_inputCompletionList->setCurrentRow( m_inputCompletionList->currentRow() + 1 );
-            }
+            setInputCompletionRow( m_inputCompletionList->currentIndex().row() + 1 );
 
             event->accept();
         }
         else if( ( event->key() == Qt::Key_Home ) && isInputCompletionVisible() )
         {
-            m_inputCompletionList->setCurrentRow( 0 );
+            setInputCompletionRow( 0 );
 
             event->accept();
         }
         else if( ( event->key() == Qt::Key_End ) && isInputCompletionVisible() )
         {
-            m_inputCompletionList->setCurrentRow( m_inputCompletionList->count() - 1 );
+            setInputCompletionRow( m_inputCompletionModel->rowCount() - 1 );
 
             event->accept();
         }
@@ -523,6 +676,49 @@ namespace mote
         }
     }
 
+    // Alt-click adds a caret; Alt-drag selects a rectangle, a range per
+    // line. Any other click leaves multi-cursor editing.
+    void TextEdit::mousePressEvent( QMouseEvent* event )
+    {
+        if( ( event->button() == Qt::LeftButton ) && ( event->modifiers() == Qt::AltModifier ) )
+        {
+            if( m_cursors.isEmpty() )
+            {
+                const QTextCursor textCursor = this->textCursor();
+                m_cursors.add( textCursor.anchor(), textCursor.position() );
+            }
+
+            m_rectangleAnchor = cursorForPosition( event->pos() ).position();
+            m_rectangleAnchorX = event->pos().x() - contentOffset().x();
+            m_cursors.add( m_rectangleAnchor, m_rectangleAnchor );
+            syncCursors();
+
+            event->accept();
+            return;
+        }
+
+        if( !m_cursors.isEmpty() )
+        {
+            clearCursors();
+        }
+        QPlainTextEdit::mousePressEvent( event );
+    }
+
+    void TextEdit::mouseMoveEvent( QMouseEvent* event )
+    {
+        if( ( event->buttons() & Qt::LeftButton ) &&
+            ( event->modifiers() == Qt::AltModifier ) &&
+            ( m_rectangleAnchor >= 0 ) )
+        {
+            setRectangularSelection( event->pos() );
+
+            event->accept();
+            return;
+        }
+
+        QPlainTextEdit::mouseMoveEvent( event );
+    }
+
     void TextEdit::dragEnterEvent( QDragEnterEvent* event )
     {
         if( event->mimeData()->hasUrls() )
@@ -590,6 +786,21 @@ namespace mote
         QPlainTextEdit::dropEvent( event );
     }
 
+    // Continuation blocks are copied as the one line they are in the file.
+    QMimeData* TextEdit::createMimeDataFromSelection( void )const
+    {
+        const TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+        if( !textDocument || !textDocument->isLongLineMode() )
+        {
+            return QPlainTextEdit::createMimeDataFromSelection();
+        }
+
+        const QTextCursor textCursor = this->textCursor();
+        QMimeData* mimeData = new QMimeData;
+        mimeData->setText( textDocument->text( textCursor.selectionStart(), textCursor.selectionEnd() ) );
+        return mimeData;
+    }
+
     void TextEdit::updateViewportMargins( const bool force )
     {
         if( m_lineNumberVisible )
@@ -629,10 +840,13 @@ namespace mote
     {
         QFontMetrics fontMetrics( document()->defaultFont() );
         setTabStopWidth( fontMetrics.width( " " ) * m_tabStopWidthBySpace );
+        ++markerLayoutGeneration;
     }
 
     void TextEdit::updateExtraSelections()
     {
+        FrameProfiler::Scope scope( FrameProfiler::ExtraSelectionPhase );
+
         QList<QTextEdit::ExtraSelection> extraSelections;
 
         if( !textCursor().hasSelection() )
@@ -765,280 +979,526 @@ namespace mote
         }
     }
 
-    void TextEdit::drawLineNumber( void )
+    // Numbers are put together from pre-shaped digits, so painting the
+    // gutter does no text layout and no string formatting.
+    void TextEdit::updateDigitTexts( void )
+    {
+        const QFont font = document()->defaultFont();
+        const QFontMetrics fontMetrics( font );
+
+        m_digitTexts.resize( 10 );
+        m_digitWidth = 0;
+        m_digitAscent = fontMetrics.ascent();
+        for( int i = 0; i < m_digitTexts.size(); ++i )
+        {
+            const QChar digit( '0' + i );
+            m_digitTexts[i].setText( digit );
+            m_digitTexts[i].setTextFormat( Qt::PlainText );
+            m_digitTexts[i].prepare( QTransform(), font );
+            m_digitWidth = qMax( m_digitWidth, fontMetrics.width( digit ) );
+        }
+    }
+
+    void TextEdit::drawLineNumber( const QRect& rect )
     {
         if( !m_lineNumberWidget )
         {
             return;
         }
 
-        const QRect rect = m_lineNumberWidget->rect();
+        FrameProfiler::Scope scope( FrameProfiler::GutterPhase );
+
+        if( m_digitTexts.isEmpty() )
+        {
+            updateDigitTexts();
+        }
+
+        const QRect widgetRect = m_lineNumberWidget->rect();
 
         QPainter painter( m_lineNumberWidget );
         painter.setFont( document()->defaultFont() );
 
         painter.setPen( Qt::lightGray );
-        painter.drawLine( rect.topRight(), rect.bottomRight() );
+        painter.drawLine( widgetRect.topRight(), widgetRect.bottomRight() );
 
         painter.setPen( m_lineNumberWidget->palette().color( QPalette::WindowText ) );
 
-        for( QTextBlock block = firstVisibleBlock();
-             block.isValid();
-             block = block.next() )
-        {
-            const QRectF blockRect =
-                blockBoundingGeometry( block ).translated( contentOffset() );
-            if( blockRect.top() > ( qreal )rect.bottom() )
+        // Only the first block's geometry is looked up; the others follow
+        // from the heights, and blocks above the exposed strip are skipped.
+        // Blocks continuing a long line carry no number of their own.
+        QTextBlock block = firstVisibleBlock();
+        const TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+        int lineNumber = textDocument ? textDocument->lineNumber( block ) : block.blockNumber();
+        const bool longLineMode = textDocument && textDocument->isLongLineMode();
+        qreal top = blockBoundingGeometry( block ).translated( contentOffset() ).top();
+        const qreal right = widgetRect.right() - 1;
+        for( bool first = true; block.isValid() && ( top <= ( qreal )rect.bottom() ); block = block.next() )
+        {
+            const bool continuation = longLineMode && TextDocument::isContinuation( block );
+            if( !first && !continuation )
             {
-                break;
+                ++lineNumber;
             }
+            first = false;
 
-            const QTextLayout* layout = block.layout();
-            if( !layout || ( layout->lineCount() < 1 ) )
+            const qreal height = blockBoundingRect( block ).height();
+            if( block.isVisible() && !continuation && ( top + height >= ( qreal )rect.top() ) )
             {
-                continue;
-            }
+                // On the baseline of the first line, which sits lower when
+                // a fallback font in it has a larger ascent.
+                qreal y = top;
+                const QTextLayout* layout = block.layout();
+                const QTextLine line = layout ? layout->lineAt( 0 ) : QTextLine();
+                if( line.isValid() )
+                {
+                    y += layout->position().y() + line.y() + line.ascent() - m_digitAscent;
+                }
 
-            const QTextLine line = layout->lineAt( 0 );
-            const QRectF lineRect = line.rect().translated( blockRect.topLeft() );
+                qreal x = right;
+                for( int number = lineNumber + 1; number > 0; number /= 10 )
+                {
+                    x -= m_digitWidth;
+                    painter.drawStaticText( QPointF( x, y ), m_digitTexts.at( number % 10 ) );
+                }
+            }
+            top += height;
+        }
+    }
 
-            QRectF textRect = lineRect;
-            textRect.setLeft( rect.left() );
-            textRect.setRight( rect.right() - 1 );
+    void TextEdit::updateMarkerTexts( void )
+    {
+        const QFont font = document()->defaultFont();
 
-            painter.drawText(
-                textRect,
-                Qt::AlignRight | Qt::AlignBottom | Qt::TextSingleLine,
-                QString( "%1" ).arg( block.blockNumber() + 1 ) );
+        m_markerTexts.resize( BlockData::MarkerKindCount );
+        m_markerTexts[BlockData::TabMarker].setText( QChar( 0x21C0 ) );
+        m_markerTexts[BlockData::NewlineMarker].setText( QChar( 0x2193 ) );
+        m_markerTexts[BlockData::EOFMarker].setText( tr( "[EOF]" ) );
+        m_markerTexts[BlockData::TrailingSpaceMarker].setText( QChar( 0x00B7 ) );
+        m_markerTexts[BlockData::FullWidthSpaceMarker].setText( QChar( 0x25A1 ) );
+        for( int i = 0; i < m_markerTexts.size(); ++i )
+        {
+            m_markerTexts[i].setTextFormat( Qt::PlainText );
+            m_markerTexts[i].prepare( QTransform(), font );
         }
+
+        const QFontMetrics fontMetrics( font, viewport() );
+        m_guideLineX = fontMetrics.width( "W" ) * 80 + document()->documentMargin();
     }
 
-    void TextEdit::drawEOF( void )
+    // Finding the x of a character needs the block's layout; it is done
+    // once per block and kept until the block is edited or laid out anew.
+    const QVector<BlockData::Marker>& TextEdit::blockMarkers( const QTextBlock& block )
     {
-        QTextBlock block = document()->lastBlock();
-        const QRectF blockRect =
-            blockBoundingGeometry( block ).translated( contentOffset() );
+        BlockData* data = BlockData::get( block );
+        if( data->hasMarkers( markerLayoutGeneration ) )
+        {
+            return data->markers();
+        }
 
+        QVector<BlockData::Marker> markers;
         const QTextLayout* layout = block.layout();
-        if( !layout || ( layout->lineCount() < 1 ) )
+        if( layout && ( layout->lineCount() > 0 ) )
         {
-            return;
-        }
+            const QString text = block.text();
+            int trailingSpaceStart = text.length();
+            while( ( trailingSpaceStart > 0 ) && ( text.at( trailingSpaceStart - 1 ) == ' ' ) )
+            {
+                --trailingSpaceStart;
+            }
+
+            for( int i = 0; i < text.length(); ++i )
+            {
+                BlockData::Marker marker;
+                const QChar ch = text.at( i );
+                if( ch == '\t' )
+                {
+                    marker.kind = BlockData::TabMarker;
+                }
+                else if( ch == QChar( 0x3000 ) )
+                {
+                    marker.kind = BlockData::FullWidthSpaceMarker;
+                }
+                else if( ( ch == ' ' ) && ( i >= trailingSpaceStart ) )
+                {
+                    marker.kind = BlockData::TrailingSpaceMarker;
+                }
+                else
+                {
+                    continue;
+                }
 
-        const QTextLine line = layout->lineAt( layout->lineCount() - 1 );
-        const QRectF lineRect = line.naturalTextRect().translated( blockRect.topLeft() );
+                const QTextLine line = layout->lineForTextPosition( i );
+                if( line.isValid() )
+                {
+                    marker.position = QPointF( line.cursorToX( i ), line.y() );
+                    markers += marker;
+                }
+            }
 
-        QRectF textRect = lineRect;
-        textRect.moveLeft( textRect.right() );
+            const QTextLine line = layout->lineAt( layout->lineCount() - 1 );
+            BlockData::Marker marker;
+            marker.kind = block.next().isValid() ? BlockData::NewlineMarker : BlockData::EOFMarker;
+            marker.position = QPointF( line.naturalTextRect().right(), line.y() );
+            if( !TextDocument::isContinuation( block.next() ) )
+            {
+                markers += marker;
+            }
+        }
 
-        QPainter painter( viewport() );
-        painter.setFont( document()->defaultFont() );
-        painter.setPen( Qt::lightGray );
-        painter.drawText(
-            textRect,
-            Qt::AlignLeft | Qt::AlignBottom | Qt::TextSingleLine | Qt::TextDontClip,
-            tr( "[EOF]" ) );
+        data->setMarkers( markers, markerLayoutGeneration );
+        return data->markers();
     }
 
-    void TextEdit::drawNewlineCharacter( void )
+    // Tabs, line ends, trailing and full-width spaces, the end of file and
+    // the guide line are drawn with one painter in one walk over the
+    // blocks in the exposed rectangle.
+    void TextEdit::drawMarkers( const QRect& rect )
     {
-        const QRect rect = viewport()->rect();
+        FrameProfiler::Scope scope( FrameProfiler::MarkerPhase );
+
+        if( m_markerTexts.isEmpty() )
+        {
+            updateMarkerTexts();
+        }
 
         QPainter painter( viewport() );
-        painter.setFont( document()->defaultFont() );
         painter.setPen( Qt::lightGray );
 
-        for( QTextBlock block = firstVisibleBlock();
-             block.isValid() && ( block != document()->lastBlock() );
-             block = block.next() )
+        const QPointF offset = contentOffset();
+        QTextBlock block = firstVisibleBlock();
+        qreal top = blockBoundingGeometry( block ).translated( offset ).top();
+        for( ; block.isValid() && ( top <= ( qreal )rect.bottom() ); block = block.next() )
         {
-            const QRectF blockRect =
-                blockBoundingGeometry( block ).translated( contentOffset() );
-            if( blockRect.top() > ( qreal )rect.bottom() )
+            const QRectF blockRect = blockBoundingRect( block );
+            if( block.isVisible() && ( top + blockRect.height() >= ( qreal )rect.top() ) )
             {
-                break;
+                const QPointF origin( offset.x() + blockRect.left(), top );
+                const QVector<BlockData::Marker>& markers = blockMarkers( block );
+                for( int i = 0; i < markers.size(); ++i )
+                {
+                    const BlockData::Marker& marker = markers.at( i );
+                    painter.drawStaticText( origin + marker.position, m_markerTexts.at( marker.kind ) );
+                }
             }
+            top += blockRect.height();
+        }
+
+        painter.setPen( QPen( Qt::lightGray, 0, Qt::DotLine ) );
+        painter.drawLine( QPoint( m_guideLineX, rect.top() ), QPoint( m_guideLineX, rect.bottom() ) );
+    }
 
-            const QTextLayout* layout = block.layout();
-            if( !layout || ( layout->lineCount() < 1 ) )
+    // The overlay is a widget of its own above the viewport, refreshed by
+    // a timer. Showing new numbers repaints none of the text, and painting
+    // the overlay is no part of the frames it reports.
+    void TextEdit::updateFrameTimings( void )
+    {
+        const FrameProfiler* profiler = FrameProfiler::instance();
+        if( !profiler->isEnabled() )
+        {
+            m_frameTimingsTimer.stop();
+            if( m_frameTimingsWidget )
             {
-                continue;
+                m_frameTimingsWidget->hide();
             }
+            return;
+        }
 
-            const QTextLine line = layout->lineAt( layout->lineCount() - 1 );
-            const QRectF lineRect = line.naturalTextRect().translated( blockRect.topLeft() );
+        m_frameTimings.clear();
+        for( int i = 0; i < FrameProfiler::PhaseCount; ++i )
+        {
+            const FrameProfiler::Phase phase = static_cast<FrameProfiler::Phase>( i );
+            const FrameProfiler::Statistics statistics = profiler->statistics( phase );
+            m_frameTimings += QString( "%1 p50 %2 p99 %3 ms" )
+                              .arg( FrameProfiler::phaseName( phase ), -16 )
+                              .arg( statistics.p50, 6, 'f', 2 )
+                              .arg( statistics.p99, 6, 'f', 2 );
+        }
 
-            QRectF textRect = lineRect;
-            textRect.moveLeft( textRect.right() );
+        if( !m_frameTimingsWidget )
+        {
+            m_frameTimingsWidget = new QWidget( this );
+            m_frameTimingsWidget->setAttribute( Qt::WA_OpaquePaintEvent );
+            m_frameTimingsWidget->setAttribute( Qt::WA_TransparentForMouseEvents );
+            m_frameTimingsWidget->installEventFilter( this );
+        }
 
-            painter.drawText(
-                textRect,
-                Qt::AlignLeft | Qt::AlignBottom | Qt::TextSingleLine | Qt::TextDontClip,
-                QChar( 0x2193 ) );
+        QFont font = document()->defaultFont();
+        font.setStyleHint( QFont::Monospace );
+        const QFontMetrics fontMetrics( font, m_frameTimingsWidget );
+        int width = 0;
+        for( int i = 0; i < m_frameTimings.size(); ++i )
+        {
+            width = qMax( width, fontMetrics.width( m_frameTimings.at( i ) ) );
         }
+
+        const int margin = fontMetrics.averageCharWidth();
+        const QRect area = viewport()->geometry();
+        m_frameTimingsWidget->setGeometry(
+            area.right() - width - margin * 3,
+            area.top() + margin,
+            width + margin * 2,
+            fontMetrics.lineSpacing() * m_frameTimings.size() + margin * 2 );
+        m_frameTimingsWidget->raise();
+        m_frameTimingsWidget->show();
+        m_frameTimingsWidget->update();
     }
 
-    void TextEdit::drawTabCharacter( void )
+    void TextEdit::drawFrameTimings( void )
     {
-        const QRect rect = viewport()->rect();
+        QFont font = document()->defaultFont();
+        font.setStyleHint( QFont::Monospace );
+        const QFontMetrics fontMetrics( font, m_frameTimingsWidget );
+        const int margin = fontMetrics.averageCharWidth();
+        const QRect box = m_frameTimingsWidget->rect();
+
+        QPainter painter( m_frameTimingsWidget );
+        painter.setFont( font );
+        painter.fillRect( box, QColor( 255, 255, 224 ) );
+        painter.setPen( Qt::black );
+        painter.drawText(
+            box.adjusted( margin, margin, -margin, -margin ),
+            Qt::AlignLeft | Qt::AlignTop,
+            m_frameTimings.join( '\n' ) );
+    }
 
-        QPainter painter( viewport() );
-        painter.setFont( document()->defaultFont() );
-        painter.setPen( Qt::lightGray );
+    // Keys acting on every cursor at once. Returns false for keys that
+    // end multi-cursor editing instead.
+    bool TextEdit::editCursors( QKeyEvent* event )
+    {
+        const Qt::KeyboardModifiers modifiers = event->modifiers() & ~Qt::KeypadModifier;
 
-        for( QTextBlock block = firstVisibleBlock();
-             block.isValid();
-             block = block.next() )
+        QTextCursor::MoveOperation operation = QTextCursor::NoMove;
+        switch( event->key() )
+        {
+        case Qt::Key_Left:
+            operation = QTextCursor::Left;
+            break;
+        case Qt::Key_Right:
+            operation = QTextCursor::Right;
+            break;
+        case Qt::Key_Up:
+            operation = QTextCursor::Up;
+            break;
+        case Qt::Key_Down:
+            operation = QTextCursor::Down;
+            break;
+        case Qt::Key_Home:
+            operation = QTextCursor::StartOfBlock;
+            break;
+        case Qt::Key_End:
+            operation = QTextCursor::EndOfBlock;
+            break;
+        default:
+            break;
+        }
+
+        m_editingCursors = true;
+        bool handled = true;
+        if( ( operation != QTextCursor::NoMove ) && ( ( modifiers & ~Qt::ShiftModifier ) == 0 ) )
+        {
+            m_cursors.move(
+                document(),
+                operation,
+                ( modifiers & Qt::ShiftModifier ) ? QTextCursor::KeepAnchor : QTextCursor::MoveAnchor );
+        }
+        else if( ( event->key() == Qt::Key_Backspace ) && ( modifiers == Qt::NoModifier ) )
+        {
+            m_cursors.deleteCharacters( document(), QTextCursor::PreviousCharacter );
+        }
+        else if( ( event->key() == Qt::Key_Delete ) && ( modifiers == Qt::NoModifier ) )
+        {
+            m_cursors.deleteCharacters( document(), QTextCursor::NextCharacter );
+        }
+        else if( ( ( event->key() == Qt::Key_Enter ) || ( event->key() == Qt::Key_Return ) ) &&
+                 ( modifiers == Qt::NoModifier ) )
+        {
+            m_cursors.insertText( document(), "\n" );
+        }
+        else if( ( event->key() == Qt::Key_Tab ) && ( modifiers == Qt::NoModifier ) )
+        {
+            m_cursors.insertText( document(), "\t" );
+        }
+        else if( event->matches( QKeySequence::Copy ) )
+        {
+            QApplication::clipboard()->setText( m_cursors.selectedText( document() ) );
+        }
+        else if( event->matches( QKeySequence::Cut ) )
+        {
+            QApplication::clipboard()->setText( m_cursors.selectedText( document() ) );
+            m_cursors.insertText( document(), QString() );
+        }
+        else if( event->matches( QKeySequence::Paste ) )
         {
-            const QRectF blockRect =
-                blockBoundingGeometry( block ).translated( contentOffset() );
-            if( blockRect.top() > ( qreal )rect.bottom() )
+            // As many lines as cursors, as copied from them, go one each.
+            const QString text = QApplication::clipboard()->text();
+            QStringList lines = text.split( '\n' );
+            if( ( lines.size() > 1 ) && lines.last().isEmpty() )
             {
-                break;
+                lines.removeLast();
             }
-
-            const QTextLayout* layout = block.layout();
-            if( !layout )
+            if( ( m_cursors.count() > 1 ) && ( lines.size() == m_cursors.count() ) )
             {
-                continue;
+                m_cursors.insertTexts( document(), lines );
             }
-
-            const QString text = block.text();
-            const int len = text.length();
-            for( int i = 0; i < len; ++i )
+            else
             {
-                if( text[i] == '\t' )
-                {
-                    int cursorPos = i;
-                    QTextLine line = layout->lineForTextPosition( cursorPos );
-                    if( line.isValid() )
-                    {
-                        const qreal x = line.cursorToX( &cursorPos );
-                        QRectF textRect = line.rect().translated( blockRect.topLeft() );
-                        textRect.moveLeft( textRect.left() + x );
-                        painter.drawText(
-                            textRect,
-                            Qt::AlignLeft | Qt::AlignBottom | Qt::TextSingleLine | Qt::TextDontClip,
-                            QChar( 0x21C0 ) );
-                    }
-                }
+                m_cursors.insertText( document(), text );
             }
         }
+        else if( !event->text().isEmpty() && event->text().at( 0 ).isPrint() &&
+                 !( modifiers & ( Qt::ControlModifier | Qt::AltModifier ) ) )
+        {
+            m_cursors.insertText( document(), event->text() );
+        }
+        else if( event->key() == Qt::Key_Escape )
+        {
+            clearCursors();
+            m_editingCursors = false;
+            return true;
+        }
+        else
+        {
+            handled = false;
+        }
+        m_editingCursors = false;
+
+        if( handled )
+        {
+            syncCursors();
+            onCursorPositionChanged();
+        }
+        return handled;
     }
 
-    void TextEdit::drawGuideLine()
+    void TextEdit::clearCursors( void )
     {
-        const QFontMetrics fontMetrics( document()->defaultFont(), viewport() );
-        const int width = fontMetrics.width( "W" ) * 80 + document()->documentMargin();
-
-        QPainter painter( viewport() );
-        painter.setPen( QPen( Qt::lightGray, 0, Qt::DotLine ) );
-        painter.drawLine( QPoint( width, 0 ), QPoint( width, height() - 1 ) );
+        m_cursors.clear();
+        m_rectangleAnchor = -1;
+        viewport()->update();
     }
 
-    void TextEdit::indent( void )
+    // The widget's own cursor follows the last range, so that it is the one
+    // kept in view.
+    void TextEdit::syncCursors( void )
     {
+        if( m_cursors.isEmpty() )
+        {
+            return;
+        }
+
+        const MultiCursor::Range& range = m_cursors.ranges().last();
         QTextCursor textCursor = this->textCursor();
-        int anchor = textCursor.anchor();
-        int position = textCursor.position();
-        QTextBlock anchorBlock = document()->findBlock( anchor );
-        QTextBlock positionBlock = document()->findBlock( position );
-        if( anchorBlock != positionBlock )
+        textCursor.setPosition( range.anchor );
+        textCursor.setPosition( range.position, QTextCursor::KeepAnchor );
+        setTextCursor( textCursor );
+        viewport()->update();
+    }
+
+    void TextEdit::setRectangularSelection( const QPoint& pos )
+    {
+        QTextBlock first = document()->findBlock( m_rectangleAnchor );
+        QTextBlock last = cursorForPosition( pos ).block();
+        if( first.blockNumber() > last.blockNumber() )
         {
-            if( anchor < position )
-            {
-                anchor = anchorBlock.position();
+            qSwap( first, last );
+        }
+        const qreal x = pos.x() - contentOffset().x();
 
-                textCursor.beginEditBlock();
-                QTextBlock block = anchorBlock;
-                while( block.isValid() )
-                {
-                    if( block == positionBlock )
-                    {
-                        textCursor.setPosition( position );
+        QVector<MultiCursor::Range> ranges;
+        for( QTextBlock block = first; block.isValid(); block = block.next() )
+        {
+            MultiCursor::Range range;
+            range.anchor = block.position() + columnAt( block, m_rectangleAnchorX );
+            range.position = block.position() + columnAt( block, x );
+            ranges += range;
 
-                        if( textCursor.positionInBlock() == 0 )
-                        {
-                            break;
-                        }
-                        else
-                        {
-                            textCursor.movePosition( QTextCursor::StartOfBlock );
-                        }
-                    }
-                    else
-                    {
-                        textCursor.setPosition( block.position() );
-                    }
-
-                    textCursor.insertText( QString( tabStopWidthBySpace(), ' ' ) );
-                    position += tabStopWidthBySpace();
+            if( block == last )
+            {
+                break;
+            }
+        }
 
-                    if( block == positionBlock )
-                    {
-                        break;
-                    }
+        m_cursors.setRanges( ranges );
+        syncCursors();
+    }
 
-                    block = block.next();
-                }
-                textCursor.endEditBlock();
+    // Only the ranges on visible lines are looked at; the widget draws its
+    // own cursor itself.
+    void TextEdit::drawCursors( const QRect& rect )
+    {
+        QPainter painter( viewport() );
+        QColor selectionColor = palette().color( QPalette::Highlight );
+        selectionColor.setAlpha( 96 );
+        const QColor caretColor = palette().color( QPalette::Text );
+        const QTextCursor textCursor = this->textCursor();
+        const QPointF offset = contentOffset();
+
+        const QVector<MultiCursor::Range>& ranges = m_cursors.ranges();
+        QTextBlock block = firstVisibleBlock();
+        int i = m_cursors.lowerBound( block.position() );
+        for( ; block.isValid() && ( i < ranges.size() ); block = block.next() )
+        {
+            const QRectF blockRect = blockBoundingGeometry( block ).translated( offset );
+            if( blockRect.top() > rect.bottom() )
+            {
+                break;
+            }
 
-                textCursor.setPosition( anchor );
-                textCursor.setPosition( position, QTextCursor::KeepAnchor );
-                if( textCursor.positionInBlock() != 0 )
+            const int blockStart = block.position();
+            const int blockEnd = blockStart + block.length() - 1;
+            const QTextLine line = block.layout()->lineAt( 0 );
+            for( int j = i; ( j < ranges.size() ) && ( MultiCursor::start( ranges.at( j ) ) <= blockEnd ); ++j )
+            {
+                const MultiCursor::Range& range = ranges.at( j );
+                if( !line.isValid() ||
+                    ( ( range.anchor == textCursor.anchor() ) && ( range.position == textCursor.position() ) ) )
                 {
-                    textCursor.movePosition( QTextCursor::EndOfBlock, QTextCursor::KeepAnchor );
+                    continue;
                 }
-                setTextCursor( textCursor );
-            }
-            else
-            {
-                position = positionBlock.position();
 
-                textCursor.beginEditBlock();
-                QTextBlock block = anchorBlock;
-                while( block.isValid() )
+                const qreal top = blockRect.top() + line.y();
+                const int start = qMax( MultiCursor::start( range ), blockStart ) - blockStart;
+                const int end = qMin( MultiCursor::end( range ), blockEnd ) - blockStart;
+                if( ( start < end ) || ( MultiCursor::end( range ) > blockEnd ) )
                 {
-                    if( block == anchorBlock )
-                    {
-                        textCursor.setPosition( anchor );
-
-                        if( textCursor.positionInBlock() == 0 )
-                        {
-                            block = block.previous();
-                            continue;
-                        }
-                        else
-                        {
-                            textCursor.movePosition( QTextCursor::StartOfBlock );
-                        }
-                    }
-                    else
-                    {
-                        textCursor.setPosition( block.position() );
-                    }
-
-                    textCursor.insertText( QString( tabStopWidthBySpace(), ' ' ) );
-                    anchor += tabStopWidthBySpace();
-
-                    if( block == positionBlock )
+                    const qreal x1 = line.cursorToX( start );
+                    qreal x2 = line.cursorToX( end );
+                    if( MultiCursor::end( range ) > blockEnd )
                     {
-                        break;
+                        x2 += QFontMetrics( document()->defaultFont() ).width( ' ' );
                     }
-
-                    block = block.previous();
+                    painter.fillRect(
+                        QRectF( blockRect.left() + x1, top, x2 - x1, line.height() ),
+                        selectionColor );
                 }
-                textCursor.endEditBlock();
-
-                textCursor.setPosition( anchor );
-                if( textCursor.positionInBlock() != 0 )
+                if( ( range.position >= blockStart ) && ( range.position <= blockEnd ) )
                 {
-                    textCursor.movePosition( QTextCursor::EndOfBlock );
+                    painter.fillRect(
+                        QRectF(
+                            blockRect.left() + line.cursorToX( range.position - blockStart ),
+                            top,
+                            cursorWidth(),
+                            line.height() ),
+                        caretColor );
                 }
-                textCursor.setPosition( position, QTextCursor::KeepAnchor );
-                setTextCursor( textCursor );
+            }
+
+            while( ( i < ranges.size() ) && ( MultiCursor::end( ranges.at( i ) ) <= blockEnd ) )
+            {
+                ++i;
             }
         }
+    }
+
+    void TextEdit::indent( void )
+    {
+        QTextCursor textCursor = this->textCursor();
+        QTextBlock anchorBlock = document()->findBlock( textCursor.anchor() );
+        QTextBlock positionBlock = document()->findBlock( textCursor.position() );
+        if( anchorBlock != positionBlock )
+        {
+            indentLines( false );
+        }
         else
         {
             textCursor.beginEditBlock();
@@ -1055,144 +1515,160 @@ namespace mote
 
     void TextEdit::reverseIndent( void )
     {
-        QTextCursor textCursor = this->textCursor();
-        int anchor = textCursor.anchor();
-        int position = textCursor.position();
-        QTextBlock anchorBlock = document()->findBlock( anchor );
-        QTextBlock positionBlock = document()->findBlock( position );
+        const QTextCursor textCursor = this->textCursor();
+        QTextBlock anchorBlock = document()->findBlock( textCursor.anchor() );
+        QTextBlock positionBlock = document()->findBlock( textCursor.position() );
         if( anchorBlock != positionBlock )
         {
-            if( anchor < position )
-            {
-                anchor = anchorBlock.position();
-
-                textCursor.beginEditBlock();
-                QTextBlock block = anchorBlock;
-                while( block.isValid() )
-                {
-                    if( block == positionBlock )
-                    {
-                        textCursor.setPosition( position );
-
-                        if( textCursor.positionInBlock() == 0 )
-                        {
-                            break;
-                        }
-                        else
-                        {
-                            textCursor.movePosition( QTextCursor::StartOfBlock );
-                        }
-                    }
-                    else
-                    {
-                        textCursor.setPosition( block.position() );
-                    }
+            indentLines( true );
+        }
+    }
 
-                    int count = tabStopWidthBySpace();
-                    while( count > 0 )
-                    {
-                        const QChar ch = document()->characterAt( textCursor.position() );
-                        if( ch == ' ' )
-                        {
-                            textCursor.deleteChar();
-                            --position;
-                            --count;
-                        }
-                        else if( ch == '\t' )
-                        {
-                            textCursor.deleteChar();
-                            --position;
-                            break;
-                        }
-                        else
-                        {
-                            break;
-                        }
-                    }
+    // The whole lines the selection touches, long lines with all their
+    // blocks. A selection ending at the start of a line leaves that line
+    // out.
+    QTextCursor TextEdit::selectLines( bool* endsAtBlockStart )const
+    {
+        QTextCursor textCursor = this->textCursor();
+        QTextBlock firstBlock = document()->findBlock( textCursor.selectionStart() );
+        while( TextDocument::isContinuation( firstBlock ) )
+        {
+            firstBlock = firstBlock.previous();
+        }
+        QTextBlock lastBlock = document()->findBlock( textCursor.selectionEnd() );
+        *endsAtBlockStart =
+            ( lastBlock != firstBlock ) && ( textCursor.selectionEnd() == lastBlock.position() ) &&
+            !TextDocument::isContinuation( lastBlock );
+        if( *endsAtBlockStart )
+        {
+            lastBlock = lastBlock.previous();
+        }
+        while( TextDocument::isContinuation( lastBlock.next() ) )
+        {
+            lastBlock = lastBlock.next();
+        }
 
-                    if( block == positionBlock )
-                    {
-                        break;
-                    }
+        textCursor.setPosition( firstBlock.position() );
+        textCursor.setPosition( lastBlock.position() + lastBlock.length() - 1, QTextCursor::KeepAnchor );
+        return textCursor;
+    }
 
-                    block = block.next();
-                }
-                textCursor.endEditBlock();
+    // Replaces the lines selected by selectLines(), oldText as
+    // TextDocument::text() reads them, with text in a single edit rather
+    // than line by line; long lines only have their changed fronts edited.
+    // Afterwards the whole lines are selected, in the direction the
+    // selection had.
+    void TextEdit::replaceLines(
+        QTextCursor textCursor,
+        const QString& oldText,
+        const QString& text,
+        const bool forward,
+        const bool endsAtBlockStart )
+    {
+        const int start = textCursor.selectionStart();
+        QTextCursor endCursor( document() );
+        endCursor.setPosition( textCursor.selectionEnd() );
 
-                textCursor.setPosition( anchor );
-                textCursor.setPosition( position, QTextCursor::KeepAnchor );
-                if( textCursor.positionInBlock() != 0 )
-                {
-                    textCursor.movePosition( QTextCursor::EndOfBlock, QTextCursor::KeepAnchor );
-                }
-                setTextCursor( textCursor );
+        TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+        int end = endCursor.position();
+        if( text != oldText )
+        {
+            if( textDocument && textDocument->isLongLineMode() )
+            {
+                replaceLineFronts( textDocument, start, oldText, text );
+                end = endCursor.position();
             }
             else
             {
-                position = positionBlock.position();
-
                 textCursor.beginEditBlock();
-                QTextBlock block = anchorBlock;
-                while( block.isValid() )
-                {
-                    if( block == anchorBlock )
-                    {
-                        textCursor.setPosition( anchor );
+                textCursor.insertText( text );
+                textCursor.endEditBlock();
+                end = start + text.length();
+            }
+        }
 
-                        if( textCursor.positionInBlock() == 0 )
-                        {
-                            block = block.previous();
-                            continue;
-                        }
-                        else
-                        {
-                            textCursor.movePosition( QTextCursor::StartOfBlock );
-                        }
-                    }
-                    else
-                    {
-                        textCursor.setPosition( block.position() );
-                    }
+        end += endsAtBlockStart ? 1 : 0;
+        textCursor.setPosition( forward ? start : end );
+        textCursor.setPosition( forward ? end : start, QTextCursor::KeepAnchor );
+        setTextCursor( textCursor );
+    }
 
-                    int count = tabStopWidthBySpace();
-                    while( count > 0 )
-                    {
-                        const QChar ch = document()->characterAt( textCursor.position() );
-                        if( ch == ' ' )
-                        {
-                            textCursor.deleteChar();
-                            --anchor;
-                            --count;
-                        }
-                        else if( ch == '\t' )
-                        {
-                            textCursor.deleteChar();
-                            --anchor;
-                            break;
-                        }
-                        else
-                        {
-                            break;
-                        }
-                    }
+    void TextEdit::indentLines( const bool unindent )
+    {
+        const bool forward = textCursor().anchor() < textCursor().position();
+        bool endsAtBlockStart;
+        const QTextCursor textCursor = selectLines( &endsAtBlockStart );
+
+        // Long lines are read whole, not block by block.
+        const TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+        const QString text =
+            textDocument ?
+            textDocument->text( textCursor.selectionStart(), textCursor.selectionEnd() ) :
+            textCursor.selectedText().replace( QChar( 0x2029 ), '\n' );
+        const TextLines lines( text, '\n' );
+        const LineIndenter indenter( tabStopWidthBySpace() );
+        replaceLines(
+            textCursor,
+            text,
+            unindent ? indenter.unindent( lines ) : indenter.indent( lines ),
+            forward,
+            endsAtBlockStart );
+    }
 
-                    if( block == positionBlock )
-                    {
-                        break;
-                    }
+    // Lines after the first are indented after the new text of the ones
+    // before them, so the blocks are read once.
+    void TextEdit::reindentLines( void )
+    {
+        const bool forward = textCursor().anchor() < textCursor().position();
+        bool endsAtBlockStart;
+        const QTextCursor textCursor = selectLines( &endsAtBlockStart );
 
-                    block = block.previous();
-                }
-                textCursor.endEditBlock();
+        TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+        const QTextBlock firstBlock = document()->findBlock( textCursor.selectionStart() );
+        if( !textDocument || !SmartIndenter::isAvailable( firstBlock ) )
+        {
+            return;
+        }
 
-                textCursor.setPosition( anchor );
-                if( textCursor.positionInBlock() != 0 )
-                {
-                    textCursor.movePosition( QTextCursor::EndOfBlock );
-                }
-                textCursor.setPosition( position, QTextCursor::KeepAnchor );
-                setTextCursor( textCursor );
-            }
+        SmartIndenter indenter( textDocument, tabStopWidthBySpace() );
+        replaceLines(
+            textCursor,
+            textDocument->text( textCursor.selectionStart(), textCursor.selectionEnd() ),
+            indenter.reindent( firstBlock, document()->findBlock( textCursor.selectionEnd() ) ),
+            forward,
+            endsAtBlockStart );
+    }
+
+    // Moves a closing brace typed first on its line back to the level of
+    // the block it closes.
+    void TextEdit::reindentTypedLine( void )
+    {
+        QTextCursor textCursor = this->textCursor();
+        const QTextBlock block = textCursor.block();
+        const QString text = block.text();
+        const int column = textCursor.positionInBlock() - 1;
+        if( ( column < 0 ) || !text.left( column ).trimmed().isEmpty() )
+        {
+            return;
+        }
+
+        TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+        if( !textDocument || !SmartIndenter::isAvailable( block ) )
+        {
+            return;
+        }
+
+        const SmartIndenter indenter( textDocument, tabStopWidthBySpace() );
+        const QString indent = indenter.indentation( block );
+        if( indent != text.left( column ) )
+        {
+            textCursor.joinPreviousEditBlock();
+            textCursor.setPosition( block.position() );
+            textCursor.setPosition( block.position() + column, QTextCursor::KeepAnchor );
+            textCursor.insertText( indent );
+            textCursor.endEditBlock();
+            textCursor.setPosition( block.position() + indent.length() + 1 );
+            setTextCursor( textCursor );
         }
     }
 
@@ -1230,100 +1706,90 @@ namespace mote
         return false;
     }
 
-    void TextEdit::inputCompletion( void )
+    // The word characters just before the cursor.
+    QString TextEdit::inputCompletionText( void )const
     {
-        QTextCursor textCursor = this->textCursor();
+        const QTextCursor textCursor = this->textCursor();
         if( textCursor.hasSelection() )
         {
-            return;
+            return QString();
         }
-        const int curPos = textCursor.position();
 
-        const QRegExp partOfWordExp( "[a-z0-9_]", Qt::CaseInsensitive );
         QString text;
-        for( int pos = curPos - 1; ; --pos )
+        for( int pos = textCursor.position() - 1; ; --pos )
         {
             const QChar ch = document()->characterAt( pos );
-            if( ch.isNull() || !partOfWordExp.exactMatch( QString( ch ) ) )
+            if( ch.isNull() || !WordIndex::isWordCharacter( ch ) )
             {
                 break;
             }
 
             text.prepend( ch );
         }
+        return text;
+    }
+
+    void TextEdit::inputCompletion( void )
+    {
+        const QString text = inputCompletionText();
         if( text.isEmpty() )
         {
             return;
         }
 
-        QMap<QString, int> hitStrAndDistMap;
-
-        const QRegExp wordExp( text + partOfWordExp.pattern() + '+', Qt::CaseInsensitive );
-        textCursor.movePosition( QTextCursor::Start );
-        while( true )
+        TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+        if( !textDocument )
         {
-            textCursor = document()->find( wordExp, textCursor, QTextDocument::FindWholeWords );
-            if( textCursor.isNull() )
-            {
-                break;
-            }
+            return;
+        }
 
-            if( textCursor.anchor() != curPos - text.length() )
-            {
-                int dist;
-                if( textCursor.anchor() < curPos )
-                {
-                    dist = qAbs( curPos - text.length() - textCursor.position() );
-                }
-                else
-                {
-                    dist = qAbs( curPos - text.length() - textCursor.anchor() );
-                }
+        QTextCursor textCursor = this->textCursor();
+        const int curPos = textCursor.position();
 
-                const QString str = textCursor.selectedText();
-                QMap<QString, int>::iterator itr = hitStrAndDistMap.find( str );
-                if( itr != hitStrAndDistMap.end() )
-                {
-                    if( dist < itr.value() )
-                    {
-                        itr.value() = dist;
-                    }
-                }
-                else
-                {
-                    hitStrAndDistMap.insert( str, dist );
-                }
+        const FuzzyMatcher matcher( text );
+        const QVector<WordIndex::Candidate> nearby =
+            textDocument->wordIndex()->complete( matcher, textCursor.block(), curPos - text.length() );
+
+        QStringList candidates;
+        bool truncated = false;
+        CompletionIndex* completionIndex = textDocument->completionIndex();
+        if( completionIndex )
+        {
+            const QVector<CompletionIndex::Candidate> ranked =
+                completionIndex->complete( matcher, nearby, &truncated );
+            for( int i = 0; i < ranked.size(); ++i )
+            {
+                candidates += ranked.at( i ).word;
             }
         }
-
-        if( !hitStrAndDistMap.isEmpty() )
+        else
         {
-            QVector<QPair<int, QString> > hitDistAndStrArr;
-            hitDistAndStrArr.reserve( hitStrAndDistMap.size() );
-            for( QMap<QString, int>::const_iterator itr = hitStrAndDistMap.begin();
-                 itr != hitStrAndDistMap.end(); ++itr )
+            for( int i = 0; i < nearby.size(); ++i )
             {
-                hitDistAndStrArr.push_back( QPair<int, QString>( itr.value(), itr.key() ) );
+                candidates += nearby.at( i ).word;
             }
-            qSort( hitDistAndStrArr.begin(), hitDistAndStrArr.end() );
+        }
 
+        if( !candidates.isEmpty() )
+        {
             if( !m_inputCompletionList )
             {
-                m_inputCompletionList = new QListWidget( viewport() );
-                m_inputCompletionList->setItemDelegate(
-                    new InputCompletionItemDelegate( m_inputCompletionList ) );
+                // Rows are laid out on demand and all of one height, so the
+                // number of candidates does not slow the popup down.
+                m_inputCompletionModel = new CompletionModel( this );
+                m_inputCompletionList = new QListView( viewport() );
+                m_inputCompletionDelegate = new InputCompletionItemDelegate( m_inputCompletionList );
+                m_inputCompletionList->setItemDelegate( m_inputCompletionDelegate );
+                m_inputCompletionList->setUniformItemSizes( true );
+                m_inputCompletionList->setModel( m_inputCompletionModel );
                 m_inputCompletionList->setFont( document()->defaultFont() );
                 m_inputCompletionList->setFocusPolicy( Qt::NoFocus );
             }
 
-            m_inputCompletionList->clear();
-            for( int i = 0; i < hitDistAndStrArr.size(); ++i )
-            {
-                m_inputCompletionList->addItem( hitDistAndStrArr.at( i ).second );
-            }
-            m_inputCompletionList->setCurrentRow( 0 );
+            m_inputCompletionDelegate->setPattern( text );
+            m_inputCompletionModel->setCandidates( candidates, text, truncated );
+            setInputCompletionRow( 0 );
 
-            textCursor = this->textCursor();
             textCursor.movePosition(
                 QTextCursor::PreviousCharacter,
                 QTextCursor::KeepAnchor,
@@ -1339,6 +1805,10 @@ namespace mote
 
             m_inputCompletionList->show();
         }
+        else if( m_inputCompletionList )
+        {
+            m_inputCompletionList->hide();
+        }
     }
 
     bool TextEdit::isInputCompletionVisible( void )const
@@ -1346,49 +1816,90 @@ namespace mote
         return m_inputCompletionList && m_inputCompletionList->isVisible();
     }
 
-    void TextEdit::applyInputCompletion( void )
+    void TextEdit::setInputCompletionRow( const int row )
     {
-        if( !m_inputCompletionList )
+        if( ( row < 0 ) || ( row >= m_inputCompletionModel->rowCount() ) )
         {
             return;
         }
 
-        const QListWidgetItem* item = m_inputCompletionList->currentItem();
-        if( !item )
+        m_inputCompletionList->setCurrentIndex( m_inputCompletionModel->index( row ) );
+    }
+
+    // Narrows the shown candidates to the word typed so far, or closes the
+    // popup once the cursor has left that word.
+    // The candidate picked stays picked as long as it still matches.
+    void TextEdit::filterInputCompletion( void )
+    {
+        const QString text = inputCompletionText();
+        if( text.isEmpty() )
         {
+            m_inputCompletionList->hide();
             return;
         }
 
-        const QString str = item->text();
-        if( str.isEmpty() )
+        QString current;
+        const QModelIndex index = m_inputCompletionList->currentIndex();
+        if( index.isValid() )
+        {
+            current = m_inputCompletionModel->word( index.row() );
+        }
+
+        if( m_inputCompletionModel->filter( text ) )
+        {
+            if( m_inputCompletionModel->rowCount() == 0 )
+            {
+                m_inputCompletionList->hide();
+                return;
+            }
+            m_inputCompletionDelegate->setPattern( text );
+        }
+        else if( text.startsWith( m_inputCompletionModel->pattern() ) )
         {
+            // Typed on past a request that was cut short: ask again, the
+            // words it left out may match now.
+            inputCompletion();
+            if( !isInputCompletionVisible() )
+            {
+                return;
+            }
+        }
+        else
+        {
+            m_inputCompletionList->hide();
             return;
         }
 
-        QTextCursor textCursor = this->textCursor();
-        if( textCursor.hasSelection() )
+        const int row = current.isNull() ? -1 : m_inputCompletionModel->row( current );
+        setInputCompletionRow( qMax( row, 0 ) );
+    }
+
+    void TextEdit::applyInputCompletion( void )
+    {
+        if( !m_inputCompletionList )
         {
             return;
         }
-        const int curPos = textCursor.position();
 
-        const QRegExp partOfWordExp( "[a-z0-9_]", Qt::CaseInsensitive );
-        QString text;
-        for( int pos = curPos - 1; ; --pos )
+        const QModelIndex index = m_inputCompletionList->currentIndex();
+        if( !index.isValid() )
         {
-            const QChar ch = document()->characterAt( pos );
-            if( ch.isNull() || !partOfWordExp.exactMatch( QString( ch ) ) )
-            {
-                break;
-            }
+            return;
+        }
 
-            text.prepend( ch );
+        const QString str = m_inputCompletionModel->word( index.row() );
+        if( str.isEmpty() )
+        {
+            return;
         }
+
+        const QString text = inputCompletionText();
         if( text.isEmpty() )
         {
             return;
         }
 
+        QTextCursor textCursor = this->textCursor();
         textCursor.movePosition(
             QTextCursor::PreviousCharacter,
             QTextCursor::KeepAnchor,
@@ -1398,6 +1909,12 @@ namespace mote
         textCursor.insertText( str );
         textCursor.endEditBlock();
         setTextCursor( textCursor );
+
+        TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+        if( textDocument && textDocument->completionIndex() )
+        {
+            textDocument->completionIndex()->accept( str );
+        }
     }
 
     void TextEdit::autoIndent( void )
@@ -1405,25 +1922,11 @@ namespace mote
         QTextCursor cursor = textCursor();
         if( cursor.positionInBlock() == 0 )
         {
-            QTextBlock prevBlock = cursor.block().previous();
-            if( prevBlock.isValid() )
+            TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+            if( textDocument )
             {
-                const QString prevText = prevBlock.text();
-                QString indent;
-                for( QString::const_iterator itr = prevText.begin();
-                     itr != prevText.end();
-                     ++itr )
-                {
-                    if( ( *itr == QChar( ' ' ) ) ||
-                        ( *itr == QChar( '\t' ) ) )
-                    {
-                        indent += *itr;
-                    }
-                    else
-                    {
-                        break;
-                    }
-                }
+                const SmartIndenter indenter( textDocument, tabStopWidthBySpace() );
+                const QString indent = indenter.indentation( cursor.block() );
                 if( !indent.isEmpty() )
                 {
                     cursor.joinPreviousEditBlock();
@@ -1443,7 +1946,10 @@ namespace mote
         }
         else
         {
-            return document()->find( text, this->textCursor(), flags );
+            const TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+            return textDocument ?
+                   textDocument->findText( text, this->textCursor(), flags ) :
+                   document()->find( text, this->textCursor(), flags );
         }
     }
 
@@ -1455,7 +1961,10 @@ namespace mote
         }
         else
         {
-            return document()->find( expr, this->textCursor(), flags );
+            const TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+            return textDocument ?
+                   textDocument->findText( expr, this->textCursor(), flags ) :
+                   document()->find( expr, this->textCursor(), flags );
         }
     }
 
@@ -1467,7 +1976,10 @@ namespace mote
         }
         else
         {
-            return document()->find( text, this->textCursor(), flags | QTextDocument::FindBackward );
+            const TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+            return textDocument ?
+                   textDocument->findText( text, this->textCursor(), flags | QTextDocument::FindBackward ) :
+                   document()->find( text, this->textCursor(), flags | QTextDocument::FindBackward );
         }
     }
 
@@ -1479,23 +1991,49 @@ namespace mote
         }
         else
         {
-            return document()->find( expr, this->textCursor(), flags | QTextDocument::FindBackward );
+            const TextDocument* textDocument = qobject_cast<TextDocument*>( document() );
+            return textDocument ?
+                   textDocument->findText( expr, this->textCursor(), flags | QTextDocument::FindBackward ) :
+                   document()->find( expr, this->textCursor(), flags | QTextDocument::FindBackward );
         }
     }
 
     void TextEdit::onFontChanged( void )
     {
+        m_digitTexts.clear();
+        m_markerTexts.clear();
+        ++markerLayoutGeneration;
         updateGeometry();
         updateViewportMargins( true );
         updateLineNumberWidgetGeometry();
         updateTabStopWidthBySpace();
     }
 
+    void TextEdit::onUpdateRequest( const QRect& rect, int dy )
+    {
+        if( !m_lineNumberWidget )
+        {
+            return;
+        }
+
+        // A scroll moves the painted numbers within the scrolled rows and
+        // exposes just a strip; anything else repaints the rows the editor
+        // repaints.
+        if( dy != 0 )
+        {
+            m_lineNumberWidget->scroll( 0, dy, QRect( 0, rect.y(), m_lineNumberWidget->width(), rect.height() ) );
+        }
+        else
+        {
+            m_lineNumberWidget->update( 0, rect.y(), m_lineNumberWidget->width(), rect.height() );
+        }
+    }
+
     void TextEdit::onCursorPositionChanged()
     {
         if( isInputCompletionVisible() )
         {
-            m_inputCompletionList->hide();
+            filterInputCompletion();
         }
 
         QTextCursor textCursor = this->textCursor();
@@ -1518,6 +2056,18 @@ namespace mote
 
     void TextEdit::onTextChanged()
     {
+        // Edits at the ranges come one per range; editCursors() catches up
+        // once they are all made. Edits made elsewhere leave the ranges
+        // behind.
+        if( m_editingCursors )
+        {
+            return;
+        }
+        if( !m_cursors.isEmpty() )
+        {
+            clearCursors();
+        }
+
         QTextCursor textCursor = this->textCursor();
         if( textCursor.hasSelection() || textCursor.atBlockEnd() )
         {
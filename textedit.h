@@ -1,11 +1,22 @@
 #pragma once
 
+#include <QFutureWatcher>
 #include <QList>
-#include <QListWidget>
+#include <QListView>
 #include <QPlainTextEdit>
+#include <QStaticText>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+#include "blockdata.h"
+#include "multicursor.h"
+#include "sourceformatter.h"
 
 namespace mote
 {
+    class CompletionModel;
+    class InputCompletionItemDelegate;
     class TextDocument;
 
     class TextEdit : public QPlainTextEdit
@@ -26,12 +37,15 @@ namespace mote
         int tabStopWidthBySpace( void )const;
         void setTabStopWidthBySpace( const int count );
 
-        static QList<TextEdit*> findEdits( TextDocument* textDocument = NULL );
-        static QList<TextEdit*> findEdits( const QString& path );
+        bool isFormatting( void )const;
+        void cancelFormatting( void );
 
     public slots:
         void formatSourceCode( void );
+        void formatWholeSourceCode( void );
         void jumpToCoBrace( void );
+        void selectAllOccurrences( void );
+        void reindentLines( void );
         void findNext( const QString& text, const QTextDocument::FindFlags flags );
         void findNext( const QRegExp& expr, const QTextDocument::FindFlags flags );
         void findPrevious( const QString& text, const QTextDocument::FindFlags flags );
@@ -45,9 +59,12 @@ namespace mote
         virtual void resizeEvent( QResizeEvent* event );
         virtual void paintEvent( QPaintEvent* event );
         virtual void keyPressEvent( QKeyEvent* event );
+        virtual void mousePressEvent( QMouseEvent* event );
+        virtual void mouseMoveEvent( QMouseEvent* event );
         virtual void dragEnterEvent( QDragEnterEvent* event );
         virtual void dragMoveEvent( QDragMoveEvent* event );
         virtual void dropEvent( QDropEvent* event );
+        virtual QMimeData* createMimeDataFromSelection( void )const;
 
     private:
         void updateViewportMargins( const bool force = false );
@@ -55,18 +72,37 @@ namespace mote
         void updateTabStopWidthBySpace( void );
         void updateExtraSelections();
         void updateCoBracePos();
-        void drawLineNumber( void );
-        void drawEOF( void );
-        void drawNewlineCharacter( void );
-        void drawTabCharacter( void );
-        void drawGuideLine();
+        void updateDigitTexts( void );
+        void drawLineNumber( const QRect& rect );
+        void updateMarkerTexts( void );
+        const QVector<BlockData::Marker>& blockMarkers( const QTextBlock& block );
+        void drawMarkers( const QRect& rect );
+        void drawFrameTimings( void );
+        bool editCursors( QKeyEvent* event );
+        void clearCursors( void );
+        void syncCursors( void );
+        void setRectangularSelection( const QPoint& pos );
+        void drawCursors( const QRect& rect );
         void indent( void );
         void reverseIndent( void );
+        QTextCursor selectLines( bool* endsAtBlockStart )const;
+        void replaceLines(
+            QTextCursor textCursor,
+            const QString& oldText,
+            const QString& text,
+            const bool forward,
+            const bool endsAtBlockStart );
+        void indentLines( const bool unindent );
+        void reindentTypedLine( void );
         bool isPartOfString( const int pos )const;
+        QString inputCompletionText( void )const;
         void inputCompletion( void );
         bool isInputCompletionVisible( void )const;
+        void setInputCompletionRow( const int row );
+        void filterInputCompletion( void );
         void applyInputCompletion( void );
         void autoIndent( void );
+        void startFormatting( void );
         QTextCursor _findNext( const QString& text, const QTextDocument::FindFlags flags )const;
         QTextCursor _findNext( const QRegExp& expr, const QTextDocument::FindFlags flags )const;
         QTextCursor _findPrevious( const QString& text, const QTextDocument::FindFlags flags )const;
@@ -74,18 +110,41 @@ namespace mote
 
     private slots:
         void onFontChanged( void );
+        void onUpdateRequest( const QRect& rect, int dy );
         void onCursorPositionChanged();
         void onSelectionChanged();
         void onTextChanged();
+        void onFormattingFinished( void );
+        void updateFrameTimings( void );
 
     private:
         bool m_lineNumberVisible;
         int m_lineNumberWidth;
         int m_lineNumberPixelWidth;
         QWidget* m_lineNumberWidget;
+        QVector<QStaticText> m_digitTexts;
+        int m_digitWidth;
+        int m_digitAscent;
+        QVector<QStaticText> m_markerTexts;
+        int m_guideLineX;
         int m_tabStopWidthBySpace;
         int m_rowSelectionBasePos;
         int m_coBracePos[2];
-        QListWidget* m_inputCompletionList;
+        MultiCursor m_cursors;
+        int m_rectangleAnchor;
+        qreal m_rectangleAnchorX;
+        bool m_editingCursors;
+        QListView* m_inputCompletionList;
+        CompletionModel* m_inputCompletionModel;
+        InputCompletionItemDelegate* m_inputCompletionDelegate;
+        QFutureWatcher<SourceFormatter::Result> m_formatWatcher;
+        QTextCursor m_formatRange;
+        int m_formatStart;
+        int m_formatRevision;
+        int m_formatRetryCount;
+        bool m_formatRestart;
+        QWidget* m_frameTimingsWidget;
+        QStringList m_frameTimings;
+        QTimer m_frameTimingsTimer;
     };
 }
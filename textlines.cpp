@@ -0,0 +1,125 @@
+#include "textlines.h"
+
+#include <string.h>
+
+namespace mote
+{
+    TextLines::TextLines( const QString& text, const QChar separator )
+        : m_text( text ),
+          m_separator( separator ),
+          m_trailingSeparator( false )
+    {
+        const QChar* data = m_text.constData();
+        const int length = m_text.length();
+
+        int lineCount = 1;
+        for( int i = 0; i < length; ++i )
+        {
+            if( data[i] == separator )
+            {
+                ++lineCount;
+            }
+        }
+        m_views.reserve( lineCount );
+
+        int offset = 0;
+        for( int i = 0; i < length; ++i )
+        {
+            if( data[i] == separator )
+            {
+                View view;
+                view.offset = offset;
+                view.length = i - offset;
+                m_views.push_back( view );
+                offset = i + 1;
+            }
+        }
+
+        if( offset < length )
+        {
+            View view;
+            view.offset = offset;
+            view.length = length - offset;
+            m_views.push_back( view );
+        }
+        else if( length > 0 )
+        {
+            // The selection ends with a separator: keep it out of the lines
+            // so that it stays at the end after reordering.
+            m_trailingSeparator = true;
+        }
+    }
+
+    const QString& TextLines::text( void )const
+    {
+        return m_text;
+    }
+
+    QChar TextLines::separator( void )const
+    {
+        return m_separator;
+    }
+
+    bool TextLines::hasTrailingSeparator( void )const
+    {
+        return m_trailingSeparator;
+    }
+
+    int TextLines::count( void )const
+    {
+        return m_views.size();
+    }
+
+    const TextLines::View& TextLines::view( int index )const
+    {
+        return m_views.at( index );
+    }
+
+    const QChar* TextLines::data( int index )const
+    {
+        return m_text.constData() + m_views.at( index ).offset;
+    }
+
+    bool TextLines::equals( int index1, int index2 )const
+    {
+        const View& view1 = m_views.at( index1 );
+        const View& view2 = m_views.at( index2 );
+        if( view1.length != view2.length )
+        {
+            return false;
+        }
+
+        return memcmp(
+                   m_text.constData() + view1.offset,
+                   m_text.constData() + view2.offset,
+                   view1.length * sizeof( QChar ) ) == 0;
+    }
+
+    QString TextLines::join( const QVector<int>& order )const
+    {
+        int length = m_trailingSeparator ? 1 : 0;
+        for( int i = 0; i < order.size(); ++i )
+        {
+            length += m_views.at( order.at( i ) ).length + 1;
+        }
+
+        QString result;
+        result.reserve( length );
+        for( int i = 0; i < order.size(); ++i )
+        {
+            if( i > 0 )
+            {
+                result += m_separator;
+            }
+
+            const View& view = m_views.at( order.at( i ) );
+            result.append( m_text.constData() + view.offset, view.length );
+        }
+        if( m_trailingSeparator )
+        {
+            result += m_separator;
+        }
+
+        return result;
+    }
+}
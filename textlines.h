@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+namespace mote
+{
+    class TextLines
+    {
+    public:
+        struct View
+        {
+            int offset;
+            int length;
+        };
+
+    public:
+        TextLines( const QString& text, const QChar separator );
+
+    public:
+        const QString& text( void )const;
+        QChar separator( void )const;
+        bool hasTrailingSeparator( void )const;
+
+        int count( void )const;
+        const View& view( int index )const;
+        const QChar* data( int index )const;
+        bool equals( int index1, int index2 )const;
+
+        QString join( const QVector<int>& order )const;
+
+    private:
+        QString m_text;
+        QChar m_separator;
+        bool m_trailingSeparator;
+        QVector<View> m_views;
+    };
+}
@@ -0,0 +1,288 @@
+#include "wordindex.h"
+
+#include <algorithm>
+#include <climits>
+
+#include "blockdata.h"
+
+namespace mote
+{
+    namespace
+    {
+        // Occurrences are looked for this many blocks away from the cursor
+        // at most; words seen only further away rank by name.
+        const int MaxProximityBlockCount = 2000;
+
+        bool lessCandidate( const WordIndex::Candidate& candidate1, const WordIndex::Candidate& candidate2 )
+        {
+            if( candidate1.distance != candidate2.distance )
+            {
+                return candidate1.distance < candidate2.distance;
+            }
+            return WordIndex::lessWord( candidate1.word, candidate2.word );
+        }
+    }
+
+    WordIndex::WordIndex( void )
+        : m_built( false ),
+          m_sorting( true )
+    {
+    }
+
+    bool WordIndex::isBuilt( void )const
+    {
+        return m_built;
+    }
+
+    // The sorted table is made once at the end instead of word by word,
+    // which would move the table for every new word.
+    void WordIndex::build( const QTextDocument* document )
+    {
+        m_built = true;
+        m_sorting = false;
+        for( QTextBlock block = document->begin(); block.isValid(); block = block.next() )
+        {
+            updateBlock( block );
+        }
+
+        m_sortedWords.clear();
+        m_sortedWords.reserve( m_counts.size() );
+        for( QHash<QString, int>::const_iterator it = m_counts.begin(); it != m_counts.end(); ++it )
+        {
+            m_sortedWords += it.key();
+        }
+        std::sort( m_sortedWords.begin(), m_sortedWords.end(), lessWord );
+        m_masks.resize( m_sortedWords.size() );
+        for( int i = 0; i < m_sortedWords.size(); ++i )
+        {
+            m_masks[i] = FuzzyMatcher::charMask( m_sortedWords.at( i ) );
+        }
+        m_sorting = true;
+    }
+
+    // Blocks are deleted with the document; they must not call back into
+    // an index that has gone already.
+    void WordIndex::clear( const QTextDocument* document )
+    {
+        if( !m_built )
+        {
+            return;
+        }
+
+        for( QTextBlock block = document->begin(); block.isValid(); block = block.next() )
+        {
+            BlockData* data = BlockData::find( block );
+            if( data )
+            {
+                data->setWords( QVector<Word>(), NULL );
+            }
+        }
+        m_counts.clear();
+        m_sortedWords.clear();
+        m_masks.clear();
+        m_built = false;
+    }
+
+    void WordIndex::updateBlock( const QTextBlock& block )
+    {
+        BlockData* data = BlockData::get( block );
+        removeWords( data->words() );
+
+        QVector<Word> words;
+        const QString text = block.text();
+        for( int i = 0; i < text.length(); )
+        {
+            if( !isWordCharacter( text.at( i ) ) )
+            {
+                ++i;
+                continue;
+            }
+
+            const int start = i;
+            while( ( i < text.length() ) && isWordCharacter( text.at( i ) ) )
+            {
+                ++i;
+            }
+
+            Word word;
+            word.text = addWord( text.mid( start, i - start ) );
+            word.position = start;
+            words += word;
+        }
+
+        data->setWords( words, this );
+    }
+
+    void WordIndex::removeWords( const QVector<Word>& words )
+    {
+        for( int i = 0; i < words.size(); ++i )
+        {
+            removeWord( words.at( i ).text );
+        }
+    }
+
+    int WordIndex::wordCount( void )const
+    {
+        return m_sortedWords.size();
+    }
+
+    int WordIndex::count( const QString& word )const
+    {
+        return m_counts.value( word );
+    }
+
+    const QHash<QString, int>& WordIndex::counts( void )const
+    {
+        return m_counts;
+    }
+
+    // Words matched by matcher other than the pattern itself, nearest to
+    // position first. The distance is in characters, as far as the blocks
+    // around block tell; words not found nearby follow by name. The
+    // character masks drop most words before any character is compared.
+    QVector<WordIndex::Candidate> WordIndex::complete(
+        const FuzzyMatcher& matcher,
+        const QTextBlock& block,
+        const int position )const
+    {
+        QHash<QString, int> distances;
+        for( int i = 0; i < m_sortedWords.size(); ++i )
+        {
+            const QString& word = m_sortedWords.at( i );
+            if( matcher.mayMatch( m_masks.at( i ) ) && ( word != matcher.pattern() ) && matcher.match( word ) )
+            {
+                distances.insert( word, INT_MAX );
+            }
+        }
+
+        int found = 0;
+        QTextBlock previous = block;
+        QTextBlock next = block.next();
+        for( int i = 0;
+             ( i < MaxProximityBlockCount ) && ( found < distances.size() ) &&
+             ( previous.isValid() || next.isValid() );
+             ++i )
+        {
+            const QTextBlock blocks[2] = { previous, next };
+            for( int j = 0; j < 2; ++j )
+            {
+                const BlockData* data = BlockData::find( blocks[j] );
+                if( !data )
+                {
+                    continue;
+                }
+
+                const QVector<Word>& blockWords = data->words();
+                for( int k = 0; k < blockWords.size(); ++k )
+                {
+                    const Word& word = blockWords.at( k );
+                    QHash<QString, int>::iterator it = distances.find( word.text );
+                    if( it == distances.end() )
+                    {
+                        continue;
+                    }
+
+                    const int start = blocks[j].position() + word.position;
+                    if( start == position )
+                    {
+                        continue;
+                    }
+                    const int distance =
+                        ( start < position ) ? ( position - start - word.text.length() ) : ( start - position );
+                    if( it.value() == INT_MAX )
+                    {
+                        ++found;
+                    }
+                    it.value() = qMin( it.value(), qAbs( distance ) );
+                }
+            }
+
+            if( previous.isValid() )
+            {
+                previous = previous.previous();
+            }
+            if( next.isValid() )
+            {
+                next = next.next();
+            }
+        }
+
+        QVector<Candidate> candidates;
+        candidates.reserve( distances.size() );
+        for( QHash<QString, int>::const_iterator it = distances.begin(); it != distances.end(); ++it )
+        {
+            Candidate candidate;
+            candidate.word = it.key();
+            candidate.distance = it.value();
+            candidate.count = m_counts.value( it.key() );
+            candidates += candidate;
+        }
+        std::sort( candidates.begin(), candidates.end(), lessCandidate );
+        return candidates;
+    }
+
+    bool WordIndex::isWordCharacter( const QChar ch )
+    {
+        const ushort unicode = ch.unicode();
+        return ( ( unicode >= 'a' ) && ( unicode <= 'z' ) ) ||
+               ( ( unicode >= 'A' ) && ( unicode <= 'Z' ) ) ||
+               ( ( unicode >= '0' ) && ( unicode <= '9' ) ) ||
+               ( unicode == '_' );
+    }
+
+    // Case-insensitive order, ties broken by case.
+    bool WordIndex::lessWord( const QString& word1, const QString& word2 )
+    {
+        const int result = QString::compare( word1, word2, Qt::CaseInsensitive );
+        if( result != 0 )
+        {
+            return result < 0;
+        }
+        return word1 < word2;
+    }
+
+    // Returns the stored copy, so that the blocks share its characters.
+    QString WordIndex::addWord( const QString& word )
+    {
+        QHash<QString, int>::iterator it = m_counts.find( word );
+        if( it != m_counts.end() )
+        {
+            ++it.value();
+            return it.key();
+        }
+
+        it = m_counts.insert( word, 1 );
+        if( !m_sorting )
+        {
+            return it.key();
+        }
+        const int index =
+            std::lower_bound( m_sortedWords.begin(), m_sortedWords.end(), word, lessWord ) - m_sortedWords.begin();
+        m_sortedWords.insert( index, word );
+        m_masks.insert( index, FuzzyMatcher::charMask( word ) );
+        return it.key();
+    }
+
+    void WordIndex::removeWord( const QString& word )
+    {
+        QHash<QString, int>::iterator it = m_counts.find( word );
+        if( it == m_counts.end() )
+        {
+            return;
+        }
+
+        if( --it.value() > 0 )
+        {
+            return;
+        }
+
+        m_counts.erase( it );
+        QVector<QString>::iterator sortedIt =
+            std::lower_bound( m_sortedWords.begin(), m_sortedWords.end(), word, lessWord );
+        if( ( sortedIt != m_sortedWords.end() ) && ( *sortedIt == word ) )
+        {
+            m_masks.remove( sortedIt - m_sortedWords.begin() );
+            m_sortedWords.erase( sortedIt );
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QVector>
+
+#include "fuzzymatcher.h"
+
+namespace mote
+{
+    // The identifiers of one document: a count per word and a case-folded
+    // sorted table for lookups. The words of each block are kept in
+    // its BlockData, so an edit only re-reads the blocks it touched.
+    class WordIndex
+    {
+    public:
+        struct Word
+        {
+            QString text;
+            int position;
+        };
+
+        struct Candidate
+        {
+            QString word;
+            int distance;
+            int count;
+        };
+
+    public:
+        WordIndex( void );
+
+    public:
+        bool isBuilt( void )const;
+        void build( const QTextDocument* document );
+        void clear( const QTextDocument* document );
+
+        void updateBlock( const QTextBlock& block );
+        void removeWords( const QVector<Word>& words );
+
+        int wordCount( void )const;
+        int count( const QString& word )const;
+        const QHash<QString, int>& counts( void )const;
+        QVector<Candidate> complete(
+            const FuzzyMatcher& matcher,
+            const QTextBlock& block,
+            const int position )const;
+
+        static bool isWordCharacter( const QChar ch );
+        static bool lessWord( const QString& word1, const QString& word2 );
+
+    private:
+        QString addWord( const QString& word );
+        void removeWord( const QString& word );
+
+    private:
+        bool m_built;
+        bool m_sorting;
+        QHash<QString, int> m_counts;
+        QVector<QString> m_sortedWords;
+        QVector<quint64> m_masks;
+    };
+}